@@ -0,0 +1,524 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "IngestBenchmark.h"
+
+#include <core/Backend.h>
+#include <core/CanTrace.h>
+#include <core/CanTraceFrame.h>
+#include <core/CanMessage.h>
+#include <core/MeasurementSetup.h>
+#include <core/MeasurementNetwork.h>
+#include <core/MeasurementInterface.h>
+#include <driver/CanInterface.h>
+#include <driver/FileCanDriver/FileCanDriver.h>
+#include <driver/FileCanDriver/FileCanInterface.h>
+#include <driver/GeneratorDriver/GeneratorDriver.h>
+#include <tracefile/PcapTraceFile.h>
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QSysInfo>
+#include <QThread>
+#include <QTextStream>
+#include <algorithm>
+
+#if defined(__linux__)
+#include <sys/socket.h>
+#include <net/if.h>
+#include <linux/can.h>
+#include <linux/can/raw.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#endif
+
+// Writes frames to a vcan interface at a fixed rate from its own thread, the
+// kernel loops them back to the SocketCAN interface under test.
+class VcanSender : public QThread
+{
+public:
+    VcanSender(const QString &ifname, uint32_t rate)
+      : _ifname(ifname), _rate(rate), _shouldBeRunning(true), _sent(0), _error()
+    {
+    }
+
+    void requestStop() { _shouldBeRunning = false; }
+    uint64_t sent() const { return _sent; }
+    QString errorString() const { return _error; }
+
+protected:
+    void run()
+    {
+#if defined(__linux__)
+        int fd = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+        if (fd < 0) {
+            _error = QString("socket: %1").arg(strerror(errno));
+            return;
+        }
+
+        struct sockaddr_can addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.can_family = AF_CAN;
+        addr.can_ifindex = if_nametoindex(_ifname.toStdString().c_str());
+        if ((addr.can_ifindex == 0) || (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)) {
+            _error = QString("cannot bind to %1: %2").arg(_ifname, strerror(errno));
+            ::close(fd);
+            return;
+        }
+
+        struct can_frame frame;
+        memset(&frame, 0, sizeof(frame));
+        frame.can_dlc = 8;
+
+        QElapsedTimer timer;
+        timer.start();
+        while (_shouldBeRunning) {
+            uint64_t due = (uint64_t)((double)timer.nsecsElapsed() * _rate / 1e9);
+            while ((_sent < due) && _shouldBeRunning) {
+                frame.can_id = 0x100 + (_sent % 64);
+                memcpy(frame.data, &_sent, sizeof(_sent));
+                if (write(fd, &frame, sizeof(frame)) != sizeof(frame)) {
+                    // tx queue full, give the receiver time to catch up
+                    QThread::usleep(50);
+                    continue;
+                }
+                _sent++;
+            }
+            QThread::usleep(200);
+        }
+        ::close(fd);
+#else
+        _error = "vcan is only available on Linux";
+#endif
+    }
+
+private:
+    QString _ifname;
+    uint32_t _rate;
+    volatile bool _shouldBeRunning;
+    uint64_t _sent;
+    QString _error;
+};
+
+
+IngestBenchmark::IngestBenchmark(Backend &backend, QObject *parent)
+  : QObject(parent),
+    _backend(backend),
+    _current(-1),
+    _duration_s(5),
+    _retention(5000000),
+    _outputFile("ingest-benchmark.json"),
+    _tolerance(10),
+    _exitCode(0),
+    _fileInterface(0),
+    _sender(0),
+    _latencyValid(false),
+    _frames(0),
+    _sampleCounter(0),
+    _droppedBefore(0)
+{
+    _durationTimer.setSingleShot(true);
+    connect(&_durationTimer, SIGNAL(timeout()), this, SLOT(finishScenario()));
+    _pollTimer.setInterval(10);
+    connect(&_pollTimer, SIGNAL(timeout()), this, SLOT(checkFinished()));
+
+    // counted in the flushing thread, right when frames become part of the trace
+    connect(_backend.getTrace(), SIGNAL(messagesEnqueued(int,int)), this, SLOT(onMessagesEnqueued(int,int)), Qt::DirectConnection);
+}
+
+QList<IngestBenchmark::scenario_t> IngestBenchmark::defaultScenarios(const QString &vcan)
+{
+    QList<scenario_t> list;
+    scenario_t s;
+    s.interfaces = 1;
+    s.rate = 0;
+
+    s.name = "generator-max";
+    s.source = source_generator;
+    s.spec = "ids=64 rate=0 len=8 pattern=counter";
+    list.append(s);
+
+    s.name = "generator-max-4x";
+    s.interfaces = 4;
+    list.append(s);
+
+    s.name = "generator-100k";
+    s.interfaces = 1;
+    s.spec = "ids=256 rate=100000 len=8 pattern=random";
+    list.append(s);
+
+    s.name = "generator-fd-burst";
+    s.spec = "ids=128 rate=20000 len=8 pattern=ramp fd=50 fdlen=64 burst=5000/100";
+    list.append(s);
+
+    s.name = "file-max";
+    s.source = source_file;
+    s.spec.clear();
+    list.append(s);
+
+    if (!vcan.isEmpty()) {
+        s.name = QString("socketcan-%1-20k").arg(vcan);
+        s.source = source_vcan;
+        s.spec = vcan;
+        s.rate = 20000;
+        list.append(s);
+
+        s.name = QString("socketcan-%1-max").arg(vcan);
+        s.rate = 1000000;
+        list.append(s);
+    }
+
+    return list;
+}
+
+void IngestBenchmark::setScenarios(const QList<scenario_t> &scenarios)
+{
+    _scenarios = scenarios;
+}
+
+void IngestBenchmark::setDuration(int seconds)
+{
+    _duration_s = seconds;
+}
+
+void IngestBenchmark::setRetention(uint64_t frames)
+{
+    _retention = frames;
+}
+
+void IngestBenchmark::setOutputFile(const QString &filename)
+{
+    _outputFile = filename;
+}
+
+void IngestBenchmark::setBaseline(const QString &filename, double tolerance_percent)
+{
+    _baselineFile = filename;
+    _tolerance = tolerance_percent;
+}
+
+int IngestBenchmark::exitCode() const
+{
+    return _exitCode;
+}
+
+void IngestBenchmark::start()
+{
+    _current = -1;
+    _results.clear();
+    runNext();
+}
+
+void IngestBenchmark::runNext()
+{
+    _current++;
+    if (_current >= _scenarios.size()) {
+        writeResults();
+        compareBaseline();
+        if (!_captureFile.isEmpty()) {
+            QFile::remove(_captureFile);
+        }
+        QCoreApplication::exit(_exitCode);
+        return;
+    }
+
+    const scenario_t &scenario = _scenarios[_current];
+    QTextStream(stdout) << "running " << scenario.name << "..." << Qt::endl;
+    if (!prepareScenario(scenario)) {
+        QTextStream(stdout) << "  skipped" << Qt::endl;
+        QTimer::singleShot(0, this, SLOT(runNext()));
+        return;
+    }
+
+    MeasurementSetup &setup = _backend.getSetup();
+    setup.clear();
+    foreach (CanInterface *intf, _interfaces) {
+        MeasurementNetwork *network = setup.createNetwork();
+        network->setName(intf->getName());
+        MeasurementInterface *mi = new MeasurementInterface();
+        mi->setCanInterface(intf->getId());
+        mi->setDoConfigure(false);
+        network->addInterface(mi);
+    }
+
+    CanTrace *trace = _backend.getTrace();
+    trace->clear();
+    trace->setRetention(CanTrace::retention_frames, _retention);
+    _droppedBefore = trace->droppedFrames();
+    _frames = 0;
+    _sampleCounter = 0;
+    _latencies.clear();
+    _latencies.reserve(1 << 20);
+    _latencyValid = (scenario.source != source_file);
+
+    _backend.startMeasurement();
+    if (scenario.source == source_vcan) {
+        _sender = new VcanSender(scenario.spec, scenario.rate);
+        _sender->start();
+    }
+    _elapsed.start();
+    _durationTimer.start(_duration_s * 1000);
+    _pollTimer.start();
+}
+
+bool IngestBenchmark::prepareScenario(const scenario_t &scenario)
+{
+    _interfaces.clear();
+    _fileInterface = 0;
+
+    if (scenario.source == source_generator) {
+        GeneratorDriver *driver = dynamic_cast<GeneratorDriver*>(_backend.getDriverByName("Generator"));
+        GeneratorInterface::config_t config;
+        QString error;
+        if (!driver || !GeneratorInterface::parseConfig(scenario.spec, config, error)) {
+            QTextStream(stderr) << "invalid generator spec: " << error << Qt::endl;
+            return false;
+        }
+        for (int i=0; i<scenario.interfaces; i++) {
+            _interfaces.append(driver->addGenerator(config));
+        }
+        return true;
+    }
+
+    if (scenario.source == source_file) {
+        FileCanDriver *driver = dynamic_cast<FileCanDriver*>(_backend.getDriverByName("File"));
+        if (!driver || !prepareCaptureFile()) {
+            return false;
+        }
+        _fileInterface = driver->addFile(_captureFile);
+        if (!_fileInterface) {
+            return false;
+        }
+        _fileInterface->setRealTime(false);
+        _interfaces.append(_fileInterface);
+        return true;
+    }
+
+    CanInterface *intf = _backend.getInterfaceByDriverAndName("SocketCAN", scenario.spec);
+    if (!intf) {
+        QTextStream(stderr) << "SocketCAN interface " << scenario.spec << " not found, create it with: "
+                            << "ip link add dev " << scenario.spec << " type vcan && ip link set up " << scenario.spec << Qt::endl;
+        return false;
+    }
+    _interfaces.append(intf);
+    return true;
+}
+
+bool IngestBenchmark::prepareCaptureFile()
+{
+    if (!_captureFile.isEmpty()) {
+        return true;
+    }
+
+    QString filename = QDir::temp().filePath(QString("cangaroo-bench-%1.pcapng").arg(QCoreApplication::applicationPid()));
+    PcapngTraceWriter writer;
+    if (!writer.open(filename)) {
+        QTextStream(stderr) << "cannot write " << filename << ": " << writer.errorString() << Qt::endl;
+        return false;
+    }
+
+    CanMessage msg;
+    msg.setLength(8);
+    for (int i=0; i<file_frames; i++) {
+        msg.setId(0x100 + (i % 64));
+        msg.setByte(0, i & 0xFF);
+        msg.setTimestampNsecs((1000000 + i / 10000) * timestamp_nsecs_per_sec + (i % 10000) * 100 * timestamp_nsecs_per_usec);
+        writer.addMessage(msg);
+    }
+    writer.close();
+    _captureFile = filename;
+    return true;
+}
+
+void IngestBenchmark::checkFinished()
+{
+    // the file scenario ends when the whole capture has been ingested
+    if (_fileInterface && _fileInterface->atEnd()) {
+        _durationTimer.stop();
+        finishScenario();
+    }
+}
+
+void IngestBenchmark::finishScenario()
+{
+    _pollTimer.stop();
+    _durationTimer.stop();
+
+    uint64_t sent = 0;
+    QString senderError;
+    if (_sender) {
+        _sender->requestStop();
+        _sender->wait();
+        sent = _sender->sent();
+        senderError = _sender->errorString();
+        delete _sender;
+        _sender = 0;
+    }
+
+    // stopping flushes what is still queued into the trace
+    _backend.stopMeasurement();
+    double seconds = _elapsed.nsecsElapsed() / 1e9;
+
+    CanTrace *trace = _backend.getTrace();
+    const scenario_t &scenario = _scenarios[_current];
+    uint64_t dropped = trace->droppedFrames() - _droppedBefore;
+    unsigned long stored = trace->size();
+
+    QJsonObject result;
+    result["name"] = scenario.name;
+    result["seconds"] = seconds;
+    result["frames"] = (double)_frames;
+    result["frames_per_s"] = (seconds > 0) ? _frames / seconds : 0;
+    result["dropped"] = (double)dropped;
+    result["trace_bytes_per_frame"] = stored ? (double)trace->memoryUsage() / stored : 0;
+    if (scenario.source == source_vcan) {
+        result["sent"] = (double)sent;
+        if (!senderError.isEmpty()) {
+            result["error"] = senderError;
+        }
+    }
+
+    if (_latencyValid && !_latencies.isEmpty()) {
+        std::sort(_latencies.begin(), _latencies.end());
+        QJsonObject latency;
+        latency["samples"] = (double)_latencies.size();
+        latency["p50_us"] = (double)percentile(_latencies, 0.5);
+        latency["p99_us"] = (double)percentile(_latencies, 0.99);
+        latency["p999_us"] = (double)percentile(_latencies, 0.999);
+        latency["max_us"] = (double)_latencies.last();
+        result["latency"] = latency;
+    }
+    _results.append(result);
+
+    QTextStream out(stdout);
+    out << QString("  %1 frames in %2 s, %3 frames/s, %4 dropped, %5 bytes/frame")
+           .arg(_frames).arg(seconds, 0, 'f', 2).arg(result["frames_per_s"].toDouble(), 0, 'f', 0)
+           .arg(dropped).arg(result["trace_bytes_per_frame"].toDouble(), 0, 'f', 1) << Qt::endl;
+    if (result.contains("latency")) {
+        QJsonObject latency = result["latency"].toObject();
+        out << QString("  latency p50 %1 us, p99 %2 us, p99.9 %3 us, max %4 us")
+               .arg(latency["p50_us"].toDouble()).arg(latency["p99_us"].toDouble())
+               .arg(latency["p999_us"].toDouble()).arg(latency["max_us"].toDouble()) << Qt::endl;
+    }
+
+    trace->clear();
+    QTimer::singleShot(0, this, SLOT(runNext()));
+}
+
+void IngestBenchmark::onMessagesEnqueued(int first_idx, int num_messages)
+{
+    _frames += num_messages;
+    if (!_latencyValid) {
+        return;
+    }
+
+    CanTrace *trace = _backend.getTrace();
+    CanTimestamp now = currentTimestamp();
+    for (int i=0; i<num_messages; i++) {
+        if ((_sampleCounter++ % latency_sample_every) != 0) {
+            continue;
+        }
+        const CanTraceFrame *frame = trace->getMessage(first_idx + i);
+        if (frame) {
+            _latencies.append((now - frame->getTimestampNsecs()) / timestamp_nsecs_per_usec);
+        }
+    }
+}
+
+int64_t IngestBenchmark::percentile(const QVector<int64_t> &sorted, double q)
+{
+    int idx = qMin((int)(q * sorted.size()), (int)sorted.size() - 1);
+    return sorted[idx];
+}
+
+void IngestBenchmark::writeResults()
+{
+    QJsonArray scenarios;
+    foreach (const QJsonObject &result, _results) {
+        scenarios.append(result);
+    }
+
+    QJsonObject root;
+    root["benchmark"] = "ingest";
+    root["date"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    root["host"] = QSysInfo::machineHostName();
+    root["cpus"] = QThread::idealThreadCount();
+    root["qt"] = qVersion();
+    root["duration_s"] = _duration_s;
+    root["retention_frames"] = (double)_retention;
+    root["scenarios"] = scenarios;
+
+    QFile file(_outputFile);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        QTextStream(stderr) << "cannot write results to " << _outputFile << Qt::endl;
+        _exitCode = 2;
+        return;
+    }
+    file.write(QJsonDocument(root).toJson());
+    file.close();
+    QTextStream(stdout) << "results written to " << _outputFile << Qt::endl;
+}
+
+void IngestBenchmark::compareBaseline()
+{
+    if (_baselineFile.isEmpty()) {
+        return;
+    }
+
+    QFile file(_baselineFile);
+    if (!file.open(QIODevice::ReadOnly)) {
+        QTextStream(stderr) << "cannot read baseline " << _baselineFile << Qt::endl;
+        _exitCode = 2;
+        return;
+    }
+    QJsonArray baseline = QJsonDocument::fromJson(file.readAll()).object()["scenarios"].toArray();
+
+    // throughput may not drop and p99 latency may not grow by more than the tolerance
+    QTextStream out(stdout);
+    foreach (const QJsonObject &result, _results) {
+        for (int i=0; i<baseline.size(); i++) {
+            QJsonObject base = baseline[i].toObject();
+            if (base["name"].toString() != result["name"].toString()) {
+                continue;
+            }
+
+            double fps = result["frames_per_s"].toDouble();
+            double base_fps = base["frames_per_s"].toDouble();
+            if (fps < base_fps * (1 - _tolerance / 100)) {
+                out << QString("REGRESSION %1: %2 frames/s, baseline %3").arg(result["name"].toString()).arg(fps, 0, 'f', 0).arg(base_fps, 0, 'f', 0) << Qt::endl;
+                _exitCode = 1;
+            }
+
+            double p99 = result["latency"].toObject()["p99_us"].toDouble();
+            double base_p99 = base["latency"].toObject()["p99_us"].toDouble();
+            if ((base_p99 > 0) && (p99 > base_p99 * (1 + _tolerance / 100))) {
+                out << QString("REGRESSION %1: p99 latency %2 us, baseline %3 us").arg(result["name"].toString()).arg(p99).arg(base_p99) << Qt::endl;
+                _exitCode = 1;
+            }
+        }
+    }
+}
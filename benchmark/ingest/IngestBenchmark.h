@@ -0,0 +1,121 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#pragma once
+
+#include <stdint.h>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QVector>
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QTimer>
+
+class Backend;
+class CanInterface;
+class FileCanInterface;
+class VcanSender;
+
+// Runs ingest scenarios through the real Backend, CanListener and CanTrace
+// and measures what reaches the trace: frames per second, latency from the
+// frame timestamp (taken when the driver reads the frame) to the trace flush,
+// trace memory per frame and frames dropped by the listener queues.
+class IngestBenchmark : public QObject
+{
+    Q_OBJECT
+
+public:
+    typedef enum {
+        source_generator,
+        source_file,
+        source_vcan
+    } source_t;
+
+    typedef struct {
+        QString name;
+        source_t source;
+        QString spec;      // generator traffic spec
+        int interfaces;    // number of generator interfaces
+        uint32_t rate;     // vcan send rate
+    } scenario_t;
+
+    enum {
+        latency_sample_every = 16,
+        file_frames = 2000000
+    };
+
+    explicit IngestBenchmark(Backend &backend, QObject *parent = 0);
+
+    static QList<scenario_t> defaultScenarios(const QString &vcan);
+
+    void setScenarios(const QList<scenario_t> &scenarios);
+    void setDuration(int seconds);
+    void setRetention(uint64_t frames);
+    void setOutputFile(const QString &filename);
+    void setBaseline(const QString &filename, double tolerance_percent);
+
+    int exitCode() const;
+
+public slots:
+    void start();
+
+private slots:
+    void runNext();
+    void checkFinished();
+    void finishScenario();
+    void onMessagesEnqueued(int first_idx, int num_messages);
+
+private:
+    Backend &_backend;
+    QList<scenario_t> _scenarios;
+    int _current;
+    int _duration_s;
+    uint64_t _retention;
+    QString _outputFile;
+    QString _baselineFile;
+    double _tolerance;
+    int _exitCode;
+
+    QList<CanInterface*> _interfaces;
+    FileCanInterface *_fileInterface;
+    QString _captureFile;
+    VcanSender *_sender;
+
+    QTimer _durationTimer;
+    QTimer _pollTimer;
+    QElapsedTimer _elapsed;
+    bool _latencyValid;
+    uint64_t _frames;
+    uint64_t _sampleCounter;
+    uint64_t _droppedBefore;
+    QVector<int64_t> _latencies;
+
+    QList<QJsonObject> _results;
+
+    bool prepareScenario(const scenario_t &scenario);
+    bool prepareCaptureFile();
+    void writeResults();
+    void compareBaseline();
+    static int64_t percentile(const QVector<int64_t> &sorted, double q);
+};
@@ -0,0 +1,44 @@
+lessThan(QT_MAJOR_VERSION, 6): error("requires Qt 6")
+
+QT += core gui
+QT += widgets
+QT += xml
+QT += charts
+QT += serialport
+
+TARGET = cangaroo-bench-ingest
+TEMPLATE = app
+CONFIG += console warn_on c++20
+CONFIG -= app_bundle
+CONFIG += link_pkgconfig
+
+SRC = $$PWD/../../src
+INCLUDEPATH += $$SRC
+
+DESTDIR = ../../bin
+MOC_DIR = ../../build/bench-ingest/moc
+RCC_DIR = ../../build/bench-ingest/rcc
+UI_DIR = ../../build/bench-ingest/ui
+OBJECTS_DIR = ../../build/bench-ingest/o
+
+SOURCES += \
+    main.cpp \
+    IngestBenchmark.cpp
+
+HEADERS += \
+    IngestBenchmark.h
+
+# the backend pulls in the drivers, parsers, trace files and the setup
+# dialog the generic driver setup page registers with
+include($$SRC/core/core.pri)
+include($$SRC/driver/driver.pri)
+include($$SRC/parser/dbc/dbc.pri)
+include($$SRC/tracefile/tracefile.pri)
+include($$SRC/window/SetupDialog/SetupDialog.pri)
+
+unix:PKGCONFIG += libnl-3.0
+unix:PKGCONFIG += libnl-route-3.0
+unix:include($$SRC/driver/SocketCanDriver/SocketCanDriver.pri)
+
+include($$SRC/driver/FileCanDriver/FileCanDriver.pri)
+include($$SRC/driver/GeneratorDriver/GeneratorDriver.pri)
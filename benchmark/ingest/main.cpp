@@ -0,0 +1,101 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QTimer>
+#include <QTextStream>
+
+#include <core/Backend.h>
+#include <driver/FileCanDriver/FileCanDriver.h>
+#include <driver/GeneratorDriver/GeneratorDriver.h>
+#if defined(__linux__)
+#include <driver/SocketCanDriver/SocketCanDriver.h>
+#endif
+
+#include "IngestBenchmark.h"
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("cangaroo-bench-ingest");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("End-to-end ingest benchmark: drives frames through driver, listener and trace.");
+    parser.addHelpOption();
+    QCommandLineOption durationOption("duration", "Seconds per scenario (default 5).", "seconds", "5");
+    QCommandLineOption outputOption("output", "JSON result file (default ingest-benchmark.json).", "file", "ingest-benchmark.json");
+    QCommandLineOption vcanOption("vcan", "SocketCAN interface to run the kernel scenarios on, e.g. vcan0.", "interface");
+    QCommandLineOption scenarioOption("scenario", "Only run the named scenario, may be given multiple times.", "name");
+    QCommandLineOption retentionOption("retention", "Trace retention in frames (default 5000000).", "frames", "5000000");
+    QCommandLineOption baselineOption("baseline", "Compare against a previous JSON result and fail on regressions.", "file");
+    QCommandLineOption toleranceOption("tolerance", "Allowed regression against the baseline in percent (default 10).", "percent", "10");
+    QCommandLineOption listOption("list", "List the scenarios and exit.");
+    parser.addOption(durationOption);
+    parser.addOption(outputOption);
+    parser.addOption(vcanOption);
+    parser.addOption(scenarioOption);
+    parser.addOption(retentionOption);
+    parser.addOption(baselineOption);
+    parser.addOption(toleranceOption);
+    parser.addOption(listOption);
+    parser.process(app);
+
+    Backend &backend = Backend::instance();
+#if defined(__linux__)
+    SocketCanDriver *socketcan = new SocketCanDriver(backend);
+    backend.addCanDriver(*socketcan);
+    socketcan->update();
+#endif
+    backend.addCanDriver(*(new FileCanDriver(backend)));
+    backend.addCanDriver(*(new GeneratorDriver(backend)));
+
+    QList<IngestBenchmark::scenario_t> scenarios;
+    QStringList selected = parser.values(scenarioOption);
+    foreach (const IngestBenchmark::scenario_t &scenario, IngestBenchmark::defaultScenarios(parser.value(vcanOption))) {
+        if (parser.isSet(listOption)) {
+            QTextStream(stdout) << scenario.name << Qt::endl;
+        } else if (selected.isEmpty() || selected.contains(scenario.name)) {
+            scenarios.append(scenario);
+        }
+    }
+    if (parser.isSet(listOption)) {
+        return 0;
+    }
+    if (scenarios.isEmpty()) {
+        QTextStream(stderr) << "no matching scenarios, see --list" << Qt::endl;
+        return 2;
+    }
+
+    IngestBenchmark bench(backend);
+    bench.setScenarios(scenarios);
+    bench.setDuration(qMax(1, parser.value(durationOption).toInt()));
+    bench.setRetention(parser.value(retentionOption).toULongLong());
+    bench.setOutputFile(parser.value(outputOption));
+    if (parser.isSet(baselineOption)) {
+        bench.setBaseline(parser.value(baselineOption), parser.value(toleranceOption).toDouble());
+    }
+
+    QTimer::singleShot(0, &bench, SLOT(start()));
+    app.exec();
+    return bench.exitCode();
+}
@@ -0,0 +1,418 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "MicroBenchmark.h"
+
+#include <core/CanDbMessage.h>
+#include <core/CanDbSignal.h>
+#include <core/MeasurementSetup.h>
+#include <core/MeasurementNetwork.h>
+#include <parser/dbc/DbcParser.h>
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QSysInfo>
+#include <QTextStream>
+#include <algorithm>
+
+MicroBenchmark::MicroBenchmark(const SyntheticCanDb::config_t &config, int frames)
+  : _config(config),
+    _numFrames(frames),
+    _minTime_ms(250),
+    _repetitions(5),
+    _setup(0),
+    _dbItems(0),
+    _dbcBytes(0),
+    _sink(0)
+{
+}
+
+MicroBenchmark::~MicroBenchmark()
+{
+    delete _setup;
+    if (!_dbcFile.isEmpty()) {
+        QFile::remove(_dbcFile);
+    }
+    if (!_smallDbcFile.isEmpty()) {
+        QFile::remove(_smallDbcFile);
+    }
+}
+
+QString MicroBenchmark::caseName(case_t c)
+{
+    switch (c) {
+        case case_extract_raw_intel: return "extract_raw_intel";
+        case case_extract_raw_motorola: return "extract_raw_motorola";
+        case case_convert_unsigned: return "convert_unsigned";
+        case case_convert_signed: return "convert_signed";
+        case case_find_db_message_hit: return "find_db_message_hit";
+        case case_find_db_message_miss: return "find_db_message_miss";
+        case case_decode_frame: return "decode_frame";
+        case case_id_string: return "id_string";
+        case case_data_hex_string: return "data_hex_string";
+        case case_parse_dbc: return "parse_dbc";
+        default: return "";
+    }
+}
+
+void MicroBenchmark::setMinTime(int ms)
+{
+    _minTime_ms = ms;
+}
+
+void MicroBenchmark::setRepetitions(int repetitions)
+{
+    _repetitions = repetitions;
+}
+
+void MicroBenchmark::setFilter(const QStringList &names)
+{
+    _filter = names;
+}
+
+bool MicroBenchmark::parseDbc(const QString &filename, CanDb &candb)
+{
+    QFile file(filename);
+    DbcParser parser;
+    return parser.parseFile(&file, candb);
+}
+
+bool MicroBenchmark::prepare()
+{
+    QTextStream out(stdout);
+    QString prefix = QDir::temp().filePath(QString("cangaroo-micro-%1").arg(QCoreApplication::applicationPid()));
+
+    // a small database on the first network, so lookups of the large one
+    // have to go past it like they do in a multi-network setup
+    SyntheticCanDb::config_t smallConfig = _config;
+    smallConfig.messages = small_db_messages;
+    smallConfig.seed = _config.seed + 1;
+    SyntheticCanDb small(smallConfig);
+    SyntheticCanDb large(_config);
+
+    _smallDbcFile = prefix + "-small.dbc";
+    _dbcFile = prefix + ".dbc";
+    if (!small.writeDbc(_smallDbcFile) || !large.writeDbc(_dbcFile)) {
+        QTextStream(stderr) << "cannot write synthetic dbc files to " << QDir::tempPath() << Qt::endl;
+        return false;
+    }
+    _dbcBytes = QFileInfo(_dbcFile).size();
+    _dbItems = large.countMessages() + large.countSignals();
+    out << QString("database: %1 messages, %2 signals, %3 kB").arg(large.countMessages()).arg(large.countSignals()).arg(_dbcBytes / 1024) << Qt::endl;
+
+    pCanDb smallDb(new CanDb());
+    pCanDb largeDb(new CanDb());
+    if (!parseDbc(_smallDbcFile, *smallDb) || !parseDbc(_dbcFile, *largeDb)) {
+        QTextStream(stderr) << "cannot parse the synthetic dbc files" << Qt::endl;
+        return false;
+    }
+
+    _setup = new MeasurementSetup(0);
+    _setup->createNetwork()->addCanDb(smallDb);
+    _setup->createNetwork()->addCanDb(largeDb);
+
+    _frames = large.generateFrames(_numFrames, unknown_percent);
+    foreach (const CanMessage &frame, _frames) {
+        if (_setup->findDbMessage(frame)) {
+            _knownFrames.append(frame);
+        } else {
+            _unknownFrames.append(frame);
+        }
+    }
+    if (_knownFrames.isEmpty() || _unknownFrames.isEmpty()) {
+        QTextStream(stderr) << "frame stream needs known and unknown ids" << Qt::endl;
+        return false;
+    }
+    out << QString("frames: %1 known, %2 unknown").arg(_knownFrames.size()).arg(_unknownFrames.size()) << Qt::endl;
+
+    // collect (frame, signal) pairs the way a decoder sees them,
+    // _knownFrames is not modified anymore so the pointers stay valid
+    for (int pass=0; pass<16; pass++) {
+        for (int i=0; i<_knownFrames.size(); i++) {
+            const CanMessage *frame = &_knownFrames.at(i);
+            CanDbMessage *dbmsg = _setup->findDbMessage(*frame);
+            foreach (CanDbSignal *signal, dbmsg->getSignals()) {
+                if (!signal->isPresentInMessage(*frame)) {
+                    continue;
+                }
+
+                extract_t e;
+                e.msg = frame;
+                e.signal = signal;
+                QVector<extract_t> &extract = signal->isBigEndian() ? _extractMotorola : _extractIntel;
+                if (extract.size() < pairs_per_case) {
+                    extract.append(e);
+                }
+
+                convert_t c;
+                c.raw = signal->extractRawDataFromMessage(*frame);
+                c.signal = signal;
+                QVector<convert_t> &convert = signal->isUnsigned() ? _convertUnsigned : _convertSigned;
+                if (convert.size() < pairs_per_case) {
+                    convert.append(c);
+                }
+            }
+        }
+        if ((_extractIntel.size() >= pairs_per_case) && (_extractMotorola.size() >= pairs_per_case)
+            && (_convertUnsigned.size() >= pairs_per_case) && (_convertSigned.size() >= pairs_per_case)) {
+            break;
+        }
+    }
+
+    return true;
+}
+
+int MicroBenchmark::opsPerIteration(case_t c) const
+{
+    switch (c) {
+        case case_extract_raw_intel: return _extractIntel.size();
+        case case_extract_raw_motorola: return _extractMotorola.size();
+        case case_convert_unsigned: return _convertUnsigned.size();
+        case case_convert_signed: return _convertSigned.size();
+        case case_find_db_message_hit: return _knownFrames.size();
+        case case_find_db_message_miss: return _unknownFrames.size();
+        case case_decode_frame: return _frames.size();
+        case case_id_string: return _frames.size();
+        case case_data_hex_string: return _frames.size();
+        case case_parse_dbc: return 1;
+        default: return 0;
+    }
+}
+
+uint64_t MicroBenchmark::runCase(case_t c, uint64_t iterations)
+{
+    // every case folds its results into a sum, so the work can not be optimized away
+    uint64_t sum = 0;
+    double fsum = 0;
+
+    for (uint64_t it=0; it<iterations; it++) {
+        switch (c) {
+
+            case case_extract_raw_intel:
+            case case_extract_raw_motorola: {
+                const QVector<extract_t> &extract = (c == case_extract_raw_intel) ? _extractIntel : _extractMotorola;
+                const extract_t *e = extract.constData();
+                for (int i=0; i<extract.size(); i++) {
+                    sum += e[i].msg->extractRawSignal(e[i].signal->startBit(), e[i].signal->length(), e[i].signal->isBigEndian());
+                }
+                break;
+            }
+
+            case case_convert_unsigned:
+            case case_convert_signed: {
+                const QVector<convert_t> &convert = (c == case_convert_unsigned) ? _convertUnsigned : _convertSigned;
+                const convert_t *v = convert.constData();
+                for (int i=0; i<convert.size(); i++) {
+                    fsum += v[i].signal->convertRawValueToPhysical(v[i].raw);
+                }
+                break;
+            }
+
+            case case_find_db_message_hit:
+            case case_find_db_message_miss: {
+                const QVector<CanMessage> &frames = (c == case_find_db_message_hit) ? _knownFrames : _unknownFrames;
+                const CanMessage *f = frames.constData();
+                for (int i=0; i<frames.size(); i++) {
+                    sum += (uintptr_t)_setup->findDbMessage(f[i]);
+                }
+                break;
+            }
+
+            case case_decode_frame: {
+                const CanMessage *f = _frames.constData();
+                for (int i=0; i<_frames.size(); i++) {
+                    CanDbMessage *dbmsg = _setup->findDbMessage(f[i]);
+                    if (!dbmsg) {
+                        continue;
+                    }
+                    foreach (CanDbSignal *signal, dbmsg->getSignals()) {
+                        if (signal->isPresentInMessage(f[i])) {
+                            fsum += signal->extractPhysicalFromMessage(f[i]);
+                        }
+                    }
+                }
+                break;
+            }
+
+            case case_id_string: {
+                const CanMessage *f = _frames.constData();
+                for (int i=0; i<_frames.size(); i++) {
+                    sum += f[i].getIdString().size();
+                }
+                break;
+            }
+
+            case case_data_hex_string: {
+                const CanMessage *f = _frames.constData();
+                for (int i=0; i<_frames.size(); i++) {
+                    sum += f[i].getDataHexString().size();
+                }
+                break;
+            }
+
+            case case_parse_dbc: {
+                CanDb *candb = new CanDb();
+                parseDbc(_dbcFile, *candb);
+                sum += candb->getNumberOfMessages();
+                delete candb;
+                break;
+            }
+
+            default:
+                break;
+        }
+    }
+
+    return sum + (uint64_t)fsum;
+}
+
+void MicroBenchmark::run()
+{
+    QTextStream out(stdout);
+    qint64 minTime_ns = (qint64)_minTime_ms * 1000000;
+
+    for (int i=0; i<case_count; i++) {
+        case_t c = (case_t)i;
+        QString name = caseName(c);
+        if (!_filter.isEmpty() && !_filter.contains(name)) {
+            continue;
+        }
+
+        int ops = opsPerIteration(c);
+        if (ops == 0) {
+            out << QString("%1 skipped, no data").arg(name, -24) << Qt::endl;
+            continue;
+        }
+
+        // grow the iteration count until one run takes at least the minimum time
+        QElapsedTimer timer;
+        uint64_t iterations = 1;
+        while (true) {
+            timer.start();
+            _sink += runCase(c, iterations);
+            qint64 t = timer.nsecsElapsed();
+            if (t >= minTime_ns) {
+                break;
+            }
+            uint64_t scale = (t > 0) ? (uint64_t)(minTime_ns * 1.2 / t) + 1 : 10;
+            iterations *= qBound<uint64_t>(2, scale, 100);
+        }
+
+        QVector<double> ns_per_op;
+        for (int r=0; r<_repetitions; r++) {
+            timer.start();
+            _sink += runCase(c, iterations);
+            ns_per_op.append((double)timer.nsecsElapsed() / (iterations * ops));
+        }
+        std::sort(ns_per_op.begin(), ns_per_op.end());
+        double median = ns_per_op[ns_per_op.size() / 2];
+
+        QJsonObject result;
+        result["name"] = name;
+        result["ops_per_iteration"] = ops;
+        result["iterations"] = (double)iterations;
+        result["ns_per_op"] = median;
+        result["ns_per_op_min"] = ns_per_op.first();
+        result["ops_per_s"] = 1e9 / median;
+        if (c == case_parse_dbc) {
+            result["dbc_bytes"] = (double)_dbcBytes;
+            result["dbc_items"] = _dbItems;
+            result["mb_per_s"] = _dbcBytes / (median / 1e9) / (1024*1024);
+        }
+        _results.append(result);
+
+        out << QString("%1 %2 ns/op  (best %3, %4 ops/s)")
+               .arg(name, -24)
+               .arg(median, 12, 'f', median < 100 ? 2 : 0)
+               .arg(ns_per_op.first(), 0, 'f', median < 100 ? 2 : 0)
+               .arg(1e9 / median, 0, 'g', 4) << Qt::endl;
+    }
+}
+
+bool MicroBenchmark::writeResults(const QString &filename)
+{
+    QJsonArray cases;
+    foreach (const QJsonObject &result, _results) {
+        cases.append(result);
+    }
+
+    QJsonObject database;
+    database["messages"] = _config.messages;
+    database["signals_per_message"] = _config.signals_per_message;
+    database["seed"] = (double)_config.seed;
+    database["frames"] = _numFrames;
+
+    QJsonObject root;
+    root["benchmark"] = "micro";
+    root["date"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    root["host"] = QSysInfo::machineHostName();
+    root["qt"] = qVersion();
+    root["min_time_ms"] = _minTime_ms;
+    root["repetitions"] = _repetitions;
+    root["database"] = database;
+    root["cases"] = cases;
+
+    QFile file(filename);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        QTextStream(stderr) << "cannot write results to " << filename << Qt::endl;
+        return false;
+    }
+    file.write(QJsonDocument(root).toJson());
+    file.close();
+    QTextStream(stdout) << "results written to " << filename << Qt::endl;
+    return true;
+}
+
+bool MicroBenchmark::compareBaseline(const QString &filename, double tolerance_percent)
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly)) {
+        QTextStream(stderr) << "cannot read baseline " << filename << Qt::endl;
+        return false;
+    }
+    QJsonArray baseline = QJsonDocument::fromJson(file.readAll()).object()["cases"].toArray();
+
+    bool retval = true;
+    QTextStream out(stdout);
+    foreach (const QJsonObject &result, _results) {
+        for (int i=0; i<baseline.size(); i++) {
+            QJsonObject base = baseline[i].toObject();
+            if (base["name"].toString() != result["name"].toString()) {
+                continue;
+            }
+
+            double ns = result["ns_per_op"].toDouble();
+            double base_ns = base["ns_per_op"].toDouble();
+            if ((base_ns > 0) && (ns > base_ns * (1 + tolerance_percent / 100))) {
+                out << QString("REGRESSION %1: %2 ns/op, baseline %3 ns/op").arg(result["name"].toString()).arg(ns).arg(base_ns) << Qt::endl;
+                retval = false;
+            }
+        }
+    }
+    return retval;
+}
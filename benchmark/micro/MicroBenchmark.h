@@ -0,0 +1,116 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#pragma once
+
+#include <stdint.h>
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QVector>
+#include <QJsonObject>
+#include <core/CanMessage.h>
+#include <core/CanDb.h>
+
+#include "SyntheticCanDb.h"
+
+class CanDbSignal;
+class MeasurementSetup;
+
+// Times the signal decoding, database lookup, formatting and DBC parsing hot
+// paths on synthetic data. Every case is calibrated to run for at least the
+// minimum time, then repeated; the median and best time per operation are
+// reported.
+class MicroBenchmark
+{
+public:
+    typedef enum {
+        case_extract_raw_intel,
+        case_extract_raw_motorola,
+        case_convert_unsigned,
+        case_convert_signed,
+        case_find_db_message_hit,
+        case_find_db_message_miss,
+        case_decode_frame,
+        case_id_string,
+        case_data_hex_string,
+        case_parse_dbc,
+        case_count
+    } case_t;
+
+    enum {
+        pairs_per_case = 65536,
+        unknown_percent = 10,
+        small_db_messages = 100
+    };
+
+    MicroBenchmark(const SyntheticCanDb::config_t &config, int frames);
+    ~MicroBenchmark();
+
+    static QString caseName(case_t c);
+
+    void setMinTime(int ms);
+    void setRepetitions(int repetitions);
+    void setFilter(const QStringList &names);
+
+    bool prepare();
+    void run();
+    bool writeResults(const QString &filename);
+    bool compareBaseline(const QString &filename, double tolerance_percent);
+
+private:
+    typedef struct {
+        const CanMessage *msg;
+        CanDbSignal *signal;
+    } extract_t;
+
+    typedef struct {
+        uint64_t raw;
+        CanDbSignal *signal;
+    } convert_t;
+
+    SyntheticCanDb::config_t _config;
+    int _numFrames;
+    int _minTime_ms;
+    int _repetitions;
+    QStringList _filter;
+
+    QString _dbcFile;
+    QString _smallDbcFile;
+    MeasurementSetup *_setup;
+    QVector<CanMessage> _frames;
+    QVector<CanMessage> _knownFrames;
+    QVector<CanMessage> _unknownFrames;
+    QVector<extract_t> _extractIntel;
+    QVector<extract_t> _extractMotorola;
+    QVector<convert_t> _convertUnsigned;
+    QVector<convert_t> _convertSigned;
+    int _dbItems;
+    qint64 _dbcBytes;
+
+    uint64_t _sink;
+    QList<QJsonObject> _results;
+
+    int opsPerIteration(case_t c) const;
+    uint64_t runCase(case_t c, uint64_t iterations);
+    bool parseDbc(const QString &filename, CanDb &candb);
+};
@@ -0,0 +1,310 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "SyntheticCanDb.h"
+
+#include <QFile>
+#include <QTextStream>
+#include <math.h>
+
+static const char *namePrefixes[] = {
+    "Engine", "Brake", "Wheel", "Battery", "Motor", "Door", "Steering", "Gear",
+    "Cabin", "Coolant", "Fuel", "Torque", "Charger", "Airbag", "Seat", "Light"
+};
+
+static const char *nameSuffixes[] = {
+    "Speed", "Temp", "Pressure", "Voltage", "Current", "State", "Request", "Counter",
+    "Crc", "Position", "Status", "Level", "Mode", "Fault", "Angle", "Limit"
+};
+
+static const char *messageKinds[] = { "Status", "Command", "Info", "Data", "Diag" };
+
+static const char *units[] = { "", "", "rpm", "degC", "km/h", "V", "A", "%", "Nm", "bar", "deg", "ms" };
+
+static const int signalLengths[] = { 1, 1, 1, 2, 2, 3, 4, 4, 8, 8, 8, 10, 12, 12, 16, 16, 16, 24, 32 };
+
+static const double factors[] = { 1, 1, 1, 0.1, 0.01, 0.5, 0.25, 0.001, 2, 0.0625, 0.03125 };
+
+static const double offsets[] = { 0, 0, 0, 0, -40, -1000, -100, 0.5 };
+
+static const int cycleTimes[] = { 10, 10, 20, 20, 50, 100, 100, 200, 500, 1000 };
+
+static const char *valueNames[] = { "Off", "On", "Error", "NotAvailable", "Init", "Active", "Standby", "Fault" };
+
+#define ARRAY_SIZE(a) ((int)(sizeof(a)/sizeof(a[0])))
+
+SyntheticCanDb::config_t SyntheticCanDb::defaultConfig()
+{
+    config_t config;
+    config.messages = 1000;
+    config.signals_per_message = 12;
+    config.nodes = 24;
+    config.extended_percent = 30;
+    config.motorola_percent = 40;
+    config.signed_percent = 25;
+    config.mux_percent = 10;
+    config.value_table_percent = 50;
+    config.seed = 1;
+    return config;
+}
+
+SyntheticCanDb::SyntheticCanDb(const config_t &config)
+  : _config(config),
+    _rng(0x9E3779B97F4A7C15ULL ^ config.seed)
+{
+    build();
+}
+
+int SyntheticCanDb::countMessages() const
+{
+    return _messages.size();
+}
+
+int SyntheticCanDb::countSignals() const
+{
+    int count = 0;
+    foreach (const message_t &msg, _messages) {
+        count += msg.signalList.size();
+    }
+    return count;
+}
+
+uint32_t SyntheticCanDb::random()
+{
+    // xorshift64, same sequence on every platform for a given seed
+    _rng ^= _rng << 13;
+    _rng ^= _rng >> 7;
+    _rng ^= _rng << 17;
+    return (uint32_t)(_rng >> 32);
+}
+
+int SyntheticCanDb::randomRange(int min, int max)
+{
+    return min + (int)(random() % (uint32_t)(max - min + 1));
+}
+
+bool SyntheticCanDb::randomPercent(int percent)
+{
+    return (int)(random() % 100) < percent;
+}
+
+uint32_t SyntheticCanDb::randomUnusedId(bool extended)
+{
+    while (true) {
+        uint32_t id = extended ? (0x800 + random() % (0x1FFFFFFF - 0x800)) | 0x80000000 : random() % 0x800;
+        if (!_usedIds.contains(id)) {
+            _usedIds.insert(id);
+            return id;
+        }
+    }
+}
+
+void SyntheticCanDb::build()
+{
+    for (int i=0; i<_config.nodes; i++) {
+        _nodes.append(QString("%1Ecu%2").arg(namePrefixes[i % ARRAY_SIZE(namePrefixes)]).arg(i));
+    }
+
+    for (int i=0; i<_config.messages; i++) {
+        message_t msg;
+        // once the 2048 standard ids are used up, the rest has to be extended
+        bool extended = randomPercent(_config.extended_percent) || (_usedIds.size() >= 0x700);
+        msg.raw_id = randomUnusedId(extended);
+        msg.name = QString("%1%2_%3")
+            .arg(namePrefixes[random() % ARRAY_SIZE(namePrefixes)])
+            .arg(messageKinds[random() % ARRAY_SIZE(messageKinds)])
+            .arg(i);
+        msg.dlc = randomPercent(85) ? 8 : randomRange(1, 7);
+        msg.sender = _nodes[random() % _nodes.size()];
+        msg.cycle_ms = cycleTimes[random() % ARRAY_SIZE(cycleTimes)];
+
+        int pos = 0;
+        bool muxed = (msg.dlc >= 2) && randomPercent(_config.mux_percent);
+        if (muxed) {
+            signal_t muxer;
+            muxer.name = QString("%1_Mux").arg(msg.name);
+            muxer.start_bit = 0;
+            muxer.length = 4;
+            muxer.motorola = false;
+            muxer.is_signed = false;
+            muxer.factor = 1;
+            muxer.offset = 0;
+            muxer.mux = mux_muxer;
+            muxer.value_table = false;
+            muxer.receiver = _nodes[random() % _nodes.size()];
+            msg.signalList.append(muxer);
+            pos = 4;
+        }
+
+        for (int j=0; j<_config.signals_per_message; j++) {
+            int length = qMin(signalLengths[random() % ARRAY_SIZE(signalLengths)], 8*msg.dlc - pos);
+            if (length <= 0) {
+                break;
+            }
+
+            signal_t sig;
+            sig.name = QString("%1%2_%3")
+                .arg(namePrefixes[random() % ARRAY_SIZE(namePrefixes)])
+                .arg(nameSuffixes[random() % ARRAY_SIZE(nameSuffixes)])
+                .arg(j);
+            sig.start_bit = pos;
+            sig.length = length;
+            sig.motorola = randomPercent(_config.motorola_percent);
+            sig.is_signed = (length > 1) && randomPercent(_config.signed_percent);
+            sig.factor = factors[random() % ARRAY_SIZE(factors)];
+            sig.offset = sig.is_signed ? 0 : offsets[random() % ARRAY_SIZE(offsets)];
+            sig.unit = units[random() % ARRAY_SIZE(units)];
+            sig.mux = muxed ? (j % 4) : mux_none;
+            sig.value_table = (length <= 4) && randomPercent(_config.value_table_percent);
+            sig.receiver = _nodes[random() % _nodes.size()];
+            msg.signalList.append(sig);
+            pos += length;
+        }
+
+        _messages.append(msg);
+    }
+}
+
+QString SyntheticCanDb::formatNumber(double value)
+{
+    return QString::number(value, 'g', 12);
+}
+
+QString SyntheticCanDb::toDbc() const
+{
+    QString dbc;
+    QTextStream out(&dbc);
+
+    out << "VERSION \"synthetic\"\n\n";
+    out << "NS_ :\n\tNS_DESC_\n\tCM_\n\tBA_DEF_\n\tBA_\n\tVAL_\n\tBA_DEF_DEF_\n\n";
+    out << "BS_:\n\n";
+    out << "BU_: " << _nodes.join(" ") << "\n\n";
+
+    foreach (const message_t &msg, _messages) {
+        out << "BO_ " << msg.raw_id << " " << msg.name << ": " << msg.dlc << " " << msg.sender << "\n";
+        foreach (const signal_t &sig, msg.signalList) {
+            // DBC gives the msb position of Motorola signals in big endian bit numbering
+            int start_bit = sig.start_bit;
+            if (sig.motorola) {
+                start_bit = (start_bit & ~7) + (7 - (start_bit & 7));
+            }
+
+            double raw_min = sig.is_signed ? -ldexp(1, sig.length-1) : 0;
+            double raw_max = sig.is_signed ? ldexp(1, sig.length-1) - 1 : ldexp(1, sig.length) - 1;
+            double min = qMin(raw_min * sig.factor + sig.offset, raw_max * sig.factor + sig.offset);
+            double max = qMax(raw_min * sig.factor + sig.offset, raw_max * sig.factor + sig.offset);
+
+            out << " SG_ " << sig.name;
+            if (sig.mux == mux_muxer) {
+                out << " M";
+            } else if (sig.mux >= 0) {
+                out << " m" << sig.mux;
+            }
+            out << " : " << start_bit << "|" << sig.length << "@" << (sig.motorola ? "0" : "1") << (sig.is_signed ? "-" : "+")
+                << " (" << formatNumber(sig.factor) << "," << formatNumber(sig.offset) << ")"
+                << " [" << formatNumber(min) << "|" << formatNumber(max) << "]"
+                << " \"" << sig.unit << "\" " << sig.receiver << "\n";
+        }
+        out << "\n";
+    }
+
+    out << "CM_ \"Synthetic database, seed " << _config.seed << "\";\n";
+    foreach (const QString &node, _nodes) {
+        out << "CM_ BU_ " << node << " \"Control unit " << node << "\";\n";
+    }
+    foreach (const message_t &msg, _messages) {
+        out << "CM_ BO_ " << msg.raw_id << " \"" << msg.name << ", sent every " << msg.cycle_ms << " ms\";\n";
+        foreach (const signal_t &sig, msg.signalList) {
+            if (sig.value_table || (sig.length >= 16)) {
+                out << "CM_ SG_ " << msg.raw_id << " " << sig.name << " \"" << sig.name << " of " << msg.name << "\";\n";
+            }
+        }
+    }
+    out << "\n";
+
+    out << "BA_DEF_ BO_ \"GenMsgCycleTime\" INT 0 65535;\n";
+    out << "BA_DEF_ SG_ \"GenSigStartValue\" INT 0 2147483647;\n";
+    out << "BA_DEF_DEF_ \"GenMsgCycleTime\" 0;\n";
+    out << "BA_DEF_DEF_ \"GenSigStartValue\" 0;\n";
+    foreach (const message_t &msg, _messages) {
+        out << "BA_ \"GenMsgCycleTime\" BO_ " << msg.raw_id << " " << msg.cycle_ms << ";\n";
+    }
+    out << "\n";
+
+    foreach (const message_t &msg, _messages) {
+        foreach (const signal_t &sig, msg.signalList) {
+            if (!sig.value_table) {
+                continue;
+            }
+            out << "VAL_ " << msg.raw_id << " " << sig.name;
+            int values = qMin(1 << sig.length, ARRAY_SIZE(valueNames));
+            for (int v=values-1; v>=0; v--) {
+                out << " " << v << " \"" << valueNames[v] << "\"";
+            }
+            out << " ;\n";
+        }
+    }
+
+    out.flush();
+    return dbc;
+}
+
+bool SyntheticCanDb::writeDbc(const QString &filename) const
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+    file.write(toDbc().toLatin1());
+    file.close();
+    return true;
+}
+
+QVector<CanMessage> SyntheticCanDb::generateFrames(int count, int unknown_percent)
+{
+    QVector<CanMessage> frames;
+    frames.reserve(count);
+
+    for (int i=0; i<count; i++) {
+        CanMessage frame;
+        if (randomPercent(unknown_percent)) {
+            uint32_t raw_id;
+            do {
+                raw_id = random() % 0x800;
+            } while (_usedIds.contains(raw_id));
+            frame.setRawId(raw_id);
+            frame.setLength(8);
+        } else {
+            const message_t &msg = _messages[random() % _messages.size()];
+            frame.setRawId(msg.raw_id);
+            frame.setLength(msg.dlc);
+        }
+
+        for (int j=0; j<frame.getLength(); j++) {
+            frame.setByte(j, random() & 0xFF);
+        }
+        frame.setTimestampNsecs((1000 + i / 10000) * timestamp_nsecs_per_sec + (i % 10000) * 100 * timestamp_nsecs_per_usec);
+        frames.append(frame);
+    }
+
+    return frames;
+}
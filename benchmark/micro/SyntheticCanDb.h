@@ -0,0 +1,110 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#pragma once
+
+#include <stdint.h>
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QVector>
+#include <QSet>
+#include <core/CanMessage.h>
+
+// Builds a reproducible, realistically shaped CAN database (nodes, standard
+// and extended messages, Intel and Motorola signals of mixed width, signed
+// values, multiplexers, comments, attributes and value tables) and matching
+// frame streams for the micro benchmarks.
+class SyntheticCanDb
+{
+public:
+    typedef struct {
+        int messages;
+        int signals_per_message;  // upper bound, limited by the payload size
+        int nodes;
+        int extended_percent;
+        int motorola_percent;
+        int signed_percent;
+        int mux_percent;          // messages with a multiplexer signal
+        int value_table_percent;  // signals with a VAL_ table
+        uint32_t seed;
+    } config_t;
+
+    static config_t defaultConfig();
+
+    explicit SyntheticCanDb(const config_t &config);
+
+    int countMessages() const;
+    int countSignals() const;
+
+    QString toDbc() const;
+    bool writeDbc(const QString &filename) const;
+
+    /*!
+     * \brief generateFrames frames with random payload for the database messages
+     * \param count number of frames
+     * \param unknown_percent share of frames with ids that are not in the database
+     */
+    QVector<CanMessage> generateFrames(int count, int unknown_percent);
+
+private:
+    typedef struct {
+        QString name;
+        int start_bit;     // Intel-style lsb position in the payload
+        int length;
+        bool motorola;
+        bool is_signed;
+        double factor;
+        double offset;
+        QString unit;
+        int mux;           // mux_none, mux_muxer or the mux value
+        bool value_table;
+        QString receiver;
+    } signal_t;
+
+    typedef struct {
+        uint32_t raw_id;
+        QString name;
+        int dlc;
+        QString sender;
+        int cycle_ms;
+        QList<signal_t> signalList;
+    } message_t;
+
+    enum {
+        mux_none = -2,
+        mux_muxer = -1
+    };
+
+    config_t _config;
+    QStringList _nodes;
+    QList<message_t> _messages;
+    QSet<uint32_t> _usedIds;
+    uint64_t _rng;
+
+    uint32_t random();
+    int randomRange(int min, int max);
+    bool randomPercent(int percent);
+    uint32_t randomUnusedId(bool extended);
+    void build();
+    static QString formatNumber(double value);
+};
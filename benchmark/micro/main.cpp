@@ -0,0 +1,126 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QTextStream>
+
+#include <tracefile/PcapTraceFile.h>
+
+#include "MicroBenchmark.h"
+#include "SyntheticCanDb.h"
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("cangaroo-bench-micro");
+
+    SyntheticCanDb::config_t config = SyntheticCanDb::defaultConfig();
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Micro benchmarks for signal decoding, database lookup, formatting and DBC parsing.");
+    parser.addHelpOption();
+    QCommandLineOption messagesOption("messages", "Messages in the synthetic database (default 1000).", "count", QString::number(config.messages));
+    QCommandLineOption signalsOption("signals", "Maximum signals per message (default 12).", "count", QString::number(config.signals_per_message));
+    QCommandLineOption seedOption("seed", "Seed for the synthetic data (default 1).", "seed", QString::number(config.seed));
+    QCommandLineOption framesOption("frames", "Frames in the synthetic stream (default 100000).", "count", "100000");
+    QCommandLineOption minTimeOption("min-time", "Minimum run time per measurement in ms (default 250).", "ms", "250");
+    QCommandLineOption repetitionsOption("repetitions", "Measurements per case, the median is reported (default 5).", "count", "5");
+    QCommandLineOption caseOption("case", "Only run the named case, may be given multiple times.", "name");
+    QCommandLineOption outputOption("output", "JSON result file (default micro-benchmark.json).", "file", "micro-benchmark.json");
+    QCommandLineOption baselineOption("baseline", "Compare against a previous JSON result and fail on regressions.", "file");
+    QCommandLineOption toleranceOption("tolerance", "Allowed slowdown against the baseline in percent (default 10).", "percent", "10");
+    QCommandLineOption writeDbcOption("write-dbc", "Write the synthetic database to a file and exit.", "file");
+    QCommandLineOption writeFramesOption("write-frames", "Write the synthetic frame stream as pcapng and exit.", "file");
+    QCommandLineOption listOption("list", "List the cases and exit.");
+    parser.addOption(messagesOption);
+    parser.addOption(signalsOption);
+    parser.addOption(seedOption);
+    parser.addOption(framesOption);
+    parser.addOption(minTimeOption);
+    parser.addOption(repetitionsOption);
+    parser.addOption(caseOption);
+    parser.addOption(outputOption);
+    parser.addOption(baselineOption);
+    parser.addOption(toleranceOption);
+    parser.addOption(writeDbcOption);
+    parser.addOption(writeFramesOption);
+    parser.addOption(listOption);
+    parser.process(app);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    if (parser.isSet(listOption)) {
+        for (int i=0; i<MicroBenchmark::case_count; i++) {
+            out << MicroBenchmark::caseName((MicroBenchmark::case_t)i) << Qt::endl;
+        }
+        return 0;
+    }
+
+    config.messages = qMax(1, parser.value(messagesOption).toInt());
+    config.signals_per_message = qMax(1, parser.value(signalsOption).toInt());
+    config.seed = parser.value(seedOption).toUInt();
+    int frames = qMax(1, parser.value(framesOption).toInt());
+
+    if (parser.isSet(writeDbcOption) || parser.isSet(writeFramesOption)) {
+        SyntheticCanDb db(config);
+        if (parser.isSet(writeDbcOption)) {
+            if (!db.writeDbc(parser.value(writeDbcOption))) {
+                err << "cannot write " << parser.value(writeDbcOption) << Qt::endl;
+                return 2;
+            }
+            out << QString("wrote %1 messages, %2 signals to %3").arg(db.countMessages()).arg(db.countSignals()).arg(parser.value(writeDbcOption)) << Qt::endl;
+        }
+        if (parser.isSet(writeFramesOption)) {
+            PcapngTraceWriter writer;
+            if (!writer.open(parser.value(writeFramesOption))) {
+                err << "cannot write " << parser.value(writeFramesOption) << ": " << writer.errorString() << Qt::endl;
+                return 2;
+            }
+            foreach (const CanMessage &msg, db.generateFrames(frames, MicroBenchmark::unknown_percent)) {
+                writer.addMessage(msg);
+            }
+            writer.close();
+            out << QString("wrote %1 frames to %2").arg(frames).arg(parser.value(writeFramesOption)) << Qt::endl;
+        }
+        return 0;
+    }
+
+    MicroBenchmark bench(config, frames);
+    bench.setMinTime(qMax(1, parser.value(minTimeOption).toInt()));
+    bench.setRepetitions(qMax(1, parser.value(repetitionsOption).toInt()));
+    bench.setFilter(parser.values(caseOption));
+
+    if (!bench.prepare()) {
+        return 2;
+    }
+    bench.run();
+
+    if (!bench.writeResults(parser.value(outputOption))) {
+        return 2;
+    }
+    if (parser.isSet(baselineOption) && !bench.compareBaseline(parser.value(baselineOption), parser.value(toleranceOption).toDouble())) {
+        return 1;
+    }
+    return 0;
+}
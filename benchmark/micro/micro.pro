@@ -0,0 +1,38 @@
+lessThan(QT_MAJOR_VERSION, 6): error("requires Qt 6")
+
+QT += core gui
+QT += widgets
+QT += xml
+QT += charts
+QT += serialport
+
+TARGET = cangaroo-bench-micro
+TEMPLATE = app
+CONFIG += console warn_on c++20
+CONFIG -= app_bundle
+
+SRC = $$PWD/../../src
+INCLUDEPATH += $$SRC
+
+DESTDIR = ../../bin
+MOC_DIR = ../../build/bench-micro/moc
+RCC_DIR = ../../build/bench-micro/rcc
+UI_DIR = ../../build/bench-micro/ui
+OBJECTS_DIR = ../../build/bench-micro/o
+
+SOURCES += \
+    main.cpp \
+    MicroBenchmark.cpp \
+    SyntheticCanDb.cpp
+
+HEADERS += \
+    MicroBenchmark.h \
+    SyntheticCanDb.h
+
+# decoding and parsing live in core and the dbc parser, the backend they
+# log through pulls in the drivers and the setup dialog
+include($$SRC/core/core.pri)
+include($$SRC/driver/driver.pri)
+include($$SRC/parser/dbc/dbc.pri)
+include($$SRC/tracefile/tracefile.pri)
+include($$SRC/window/SetupDialog/SetupDialog.pri)
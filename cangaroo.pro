@@ -2,6 +2,8 @@ QT += charts
 
 # QT += network
 SUBDIRS += src
+SUBDIRS += benchmark
+SUBDIRS += tests
 TEMPLATE = subdirs
 CONFIG += ordered warn_on qt debug_and_release
 CONFIG += c++20
@@ -23,6 +23,7 @@
 #include "LogModel.h"
 
 #include <QDateTime>
+#include <QCoreApplication>
 
 #include <core/CanTrace.h>
 #include <core/MeasurementSetup.h>
@@ -32,6 +33,8 @@
 #include <driver/CanInterface.h>
 #include <driver/CanListener.h>
 #include <parser/dbc/DbcParser.h>
+#include <tracefile/TraceRecorder.h>
+#include <tracefile/TraceReplay.h>
 
 Backend *Backend::_instance = 0;
 
@@ -39,12 +42,18 @@ Backend::Backend()
   : QObject(0),
     _measurementRunning(false),
     _measurementStartTime(0),
-    _setup(this)
+    _setup(this),
+    _logModel(0)
 {
-    _logModel = new LogModel(*this);
+    // without a GUI the log model would only collect messages nobody reads
+    if (QCoreApplication::instance() && QCoreApplication::instance()->inherits("QApplication")) {
+        _logModel = new LogModel(*this);
+    }
 
     setDefaultSetup();
     _trace = new CanTrace(*this, this, 1);
+    _recorder = new TraceRecorder(*this, this);
+    _replay = new TraceReplay(*this, this);
 
     connect(&_setup, SIGNAL(onSetupChanged()), this, SIGNAL(onSetupChanged()));
 }
@@ -59,6 +68,8 @@ Backend &Backend::instance()
 
 Backend::~Backend()
 {
+    delete _replay;
+    delete _recorder;
     delete _trace;
 }
 
@@ -72,9 +83,13 @@ bool Backend::startMeasurement()
 {
     log_info(tr("Starting measurement"));
 
-    _measurementStartTime = QDateTime::currentMSecsSinceEpoch();
+    _measurementStartTime = currentTimestamp();
     _timerSinceStart.start();
 
+    if (_recorder->isEnabled()) {
+        _recorder->start(*_trace);
+    }
+
     int i=0;
     foreach (MeasurementNetwork *network, _setup.getNetworks()) {
         i++;
@@ -100,6 +115,9 @@ bool Backend::startMeasurement()
 bool Backend::stopMeasurement()
 {
     if (_measurementRunning) {
+        // the replay sends on the interfaces the listeners are about to close
+        _replay->stop();
+
         foreach (CanListener *listener, _listeners) {
             listener->requestStop();
         }
@@ -112,6 +130,10 @@ bool Backend::stopMeasurement()
         qDeleteAll(_listeners);
         _listeners.clear();
 
+        // listeners flush their queues into the trace when deleted,
+        // so the recorder has seen every frame by now
+        _recorder->stop();
+
         log_info(tr("Measurement stopped"));
 
         _measurementRunning = false;
@@ -161,9 +183,38 @@ void Backend::setSetup(MeasurementSetup &new_setup)
     _setup.cloneFrom(new_setup);
 }
 
-double Backend::currentTimeStamp() const
+bool Backend::loadWorkspaceXML(QDomElement &root)
 {
-    return ((double)QDateTime::currentMSecsSinceEpoch()) / 1000;
+    QDomElement traceRoot = root.firstChildElement("trace");
+    _trace->loadXML(*this, traceRoot);
+
+    QDomElement recorderRoot = root.firstChildElement("recorder");
+    _recorder->loadXML(*this, recorderRoot);
+
+    QDomElement replayRoot = root.firstChildElement("replay");
+    _replay->loadXML(*this, replayRoot);
+
+    // generators must exist before the setup refers to them
+    CanDriver *generators = getDriverByName("Generator");
+    QDomElement generatorRoot = root.firstChildElement("generators");
+    if (generators && !generatorRoot.isNull()) {
+        generators->loadXML(*this, generatorRoot);
+    }
+
+    // same for capture files, which also keep their playback mode
+    CanDriver *files = getDriverByName("File");
+    QDomElement filesRoot = root.firstChildElement("files");
+    if (files && !filesRoot.isNull()) {
+        files->loadXML(*this, filesRoot);
+    }
+
+    QDomElement setupRoot = root.firstChildElement("setup");
+    MeasurementSetup setup(this);
+    if (!setup.loadXML(*this, setupRoot)) {
+        return false;
+    }
+    setSetup(setup);
+    return true;
 }
 
 CanTrace *Backend::getTrace()
@@ -176,6 +227,16 @@ void Backend::clearTrace()
     _trace->clear();
 }
 
+TraceRecorder *Backend::getRecorder()
+{
+    return _recorder;
+}
+
+TraceReplay *Backend::getReplay()
+{
+    return _replay;
+}
+
 CanDbMessage *Backend::findDbMessage(const CanMessage &msg) const
 {
     return _setup.findDbMessage(msg);
@@ -259,22 +320,27 @@ pCanDb Backend::loadDbc(QString filename)
 
 void Backend::clearLog()
 {
-    _logModel->clear();
+    if (_logModel) {
+        _logModel->clear();
+    }
 }
 
-LogModel &Backend::getLogModel() const
+LogModel &Backend::getLogModel()
 {
+    if (!_logModel) {
+        _logModel = new LogModel(*this);
+    }
     return *_logModel;
 }
 
-double Backend::getTimestampAtMeasurementStart() const
+CanTimestamp Backend::getNsecsAtMeasurementStart() const
 {
-    return (double)_measurementStartTime / 1000.0;
+    return _measurementStartTime;
 }
 
 uint64_t Backend::getUsecsAtMeasurementStart() const
 {
-    return _measurementStartTime * 1000;
+    return _measurementStartTime / timestamp_nsecs_per_usec;
 }
 
 uint64_t Backend::getNsecsSinceMeasurementStart() const
@@ -29,11 +29,14 @@
 #include <QElapsedTimer>
 #include <driver/CanDriver.h>
 #include <core/CanDb.h>
+#include <core/CanTimestamp.h>
 #include <core/MeasurementSetup.h>
 #include <core/Log.h>
 
 class MeasurementNetwork;
 class CanTrace;
+class TraceRecorder;
+class TraceReplay;
 class CanListener;
 class CanDbMessage;
 class SetupDialog;
@@ -50,10 +53,13 @@ public:
 
     void addCanDriver(CanDriver &driver);
 
+    // the drivers of the application, for this platform (BackendDrivers.cpp)
+    void addDefaultDrivers();
+
     bool startMeasurement();
     bool stopMeasurement();
     bool isMeasurementRunning() const;
-    double getTimestampAtMeasurementStart() const;
+    CanTimestamp getNsecsAtMeasurementStart() const;
     uint64_t getUsecsAtMeasurementStart() const;
     uint64_t getNsecsSinceMeasurementStart() const;
     uint64_t getUsecsSinceMeasurementStart() const;
@@ -66,11 +72,16 @@ public:
     void setDefaultSetup();
     void setSetup(MeasurementSetup &new_setup);
 
-    double currentTimeStamp() const;
+    // loads everything in a workspace file that is not a window:
+    // trace, recorder and replay settings, generator interfaces and the setup
+    bool loadWorkspaceXML(QDomElement &root);
 
     CanTrace *getTrace();
     void clearTrace();
 
+    TraceRecorder *getRecorder();
+    TraceReplay *getReplay();
+
     CanDbMessage *findDbMessage(const CanMessage &msg) const;
 
     CanInterfaceIdList getInterfaceList();
@@ -85,7 +96,7 @@ public:
     pCanDb loadDbc(QString filename);
 
     void clearLog();
-    LogModel &getLogModel() const;
+    LogModel &getLogModel();
 
 signals:
     void beginMeasurement();
@@ -103,11 +114,13 @@ private:
     static Backend *_instance;
 
     bool _measurementRunning;
-    uint64_t _measurementStartTime;
+    CanTimestamp _measurementStartTime;
     QElapsedTimer _timerSinceStart;
     QList<CanDriver*> _drivers;
     MeasurementSetup _setup;
     CanTrace *_trace;
+    TraceRecorder *_recorder;
+    TraceReplay *_replay;
     QList<CanListener*> _listeners;
 
     LogModel *_logModel;
@@ -0,0 +1,49 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "Backend.h"
+
+#include <driver/SLCANDriver/SLCANDriver.h>
+#include <driver/GrIPDriver/GrIPDriver.h>
+#include <driver/FileCanDriver/FileCanDriver.h>
+#include <driver/GeneratorDriver/GeneratorDriver.h>
+
+#if defined(__linux__)
+#include <driver/SocketCanDriver/SocketCanDriver.h>
+#else
+#include <driver/CandleApiDriver/CandleApiDriver.h>
+#endif
+
+// Kept apart from Backend.cpp: the benchmarks and tests link the core
+// without the hardware drivers.
+void Backend::addDefaultDrivers()
+{
+#if defined(__linux__)
+    addCanDriver(*(new SocketCanDriver(*this)));
+#else
+    addCanDriver(*(new CandleApiDriver(*this)));
+#endif
+    addCanDriver(*(new SLCANDriver(*this)));
+    addCanDriver(*(new GrIPDriver(*this)));
+    addCanDriver(*(new FileCanDriver(*this)));
+    addCanDriver(*(new GeneratorDriver(*this)));
+    // addCanDriver(*(new CANBlasterDriver(*this)));
+}
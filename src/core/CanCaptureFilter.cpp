@@ -0,0 +1,113 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "CanCaptureFilter.h"
+
+#include <QStringList>
+
+static const uint32_t id_mask_standard = 0x7FF;
+static const uint32_t id_mask_extended = 0x1FFFFFFF;
+
+CanCaptureFilter::CanCaptureFilter()
+  : _errorMask(0)
+{
+}
+
+bool CanCaptureFilter::parse(const QString &str)
+{
+    QList<rule_t> rules;
+    uint32_t errorMask = 0;
+
+    foreach (QString item, str.split(',', Qt::SkipEmptyParts)) {
+        item = item.trimmed();
+        if (item.isEmpty()) {
+            continue;
+        }
+
+        bool ok;
+        if (item.startsWith('#')) {
+            errorMask |= item.mid(1).toUInt(&ok, 16);
+            if (!ok) { return false; }
+            continue;
+        }
+
+        int sep = item.indexOf(':');
+        bool inverted = false;
+        if (sep < 0) {
+            sep = item.indexOf('~');
+            inverted = true;
+        }
+        if (sep <= 0) {
+            return false;
+        }
+
+        rule_t rule;
+        rule.extended = (sep == 8);
+        rule.inverted = inverted;
+
+        uint32_t id_mask = rule.extended ? id_mask_extended : id_mask_standard;
+        rule.id = item.left(sep).toUInt(&ok, 16);
+        if (!ok || (rule.id > id_mask)) { return false; }
+        rule.mask = item.mid(sep+1).toUInt(&ok, 16) & id_mask;
+        if (!ok) { return false; }
+
+        rules.append(rule);
+    }
+
+    if (rules.size() > max_rules) {
+        return false;
+    }
+
+    _rules = rules;
+    _errorMask = errorMask;
+    return true;
+}
+
+QString CanCaptureFilter::toString() const
+{
+    QStringList items;
+    foreach (const rule_t &rule, _rules) {
+        int width = rule.extended ? 8 : 3;
+        items.append(QString("%1%2%3")
+                     .arg(rule.id, width, 16, QChar('0'))
+                     .arg(QString(rule.inverted ? "~" : ":"))
+                     .arg(rule.mask, width, 16, QChar('0')).toUpper());
+    }
+    if (_errorMask) {
+        items.append(QString("#%1").arg(_errorMask, 8, 16, QChar('0')).toUpper());
+    }
+    return items.join(",");
+}
+
+bool CanCaptureFilter::isEmpty() const
+{
+    return _rules.isEmpty() && (_errorMask==0);
+}
+
+const QList<CanCaptureFilter::rule_t> &CanCaptureFilter::rules() const
+{
+    return _rules;
+}
+
+uint32_t CanCaptureFilter::errorMask() const
+{
+    return _errorMask;
+}
@@ -0,0 +1,62 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <QString>
+#include <QList>
+
+// Acceptance filter for an interface, in the candump syntax:
+//   "123:7FF"       accept standard ids where (id & 7FF) == 123
+//   "18DA00F1:1FFFFF00"  eight hex digits make it an extended id
+//   "100~700"       inverted, accept everything that does NOT match
+//   "#FFFFFFFF"     error frame classes to deliver (CAN_ERR_* mask)
+// Rules are comma separated, a frame is captured if any rule matches.
+// Without rules every data frame is captured; error frames only when
+// an error mask is given.
+class CanCaptureFilter
+{
+public:
+    typedef struct {
+        uint32_t id;
+        uint32_t mask;
+        bool extended;
+        bool inverted;
+    } rule_t;
+
+    enum {
+        max_rules = 512 // CAN_RAW_FILTER_MAX of the kernel
+    };
+
+    CanCaptureFilter();
+
+    bool parse(const QString &str);
+    QString toString() const;
+
+    bool isEmpty() const;
+    const QList<rule_t> &rules() const;
+    uint32_t errorMask() const;
+
+private:
+    QList<rule_t> _rules;
+    uint32_t _errorMask;
+};
@@ -30,6 +30,12 @@ CanDb::CanDb()
 
 }
 
+CanDb::~CanDb()
+{
+    qDeleteAll(_messages);
+    qDeleteAll(_nodes);
+}
+
 QString CanDb::getFileName()
 {
     QFileInfo fi(getPath());
@@ -75,6 +81,11 @@ CanDbMessageList CanDb::getMessageList()
 
 void CanDb::addMessage(CanDbMessage *msg)
 {
+    // a later definition of the same id replaces the earlier one
+    CanDbMessage *old = _messages.value(msg->getRaw_id(), 0);
+    if (old != msg) {
+        delete old;
+    }
     _messages[msg->getRaw_id()] = msg;
 }
 
@@ -40,10 +40,14 @@ typedef QMap<QString,CanDbNode*> CanDbNodeMap;
 typedef QMap<uint32_t, CanDbMessage*> CanDbMessageList;
 typedef QSharedPointer<CanDb> pCanDb;
 
+// Owns its nodes and messages, which in turn own their signals.
 class CanDb
 {
+    Q_DISABLE_COPY(CanDb)
+
     public:
         CanDb();
+        ~CanDb();
 
         void setPath(QString path) { _path = path; }
         QString getPath() { return _path; }
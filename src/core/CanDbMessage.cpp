@@ -26,6 +26,11 @@ CanDbMessage::CanDbMessage(CanDb *parent)
 {
 }
 
+CanDbMessage::~CanDbMessage()
+{
+    qDeleteAll(_signals);
+}
+
 QString CanDbMessage::getName() const
 {
     return _name;
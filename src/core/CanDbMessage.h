@@ -33,8 +33,11 @@ typedef QList<CanDbSignal*> CanDbSignalList;
 
 class CanDbMessage
 {
+    Q_DISABLE_COPY(CanDbMessage)
+
     public:
         CanDbMessage(CanDb *parent);
+        ~CanDbMessage();
 
         QString getName() const;
         void setName(const QString &name);
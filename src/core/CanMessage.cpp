@@ -33,18 +33,13 @@ enum {
 };
 
 CanMessage::CanMessage()
-    : _raw_id(0), _dlc(0), _isFD(false), _isBRS(false), _isRX(true), _isShow(true), _interface(0), _u8()
+    : _raw_id(0), _dlc(0), _isFD(false), _isBRS(false), _isRX(true), _isShow(true), _interface(0), _u8(), _timestamp(0)
 {
-    _timestamp.tv_sec = 0;
-    _timestamp.tv_usec = 0;
-
 }
 
 CanMessage::CanMessage(uint32_t can_id)
-    : _dlc(0), _isFD(false), _isBRS(false), _isRX(true), _isShow(true), _interface(0), _u8()
+    : _dlc(0), _isFD(false), _isBRS(false), _isRX(true), _isShow(true), _interface(0), _u8(), _timestamp(0)
 {
-    _timestamp.tv_sec = 0;
-    _timestamp.tv_usec = 0;
     setId(can_id);
 }
 
@@ -316,30 +311,29 @@ void CanMessage::setData(const uint8_t d0, const uint8_t d1, const uint8_t d2,
     _u8[7] = d7;
 }
 
-timeval CanMessage::getTimestamp() const
+CanTimestamp CanMessage::getTimestampNsecs() const
 {
     return _timestamp;
 }
 
-void CanMessage::setTimestamp(const timeval timestamp)
+void CanMessage::setTimestampNsecs(const CanTimestamp timestamp)
 {
     _timestamp = timestamp;
 }
 
-void CanMessage::setTimestamp(const uint64_t seconds, const uint32_t micro_seconds)
+void CanMessage::setTimestamp(const timeval timestamp)
 {
-    _timestamp.tv_sec = seconds;
-    _timestamp.tv_usec = micro_seconds;
+    _timestamp = timestampFromTimeval(timestamp);
 }
 
-double CanMessage::getFloatTimestamp() const
+void CanMessage::setTimestamp(const timespec timestamp)
 {
-    return (double)_timestamp.tv_sec + ((double)_timestamp.tv_usec/1000000);
+    _timestamp = timestampFromTimespec(timestamp);
 }
 
 QDateTime CanMessage::getDateTime() const
 {
-    return QDateTime::fromMSecsSinceEpoch((qint64)(1000*getFloatTimestamp()));
+    return QDateTime::fromMSecsSinceEpoch(_timestamp / timestamp_nsecs_per_msec);
 }
 
 QString CanMessage::getIdString() const
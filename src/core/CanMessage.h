@@ -27,6 +27,7 @@
 #include <QString>
 #include <QDateTime>
 #include <driver/CanDriver.h>
+#include <core/CanTimestamp.h>
 
 
 class CanMessage
@@ -87,11 +88,11 @@ public:
 	void setData(const uint8_t d0, const uint8_t d1, const uint8_t d2, const uint8_t d3, const uint8_t d4, const uint8_t d5, const uint8_t d6);
 	void setData(const uint8_t d0, const uint8_t d1, const uint8_t d2, const uint8_t d3, const uint8_t d4, const uint8_t d5, const uint8_t d6, const uint8_t d7);
 
-    struct timeval getTimestamp() const;
+    CanTimestamp getTimestampNsecs() const;
+    void setTimestampNsecs(const CanTimestamp timestamp);
     void setTimestamp(const struct timeval timestamp);
-    void setTimestamp(const uint64_t seconds, const uint32_t micro_seconds);
+    void setTimestamp(const struct timespec timestamp);
 
-    double getFloatTimestamp() const;
     QDateTime getDateTime() const;
 
     QString getIdString() const;
@@ -112,6 +113,6 @@ private:
         uint32_t _u32[2*8];
         uint64_t _u64[8];
 	};
-    struct timeval _timestamp;
+    CanTimestamp _timestamp;
 
 };
@@ -0,0 +1,89 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "CanMessageQueue.h"
+
+CanMessageQueue::CanMessageQueue(unsigned capacity_log2)
+  : _buf(new CanMessage[1u << capacity_log2]),
+    _mask((1u << capacity_log2) - 1),
+    _head(0),
+    _tail(0),
+    _dropped(0)
+{
+}
+
+CanMessageQueue::~CanMessageQueue()
+{
+    delete[] _buf;
+}
+
+bool CanMessageQueue::push(const CanMessage &msg)
+{
+    return push(&msg, 1) == 1;
+}
+
+int CanMessageQueue::push(const CanMessage *msgs, int count)
+{
+    quint32 head = _head.loadRelaxed();
+    quint32 space = capacity() - (head - _tail.loadAcquire());
+
+    int n = ((quint32)count > space) ? space : count;
+    for (int i=0; i<n; i++) {
+        _buf[(head + i) & _mask].cloneFrom(msgs[i]);
+    }
+    _head.storeRelease(head + n);
+
+    if (n < count) {
+        _dropped.fetchAndAddRelaxed(count - n);
+    }
+    return n;
+}
+
+int CanMessageQueue::available() const
+{
+    return _head.loadAcquire() - _tail.loadRelaxed();
+}
+
+const CanMessage &CanMessageQueue::at(int i) const
+{
+    return _buf[(_tail.loadRelaxed() + i) & _mask];
+}
+
+void CanMessageQueue::release(int count)
+{
+    _tail.storeRelease(_tail.loadRelaxed() + count);
+}
+
+unsigned CanMessageQueue::capacity() const
+{
+    return _mask + 1;
+}
+
+uint64_t CanMessageQueue::droppedCount() const
+{
+    return _dropped.loadRelaxed();
+}
+
+void CanMessageQueue::resetDroppedCount()
+{
+    _dropped.storeRelaxed(0);
+}
@@ -0,0 +1,64 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#pragma once
+
+#include <stdint.h>
+#include <QAtomicInteger>
+#include "CanMessage.h"
+
+// Lock-free single-producer/single-consumer ring buffer of CanMessages.
+//
+// Each CanListener owns one queue and is its only producer; CanTrace is the
+// only consumer and drains all queues in batches from flushQueue(). Neither
+// side ever blocks: when the ring is full, push() drops the frame and counts
+// it instead of waiting for the consumer.
+class CanMessageQueue
+{
+    Q_DISABLE_COPY(CanMessageQueue)
+
+public:
+    explicit CanMessageQueue(unsigned capacity_log2=16);
+    ~CanMessageQueue();
+
+    // producer side
+    bool push(const CanMessage &msg);
+    int push(const CanMessage *msgs, int count);
+
+    // consumer side
+    int available() const;
+    const CanMessage &at(int i) const;
+    void release(int count);
+
+    unsigned capacity() const;
+    uint64_t droppedCount() const;
+    void resetDroppedCount();
+
+private:
+    CanMessage *_buf;
+    uint32_t _mask;
+
+    // free-running indices, only the owning side writes to each of them
+    QAtomicInteger<quint32> _head; // written by producer
+    QAtomicInteger<quint32> _tail; // written by consumer
+    QAtomicInteger<quint64> _dropped;
+};
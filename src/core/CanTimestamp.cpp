@@ -0,0 +1,114 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "CanTimestamp.h"
+
+#if defined(_MSC_VER)
+#include <winsock2.h> // struct timeval
+#else
+#include <sys/time.h>
+#endif
+#include <time.h>
+#include <chrono>
+#include <QDateTime>
+
+static const uint32_t powersOf10[] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+CanTimestamp timestampFromTimeval(const struct timeval &tv)
+{
+    return (CanTimestamp)tv.tv_sec * timestamp_nsecs_per_sec + (CanTimestamp)tv.tv_usec * timestamp_nsecs_per_usec;
+}
+
+CanTimestamp timestampFromTimespec(const struct timespec &ts)
+{
+    return (CanTimestamp)ts.tv_sec * timestamp_nsecs_per_sec + ts.tv_nsec;
+}
+
+CanTimestamp currentTimestamp()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+static char *putFraction(char *p, uint32_t frac_ns, int decimals)
+{
+    if (decimals <= 0) {
+        return p;
+    }
+    if (decimals > 9) {
+        decimals = 9;
+    }
+
+    *p++ = '.';
+    uint32_t v = frac_ns / powersOf10[9 - decimals];
+    for (int i=decimals-1; i>=0; i--) {
+        p[i] = '0' + (v % 10);
+        v /= 10;
+    }
+    return p + decimals;
+}
+
+char *formatTimestamp(char *buf, CanTimestamp ns, int decimals)
+{
+    char *p = buf;
+    uint64_t v = (uint64_t)ns;
+    if (ns < 0) {
+        *p++ = '-';
+        v = 0 - v;
+    }
+
+    uint64_t secs = v / timestamp_nsecs_per_sec;
+    char tmp[20];
+    char *t = tmp + sizeof(tmp);
+    do {
+        *--t = '0' + (secs % 10);
+        secs /= 10;
+    } while (secs);
+    while (t < tmp + sizeof(tmp)) {
+        *p++ = *t++;
+    }
+
+    return putFraction(p, v % timestamp_nsecs_per_sec, decimals);
+}
+
+QString formatTimestamp(CanTimestamp ns, int decimals)
+{
+    char buf[timestamp_max_chars];
+    char *end = formatTimestamp(buf, ns, decimals);
+    return QString::fromLatin1(buf, end - buf);
+}
+
+QString formatTimeOfDay(CanTimestamp ns, int decimals)
+{
+    // floor, so times before the epoch still get a positive fraction
+    CanTimestamp secs = ns / timestamp_nsecs_per_sec;
+    CanTimestamp frac = ns % timestamp_nsecs_per_sec;
+    if (frac < 0) {
+        secs--;
+        frac += timestamp_nsecs_per_sec;
+    }
+
+    char buf[16];
+    char *end = putFraction(buf, (uint32_t)frac, decimals);
+    return QDateTime::fromSecsSinceEpoch(secs).toString("hh:mm:ss") + QString::fromLatin1(buf, end - buf);
+}
@@ -0,0 +1,57 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#pragma once
+
+#include <stdint.h>
+#include <QString>
+
+struct timeval;
+struct timespec;
+
+// Frame timestamps are nanoseconds since the Unix epoch in a signed 64 bit
+// integer, which covers the years 1678 to 2262. Differences between two
+// timestamps use the same type. They are formatted with integer arithmetic
+// only, so no precision is lost and no floating point conversion happens
+// in the views and exporters.
+typedef int64_t CanTimestamp;
+
+const CanTimestamp timestamp_nsecs_per_usec = 1000;
+const CanTimestamp timestamp_nsecs_per_msec = 1000000;
+const CanTimestamp timestamp_nsecs_per_sec = 1000000000;
+
+enum {
+    timestamp_max_chars = 32 // "-9223372036.854775808" and then some
+};
+
+CanTimestamp timestampFromTimeval(const struct timeval &tv);
+CanTimestamp timestampFromTimespec(const struct timespec &ts);
+CanTimestamp currentTimestamp();
+
+// Seconds with 0 to 9 decimals, truncated towards zero, e.g. "12.345678" or
+// "-0.000125". Writes at most timestamp_max_chars characters without a
+// terminating zero and returns the end of the output.
+char *formatTimestamp(char *buf, CanTimestamp ns, int decimals);
+QString formatTimestamp(CanTimestamp ns, int decimals);
+
+// Local time of day with 0 to 9 decimals, e.g. "14:03:27.123456"
+QString formatTimeOfDay(CanTimestamp ns, int decimals);
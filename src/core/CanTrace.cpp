@@ -22,10 +22,12 @@
 #include "CanTrace.h"
 #include <QMutexLocker>
 #include <QFile>
-#include <QTextStream>
+#include <QVarLengthArray>
+#include <algorithm>
 
 #include <core/Backend.h>
 #include <core/CanMessage.h>
+#include <core/CanMessageQueue.h>
 #include <core/CanDbMessage.h>
 #include <core/CanDbSignal.h>
 #include <driver/CanInterface.h>
@@ -33,15 +35,25 @@
 CanTrace::CanTrace(Backend &backend, QObject *parent, int flushInterval)
   : QObject(parent),
     _backend(backend),
-    _isTimerRunning(false),
+    _memoryUsage(0),
+    _removedRows(0),
+    _isTimerRunning(0),
+    _droppedFrames(0),
+    _retentionMode(retention_unlimited),
+    _retentionLimit(0),
     _mutex(),
-    _timerMutex(),
     _flushTimer(this)
 {
     clear();
     _flushTimer.setSingleShot(true);
     _flushTimer.setInterval(flushInterval);
     connect(&_flushTimer, SIGNAL(timeout()), this, SLOT(flushQueue()));
+    connect(&backend, SIGNAL(onSetupChanged()), this, SLOT(onSetupChanged()));
+}
+
+CanTrace::~CanTrace()
+{
+    freeChunks();
 }
 
 unsigned long CanTrace::size()
@@ -54,56 +66,212 @@ void CanTrace::clear()
 {
     QMutexLocker locker(&_mutex);
     emit beforeClear();
-    _data.resize(pool_chunk_size);
+    freeChunks();
+    _idIndex.clear();
+    _removedRows = 0;
     _dataRowsUsed = 0;
     _newRows = 0;
     emit afterClear();
 }
 
-const CanMessage *CanTrace::getMessage(int idx)
+const CanTraceFrame *CanTrace::getMessage(int idx)
 {
     QMutexLocker locker(&_mutex);
-    if (idx >= (_dataRowsUsed + _newRows)) {
+    if ((idx < 0) || (idx >= (_dataRowsUsed + _newRows))) {
         return 0;
     } else {
-        return &_data[idx];
+        return &frameAt(idx);
     }
 }
 
 void CanTrace::enqueueMessage(const CanMessage &msg, bool more_to_follow)
 {
-    QMutexLocker locker(&_mutex);
+    enqueueMessages(&msg, 1, more_to_follow);
+}
 
-    int idx = size() + _newRows;
-    if (idx>=_data.size()) {
-        _data.resize(_data.size() + pool_chunk_size);
+void CanTrace::enqueueMessages(const CanMessage *msgs, int count, bool more_to_follow)
+{
+    if (count<1) {
+        return;
     }
 
-    _data[idx].cloneFrom(msg);
-    _newRows++;
+    QMutexLocker locker(&_mutex);
+
+    int first_idx = _dataRowsUsed + _newRows;
+    for (int i=0; i<count; i++) {
+        appendMessage(msgs[i]);
+    }
 
     if (!more_to_follow) {
         startTimer();
     }
 
-    emit messageEnqueued(idx);
+    emit messagesEnqueued(first_idx, count);
 }
 
-void CanTrace::flushQueue()
+void CanTrace::enqueueMessages(const QList<CanMessage> &msgs, bool more_to_follow)
+{
+    enqueueMessages(msgs.constData(), msgs.size(), more_to_follow);
+}
+
+void CanTrace::attachQueue(CanMessageQueue *queue)
+{
+    QMutexLocker locker(&_mutex);
+    _queues.append(queue);
+}
+
+void CanTrace::detachQueue(CanMessageQueue *queue)
+{
+    // make sure frames still waiting in the queue end up in the trace
+    flushQueue();
+
+    QMutexLocker locker(&_mutex);
+    _droppedFrames += queue->droppedCount();
+    _queues.removeAll(queue);
+}
+
+void CanTrace::notifyQueued()
+{
+    startTimer();
+}
+
+uint64_t CanTrace::memoryUsage()
 {
-    {
-        QMutexLocker locker(&_timerMutex);
-        _isTimerRunning = false;
+    QMutexLocker locker(&_mutex);
+    return _memoryUsage;
+}
+
+int CanTrace::findMessageByTime(CanTimestamp t)
+{
+    QMutexLocker locker(&_mutex);
+    int idx = lowerBoundByTime(t);
+    return (idx < _dataRowsUsed) ? idx : -1;
+}
+
+int CanTrace::findNextMessage(CanInterfaceId interface, uint32_t raw_id, int idx)
+{
+    QMutexLocker locker(&_mutex);
+    int64_t pos = _idIndex.next(CanTraceIdIndex::makeKey(interface, raw_id), _removedRows + qMax(idx, 0));
+    return (pos < 0) ? -1 : (int)(pos - _removedRows);
+}
+
+int CanTrace::findPreviousMessage(CanInterfaceId interface, uint32_t raw_id, int idx)
+{
+    QMutexLocker locker(&_mutex);
+    if (idx < 0) {
+        return -1;
+    }
+    int64_t pos = _idIndex.previous(CanTraceIdIndex::makeKey(interface, raw_id), _removedRows + idx);
+    return (pos < 0) ? -1 : (int)(pos - _removedRows);
+}
+
+int CanTrace::countMessages(CanInterfaceId interface, uint32_t raw_id, int first_idx, int last_idx)
+{
+    QMutexLocker locker(&_mutex);
+    if (last_idx < 0) {
+        return 0;
     }
+    return _idIndex.count(CanTraceIdIndex::makeKey(interface, raw_id), _removedRows + qMax(first_idx, 0), _removedRows + last_idx);
+}
 
+CanTrace::retention_mode_t CanTrace::retentionMode()
+{
     QMutexLocker locker(&_mutex);
+    return _retentionMode;
+}
+
+uint64_t CanTrace::retentionLimit()
+{
+    QMutexLocker locker(&_mutex);
+    return _retentionLimit;
+}
+
+void CanTrace::setRetention(retention_mode_t mode, uint64_t limit)
+{
+    QMutexLocker locker(&_mutex);
+    _retentionMode = mode;
+    _retentionLimit = limit;
+    if (_retentionLimit == 0) {
+        _retentionMode = retention_unlimited;
+    }
+    applyRetention();
+}
+
+bool CanTrace::saveXML(Backend &backend, QDomDocument &xml, QDomElement &root)
+{
+    (void) backend;
+    (void) xml;
+
+    QMutexLocker locker(&_mutex);
+    switch (_retentionMode) {
+        case retention_frames: root.setAttribute("retention", "frames"); break;
+        case retention_bytes: root.setAttribute("retention", "bytes"); break;
+        case retention_time: root.setAttribute("retention", "time"); break;
+        default: root.setAttribute("retention", "unlimited"); break;
+    }
+    root.setAttribute("retention-limit", QString::number(_retentionLimit));
+    return true;
+}
+
+bool CanTrace::loadXML(Backend &backend, QDomElement &el)
+{
+    (void) backend;
+
+    QString mode = el.attribute("retention", "unlimited");
+    uint64_t limit = el.attribute("retention-limit", "0").toULongLong();
+
+    if (mode == "frames") {
+        setRetention(retention_frames, limit);
+    } else if (mode == "bytes") {
+        setRetention(retention_bytes, limit);
+    } else if (mode == "time") {
+        setRetention(retention_time, limit);
+    } else {
+        setRetention(retention_unlimited, 0);
+    }
+    return true;
+}
+
+uint64_t CanTrace::removedMessages()
+{
+    QMutexLocker locker(&_mutex);
+    return _removedRows;
+}
+
+uint64_t CanTrace::droppedFrames()
+{
+    QMutexLocker locker(&_mutex);
+    uint64_t retval = _droppedFrames;
+    foreach (CanMessageQueue *queue, _queues) {
+        retval += queue->droppedCount();
+    }
+    return retval;
+}
+
+void CanTrace::flushQueue()
+{
+    // reset before draining, so frames queued from now on schedule another flush
+    _isTimerRunning.storeRelease(0);
+
+    QMutexLocker locker(&_mutex);
+    int first_idx = _dataRowsUsed + _newRows;
+    int num_drained = drainQueues();
+    if (num_drained) {
+        emit messagesEnqueued(first_idx, num_drained);
+    }
+
     if (_newRows) {
         emit beforeAppend(_newRows);
 
-        // see if we have muxed messages. cache muxed values, if any.
+        // index the new messages by id and see if we have muxed messages.
+        // cache muxed values, if any.
         MeasurementSetup &setup = _backend.getSetup();
+        CanMessage msg;
         for (int i=_dataRowsUsed; i<_dataRowsUsed + _newRows; i++) {
-            CanMessage &msg = _data[i];
+            const CanTraceFrame &frame = frameAt(i);
+            _idIndex.append(CanTraceIdIndex::makeKey(frame.getInterfaceId(), frame.getRawId()), _removedRows + i);
+
+            frame.toMessage(msg);
             CanDbMessage *dbmsg = setup.findDbMessage(msg);
             if (dbmsg && dbmsg->getMuxer()) {
                 foreach (CanDbSignal *signal, dbmsg->getSignals()) {
@@ -117,90 +285,185 @@ void CanTrace::flushQueue()
         _dataRowsUsed += _newRows;
         _newRows = 0;
         emit afterAppend();
+
+        applyRetention();
     }
 }
 
-void CanTrace::startTimer()
+CanTraceFrame &CanTrace::frameAt(int idx)
 {
-    QMutexLocker locker(&_timerMutex);
-    if (!_isTimerRunning) {
-        _isTimerRunning = true;
-        QMetaObject::invokeMethod(&_flushTimer, "start", Qt::QueuedConnection);
-    }
+    return _chunks[idx / pool_chunk_size]->frame(idx % pool_chunk_size);
 }
 
-void CanTrace::saveCanDump(QFile &file)
+bool CanTrace::isChunkExpired(const CanTraceChunk *chunk, int rows, uint64_t bytes)
 {
-    QMutexLocker locker(&_mutex);
-    QTextStream stream(&file);
-    for (unsigned int i=0; i<size(); i++) {
-        CanMessage *msg = &_data[i];
-        QString line;
-        line.append(QString().asprintf("(%.6f) ", msg->getFloatTimestamp()));
-        line.append(_backend.getInterfaceName(msg->getInterfaceId()));
-        if (msg->isExtended()) {
-            line.append(QString().asprintf(" %08X#", msg->getId()));
-        } else {
-            line.append(QString().asprintf(" %03X#", msg->getId()));
+    switch (_retentionMode) {
+        case retention_frames:
+            return (uint64_t)(rows - pool_chunk_size) >= _retentionLimit;
+        case retention_bytes:
+            return bytes > _retentionLimit;
+        case retention_time:
+        {
+            CanTimestamp t_newest = frameAt(_dataRowsUsed-1).getTimestampNsecs();
+            CanTimestamp t_chunk = chunk->frame(pool_chunk_size-1).getTimestampNsecs();
+            return (uint64_t)(t_newest - t_chunk) > _retentionLimit * timestamp_nsecs_per_msec;
         }
-        for (int i=0; i<msg->getLength(); i++) {
-            line.append(QString().asprintf("%02X", msg->getByte(i)));
-        }
-        stream << line << Qt::endl;
+        default:
+            return false;
     }
 }
 
-void CanTrace::saveVectorAsc(QFile &file)
+void CanTrace::applyRetention()
 {
-    QMutexLocker locker(&_mutex);
-    QTextStream stream(&file);
+    if (_retentionMode == retention_unlimited) {
+        return;
+    }
 
-    if (_data.length()<1) {
+    // Only whole, completely flushed chunks are dropped, and never the last
+    // one, so this costs O(1) per chunk regardless of the trace size.
+    int rows = _dataRowsUsed;
+    uint64_t bytes = _memoryUsage;
+    int num_chunks = 0;
+    while ((num_chunks < _chunks.size()-1) && (rows >= pool_chunk_size)) {
+        const CanTraceChunk *chunk = _chunks[num_chunks].data();
+        if (!isChunkExpired(chunk, rows, bytes)) {
+            break;
+        }
+        rows -= pool_chunk_size;
+        bytes -= chunk->memoryUsage();
+        num_chunks++;
+    }
+
+    if (num_chunks == 0) {
         return;
     }
 
+    emit beforeRemove(num_chunks * pool_chunk_size);
+    _chunks.remove(0, num_chunks);
+    _chunkTimes.remove(0, num_chunks);
+    _dataRowsUsed = rows;
+    _memoryUsage = bytes;
+    _removedRows += num_chunks * pool_chunk_size;
+    _idIndex.discardBefore(_removedRows);
+    emit afterRemove();
+}
+
+void CanTrace::freeChunks()
+{
+    _chunks.clear();
+    _chunkTimes.clear();
+    _memoryUsage = 0;
+}
+
+void CanTrace::startTimer()
+{
+    if (_isTimerRunning.testAndSetOrdered(0, 1)) {
+        QMetaObject::invokeMethod(&_flushTimer, "start", Qt::QueuedConnection);
+    }
+}
 
-    auto firstMessage = _data.first();
-    double t_start = firstMessage.getFloatTimestamp();
+void CanTrace::appendMessage(const CanMessage &msg)
+{
+    int idx = _dataRowsUsed + _newRows;
+    if (idx >= _chunks.size() * pool_chunk_size) {
+        _chunks.append(CanTraceChunkPtr(new CanTraceChunk()));
+        _memoryUsage += _chunks.last()->memoryUsage();
+    }
 
-    QLocale locale_c(QLocale::C);
-    QString dt_start = locale_c.toString(firstMessage.getDateTime(), "ddd MMM dd hh:mm:ss.zzz ap yyyy");
+    CanTraceChunk *chunk = _chunks[idx / pool_chunk_size].data();
+    if (msg.getLength() > CanTraceFrame::inline_payload_size) {
+        size_t usage_before = chunk->memoryUsage();
+        chunk->assign(idx % pool_chunk_size, msg);
+        _memoryUsage += chunk->memoryUsage() - usage_before;
+    } else {
+        chunk->assign(idx % pool_chunk_size, msg);
+    }
 
-    stream << "date " << dt_start << Qt::endl;
-    stream << "base hex  timestamps absolute" << Qt::endl;
-    stream << "internal events logged" << Qt::endl;
-    stream << "// version 8.5.0" << Qt::endl;
-    stream << "Begin Triggerblock " << dt_start << Qt::endl;
-    stream << "   0.000000 Start of measurement" << Qt::endl;
+    if ((idx % pool_chunk_size) == 0) {
+        // sparse time index: running maximum of the chunk start times,
+        // so it stays sorted even if a frame arrives out of order
+        CanTimestamp t = chunk->frame(0).getTimestampNsecs();
+        if (!_chunkTimes.isEmpty() && (_chunkTimes.last() > t)) {
+            t = _chunkTimes.last();
+        }
+        _chunkTimes.append(t);
+    }
 
-    for (unsigned int i=0; i<size(); i++) {
-        CanMessage &msg = _data[i];
+    _newRows++;
+}
 
-        double t_current = msg.getFloatTimestamp();
-        QString id_hex_str = QString().asprintf("%x", msg.getId());
-        QString id_dec_str = QString().asprintf("%d", msg.getId());
-        if (msg.isExtended()) {
-            id_hex_str.append("x");
-            id_dec_str.append("x");
+int CanTrace::lowerBoundByTime(CanTimestamp t)
+{
+    // first chunk starting at or after t
+    int c = std::lower_bound(_chunkTimes.constBegin(), _chunkTimes.constEnd(), t) - _chunkTimes.constBegin();
+
+    // the bound lies within the chunk before that one
+    int hi = qMin(c * pool_chunk_size, _dataRowsUsed);
+    int lo = qMin(qMax(c-1, 0) * pool_chunk_size, hi);
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        CanTimestamp t_mid = frameAt(mid).getTimestampNsecs();
+        if (t_mid < t) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
         }
+    }
+    return lo;
+}
 
-        // TODO how to handle RTR flag?
-        QString line = QString().asprintf(
-            "%11.6lf 1  %-15s %s   d %d %s  Length = %d BitCount = %d ID = %s",
-            t_current-t_start,
-            id_hex_str.toStdString().c_str(),
-            "Rx", // TODO handle Rx/Tx
-            msg.getLength(),
-            msg.getDataHexString().toStdString().c_str(),
-            0, // TODO Length (transfer time in ns)
-            0, // TODO BitCount (overall frame length, including stuff bits)
-            id_dec_str.toStdString().c_str()
-        );
+static bool isEarlier(const CanMessage &a, const CanMessage &b)
+{
+    return a.getTimestampNsecs() < b.getTimestampNsecs();
+}
 
-        stream << line << Qt::endl;
+int CanTrace::drainQueues()
+{
+    // Only take what is in the queues right now; frames pushed while we are
+    // draining are picked up by the next flush. Frames from different queues
+    // are merged by timestamp so the trace stays in chronological order.
+    int numQueues = _queues.size();
+    QVarLengthArray<int, 16> avail(numQueues);
+    QVarLengthArray<int, 16> pos(numQueues);
+    for (int q=0; q<numQueues; q++) {
+        avail[q] = _queues[q]->available();
+        pos[q] = 0;
     }
 
-    stream << "End TriggerBlock" << Qt::endl;
+    for (;;) {
+        int best = -1;
+        for (int q=0; q<numQueues; q++) {
+            if (pos[q] < avail[q]) {
+                if ((best < 0) || isEarlier(_queues[q]->at(pos[q]), _queues[best]->at(pos[best]))) {
+                    best = q;
+                }
+            }
+        }
+        if (best < 0) {
+            break;
+        }
+        appendMessage(_queues[best]->at(pos[best]++));
+    }
+
+    int retval = 0;
+    for (int q=0; q<numQueues; q++) {
+        _queues[q]->release(avail[q]);
+        retval += avail[q];
+    }
+    return retval;
+}
+
+CanTraceSnapshot CanTrace::snapshot()
+{
+    QMutexLocker locker(&_mutex);
+    return CanTraceSnapshot(_chunks, _dataRowsUsed);
+}
+
+void CanTrace::onSetupChanged()
+{
+    // the databases the cached signals belonged to may be gone
+    QMutexLocker locker(&_mutex);
+    _muxCache.clear();
 }
 
 bool CanTrace::getMuxedSignalFromCache(const CanDbSignal *signal, uint64_t *raw_value)
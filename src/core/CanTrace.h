@@ -23,14 +23,21 @@
 
 #include <QObject>
 #include <QMutex>
+#include <QAtomicInt>
 #include <QTimer>
 #include <QVector>
 #include <QMap>
 #include <QFile>
+#include <QDomDocument>
 
 #include "CanMessage.h"
+#include "CanTraceFrame.h"
+#include "CanTraceChunk.h"
+#include "CanTraceIdIndex.h"
+#include "CanTraceSnapshot.h"
 
 class CanInterface;
+class CanMessageQueue;
 class CanDbMessage;
 class CanDbSignal;
 class MeasurementSetup;
@@ -40,48 +47,109 @@ class CanTrace : public QObject
 {
     Q_OBJECT
 
+public:
+    typedef enum {
+        retention_unlimited,
+        retention_frames,
+        retention_bytes,
+        retention_time
+    } retention_mode_t;
+
 public:
     explicit CanTrace(Backend &backend, QObject *parent, int flushInterval);
+    virtual ~CanTrace();
 
     unsigned long size();
     void clear();
-    const CanMessage *getMessage(int idx);
+    const CanTraceFrame *getMessage(int idx);
     void enqueueMessage(const CanMessage &msg, bool more_to_follow=false);
+    void enqueueMessages(const CanMessage *msgs, int count, bool more_to_follow=false);
+    void enqueueMessages(const QList<CanMessage> &msgs, bool more_to_follow=false);
+
+    void attachQueue(CanMessageQueue *queue);
+    void detachQueue(CanMessageQueue *queue);
+    void notifyQueued();
+    uint64_t droppedFrames();
+
+    // number of frames dropped from the front by the retention policy,
+    // position + removedMessages() identifies a frame for the trace lifetime
+    uint64_t removedMessages();
+    uint64_t memoryUsage();
+
+    // first frame at or after t, searched in O(log n)
+    int findMessageByTime(CanTimestamp t);
+
+    int findNextMessage(CanInterfaceId interface, uint32_t raw_id, int idx);
+    int findPreviousMessage(CanInterfaceId interface, uint32_t raw_id, int idx);
+    int countMessages(CanInterfaceId interface, uint32_t raw_id, int first_idx, int last_idx);
 
-    void saveCanDump(QFile &file);
-    void saveVectorAsc(QFile &file);
+    retention_mode_t retentionMode();
+    uint64_t retentionLimit();
+    void setRetention(retention_mode_t mode, uint64_t limit);
+
+    bool saveXML(Backend &backend, QDomDocument &xml, QDomElement &root);
+    bool loadXML(Backend &backend, QDomElement &el);
+
+    CanTraceSnapshot snapshot();
 
     bool getMuxedSignalFromCache(const CanDbSignal *signal, uint64_t *raw_value);
 
 signals:
-    void messageEnqueued(int idx);
+    void messagesEnqueued(int first_idx, int num_messages);
     void beforeAppend(int num_messages);
     void afterAppend();
+    void beforeRemove(int num_messages);
+    void afterRemove();
     void beforeClear();
     void afterClear();
 
 private slots:
     void flushQueue();
+    void onSetupChanged();
 
 private:
     enum {
-        pool_chunk_size = 1024
+        pool_chunk_size = CanTraceChunk::num_frames
     };
 
     Backend &_backend;
 
-    QVector<CanMessage> _data;
+    // Frames are stored in fixed-size chunks which are never reallocated,
+    // so appending is O(1) and pointers returned by getMessage() stay valid
+    // until the chunk is dropped by the retention policy or the trace is
+    // cleared. Chunks are shared with snapshots, which keep them alive.
+    QVector<CanTraceChunkPtr> _chunks;
+    QVector<CanTimestamp> _chunkTimes;
+    uint64_t _memoryUsage;
+    uint64_t _removedRows;
     int _dataRowsUsed;
     int _newRows;
-    bool _isTimerRunning;
+    QAtomicInt _isTimerRunning;
+
+    // per-listener ingest queues, drained by flushQueue()
+    QList<CanMessageQueue*> _queues;
+    uint64_t _droppedFrames;
 
+    retention_mode_t _retentionMode;
+    uint64_t _retentionLimit;
+
+    // positions of each (interface, raw id), built while flushing
+    CanTraceIdIndex _idIndex;
+
+    // last value of each muxed signal, keyed by signals of the current
+    // setup's databases; cleared whenever the setup changes
     QMap<const CanDbSignal*,uint64_t> _muxCache;
 
     QRecursiveMutex _mutex;
-    QMutex _timerMutex;
     QTimer _flushTimer;
 
     void startTimer();
-
+    void appendMessage(const CanMessage &msg);
+    int drainQueues();
+    CanTraceFrame &frameAt(int idx);
+    int lowerBoundByTime(CanTimestamp t);
+    bool isChunkExpired(const CanTraceChunk *chunk, int rows, uint64_t bytes);
+    void applyRetention();
+    void freeChunks();
 
 };
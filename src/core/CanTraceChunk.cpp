@@ -0,0 +1,76 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "CanTraceChunk.h"
+#include <core/CanMessage.h>
+
+CanTraceChunk::CanTraceChunk()
+  : _payloadBlockUsed(0)
+{
+}
+
+CanTraceChunk::~CanTraceChunk()
+{
+    foreach (uint8_t *block, _payloadBlocks) {
+        delete[] block;
+    }
+}
+
+CanTraceFrame &CanTraceChunk::frame(int i)
+{
+    return _frames[i];
+}
+
+const CanTraceFrame &CanTraceChunk::frame(int i) const
+{
+    return _frames[i];
+}
+
+void CanTraceChunk::assign(int i, const CanMessage &msg)
+{
+    const uint8_t *payload = 0;
+    if (msg.getLength() > CanTraceFrame::inline_payload_size) {
+        payload = storePayload(msg);
+    }
+    _frames[i].assign(msg, payload);
+}
+
+size_t CanTraceChunk::memoryUsage() const
+{
+    return sizeof(CanTraceChunk) + (size_t)_payloadBlocks.size() * payload_block_size;
+}
+
+const uint8_t *CanTraceChunk::storePayload(const CanMessage &msg)
+{
+    int len = msg.getLength();
+    if (_payloadBlocks.isEmpty() || (_payloadBlockUsed + len > payload_block_size)) {
+        _payloadBlocks.append(new uint8_t[payload_block_size]);
+        _payloadBlockUsed = 0;
+    }
+
+    uint8_t *payload = _payloadBlocks.last() + _payloadBlockUsed;
+    for (int i=0; i<len; i++) {
+        payload[i] = msg.getByte(i);
+    }
+    _payloadBlockUsed += len;
+    return payload;
+}
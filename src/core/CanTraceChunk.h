@@ -0,0 +1,66 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <QVector>
+#include <QSharedPointer>
+#include "CanTraceFrame.h"
+
+class CanMessage;
+
+// Fixed-size block of trace frames. Chunks are allocated once and never
+// moved, so frame pointers stay valid for as long as the chunk is alive.
+// Each chunk owns the arena holding the payloads of its CAN FD frames,
+// which allows CanTrace to drop the oldest chunk as a whole in O(1).
+class CanTraceChunk
+{
+public:
+    enum {
+        num_frames = 1024,
+        payload_block_size = 8192
+    };
+
+    CanTraceChunk();
+    ~CanTraceChunk();
+
+    CanTraceFrame &frame(int i);
+    const CanTraceFrame &frame(int i) const;
+
+    void assign(int i, const CanMessage &msg);
+
+    size_t memoryUsage() const;
+
+private:
+    CanTraceFrame _frames[num_frames];
+    QVector<uint8_t*> _payloadBlocks;
+    int _payloadBlockUsed;
+
+    const uint8_t *storePayload(const CanMessage &msg);
+
+    CanTraceChunk(const CanTraceChunk&) = delete;
+    CanTraceChunk &operator=(const CanTraceChunk&) = delete;
+};
+
+typedef QSharedPointer<CanTraceChunk> CanTraceChunkPtr;
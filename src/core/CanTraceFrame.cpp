@@ -0,0 +1,150 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "CanTraceFrame.h"
+#include <core/CanMessage.h>
+
+enum {
+    id_flag_extended = 0x80000000,
+    id_flag_rtr      = 0x40000000,
+    id_flag_error    = 0x20000000,
+    id_mask_extended = 0x1FFFFFFF,
+    id_mask_standard = 0x7FF
+};
+
+void CanTraceFrame::assign(const CanMessage &msg, const uint8_t *payload)
+{
+    _timestamp = msg.getTimestampNsecs();
+    _raw_id = msg.getRawId();
+    _interface = msg.getInterfaceId();
+    _length = msg.getLength();
+
+    _flags = 0;
+    if (msg.isFD()) { _flags |= flag_fd; }
+    if (msg.isBRS()) { _flags |= flag_brs; }
+    if (msg.isRX()) { _flags |= flag_rx; }
+    if (msg.isShow()) { _flags |= flag_show; }
+
+    if (_length > inline_payload_size) {
+        _payload = payload;
+    } else {
+        for (int i=0; i<inline_payload_size; i++) {
+            _inline[i] = (i<_length) ? msg.getByte(i) : 0;
+        }
+    }
+}
+
+void CanTraceFrame::toMessage(CanMessage &msg) const
+{
+    msg.setRawId(_raw_id);
+    msg.setInterfaceId(_interface);
+    msg.setLength(_length);
+    msg.setFD(isFD());
+    msg.setBRS(isBRS());
+    msg.setRX(isRX());
+    msg.setShow(isShow());
+
+    const uint8_t *data = getData();
+    for (int i=0; i<_length; i++) {
+        msg.setByte(i, data[i]);
+    }
+    // signal extraction always reads the first 8 bytes
+    for (int i=_length; i<inline_payload_size; i++) {
+        msg.setByte(i, 0);
+    }
+
+    msg.setTimestampNsecs(_timestamp);
+}
+
+uint32_t CanTraceFrame::getRawId() const
+{
+    return _raw_id;
+}
+
+uint32_t CanTraceFrame::getId() const
+{
+    if (isExtended()) {
+        return _raw_id & id_mask_extended;
+    } else {
+        return _raw_id & id_mask_standard;
+    }
+}
+
+bool CanTraceFrame::isExtended() const
+{
+    return (_raw_id & id_flag_extended) != 0;
+}
+
+bool CanTraceFrame::isRTR() const
+{
+    return (_raw_id & id_flag_rtr) != 0;
+}
+
+bool CanTraceFrame::isErrorFrame() const
+{
+    return (_raw_id & id_flag_error) != 0;
+}
+
+bool CanTraceFrame::isFD() const
+{
+    return (_flags & flag_fd) != 0;
+}
+
+bool CanTraceFrame::isBRS() const
+{
+    return (_flags & flag_brs) != 0;
+}
+
+bool CanTraceFrame::isRX() const
+{
+    return (_flags & flag_rx) != 0;
+}
+
+bool CanTraceFrame::isShow() const
+{
+    return (_flags & flag_show) != 0;
+}
+
+CanInterfaceId CanTraceFrame::getInterfaceId() const
+{
+    return _interface;
+}
+
+uint8_t CanTraceFrame::getLength() const
+{
+    return _length;
+}
+
+uint8_t CanTraceFrame::getByte(const uint8_t index) const
+{
+    return (index < _length) ? getData()[index] : 0;
+}
+
+const uint8_t *CanTraceFrame::getData() const
+{
+    return (_length > inline_payload_size) ? _payload : _inline;
+}
+
+CanTimestamp CanTraceFrame::getTimestampNsecs() const
+{
+    return _timestamp;
+}
@@ -0,0 +1,83 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#pragma once
+
+#include <stdint.h>
+#include <driver/CanDriver.h>
+#include <core/CanTimestamp.h>
+
+class CanMessage;
+
+// Compact representation of a frame stored in CanTrace.
+//
+// Flags are packed into a single byte and the timestamp is kept as an
+// integer. Payloads of up to 8 bytes (classic CAN) are stored inline, larger
+// CAN FD payloads live in a side arena owned by the trace and are referenced
+// by pointer. A frame is 24 bytes, compared to ~96 bytes for a CanMessage.
+class CanTraceFrame
+{
+public:
+    enum {
+        inline_payload_size = 8
+    };
+
+    void assign(const CanMessage &msg, const uint8_t *payload);
+    void toMessage(CanMessage &msg) const;
+
+    uint32_t getRawId() const;
+    uint32_t getId() const;
+    bool isExtended() const;
+    bool isRTR() const;
+    bool isErrorFrame() const;
+    bool isFD() const;
+    bool isBRS() const;
+    bool isRX() const;
+    bool isShow() const;
+
+    CanInterfaceId getInterfaceId() const;
+    uint8_t getLength() const;
+    uint8_t getByte(const uint8_t index) const;
+    const uint8_t *getData() const;
+
+    CanTimestamp getTimestampNsecs() const;
+
+private:
+    enum {
+        flag_fd   = 0x01,
+        flag_brs  = 0x02,
+        flag_rx   = 0x04,
+        flag_show = 0x08
+    };
+
+    CanTimestamp _timestamp;
+    uint32_t _raw_id;
+    CanInterfaceId _interface;
+    uint8_t _length;
+    uint8_t _flags;
+    union {
+        uint8_t _inline[inline_payload_size];
+        const uint8_t *_payload;
+    };
+};
+
+static_assert(sizeof(CanTraceFrame) == 24, "CanTraceFrame must stay compact");
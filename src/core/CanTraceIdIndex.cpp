@@ -0,0 +1,104 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "CanTraceIdIndex.h"
+#include <algorithm>
+
+CanTraceIdIndex::key_t CanTraceIdIndex::makeKey(CanInterfaceId interface, uint32_t raw_id)
+{
+    return ((uint64_t)interface << 32) | raw_id;
+}
+
+void CanTraceIdIndex::clear()
+{
+    _entries.clear();
+}
+
+void CanTraceIdIndex::append(key_t key, uint64_t pos)
+{
+    _entries[key].positions.append(pos);
+}
+
+void CanTraceIdIndex::discardBefore(uint64_t pos)
+{
+    QHash<key_t, Entry>::iterator it = _entries.begin();
+    while (it != _entries.end()) {
+        Entry &entry = it.value();
+        entry.start = lowerBound(entry, pos) - entry.positions.constData();
+
+        if (entry.start == entry.positions.size()) {
+            it = _entries.erase(it);
+            continue;
+        }
+
+        // reclaim memory once most of the list has expired
+        if (entry.start > entry.positions.size() / 2) {
+            entry.positions.remove(0, entry.start);
+            entry.start = 0;
+        }
+        ++it;
+    }
+}
+
+int64_t CanTraceIdIndex::next(key_t key, uint64_t pos) const
+{
+    QHash<key_t, Entry>::const_iterator it = _entries.constFind(key);
+    if (it == _entries.constEnd()) {
+        return -1;
+    }
+
+    const Entry &entry = it.value();
+    const uint64_t *p = lowerBound(entry, pos);
+    return (p != entry.positions.constData() + entry.positions.size()) ? (int64_t)*p : -1;
+}
+
+int64_t CanTraceIdIndex::previous(key_t key, uint64_t pos) const
+{
+    QHash<key_t, Entry>::const_iterator it = _entries.constFind(key);
+    if (it == _entries.constEnd()) {
+        return -1;
+    }
+
+    const Entry &entry = it.value();
+    const uint64_t *p = upperBound(entry, pos);
+    return (p != entry.positions.constData() + entry.start) ? (int64_t)*(p-1) : -1;
+}
+
+uint64_t CanTraceIdIndex::count(key_t key, uint64_t first, uint64_t last) const
+{
+    QHash<key_t, Entry>::const_iterator it = _entries.constFind(key);
+    if ((it == _entries.constEnd()) || (last < first)) {
+        return 0;
+    }
+
+    return upperBound(it.value(), last) - lowerBound(it.value(), first);
+}
+
+const uint64_t *CanTraceIdIndex::lowerBound(const Entry &entry, uint64_t pos) const
+{
+    return std::lower_bound(entry.positions.constData() + entry.start, entry.positions.constData() + entry.positions.size(), pos);
+}
+
+const uint64_t *CanTraceIdIndex::upperBound(const Entry &entry, uint64_t pos) const
+{
+    return std::upper_bound(entry.positions.constData() + entry.start, entry.positions.constData() + entry.positions.size(), pos);
+}
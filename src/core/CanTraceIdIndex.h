@@ -0,0 +1,61 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#pragma once
+
+#include <stdint.h>
+#include <QHash>
+#include <QVector>
+#include <driver/CanDriver.h>
+
+// Incremental index mapping each (interface, raw id) pair to the sorted list
+// of absolute trace positions it occurs at. Absolute positions keep counting
+// across frames dropped by the retention policy, so entries never have to be
+// renumbered; discardBefore() just forgets positions that left the trace.
+class CanTraceIdIndex
+{
+public:
+    typedef uint64_t key_t;
+
+    static key_t makeKey(CanInterfaceId interface, uint32_t raw_id);
+
+    void clear();
+    void append(key_t key, uint64_t pos);
+    void discardBefore(uint64_t pos);
+
+    // all lookups are O(log n) in the number of occurrences of the key
+    int64_t next(key_t key, uint64_t pos) const;
+    int64_t previous(key_t key, uint64_t pos) const;
+    uint64_t count(key_t key, uint64_t first, uint64_t last) const;
+
+private:
+    struct Entry {
+        Entry() : start(0) {}
+        QVector<uint64_t> positions;
+        int start; // positions before this one have been discarded
+    };
+
+    QHash<key_t, Entry> _entries;
+
+    const uint64_t *lowerBound(const Entry &entry, uint64_t pos) const;
+    const uint64_t *upperBound(const Entry &entry, uint64_t pos) const;
+};
@@ -0,0 +1,49 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "CanTraceSnapshot.h"
+
+CanTraceSnapshot::CanTraceSnapshot()
+  : _size(0)
+{
+}
+
+CanTraceSnapshot::CanTraceSnapshot(const QVector<CanTraceChunkPtr> &chunks, int size)
+  : _chunks(chunks),
+    _size(size)
+{
+}
+
+int CanTraceSnapshot::size() const
+{
+    return _size;
+}
+
+bool CanTraceSnapshot::isEmpty() const
+{
+    return _size == 0;
+}
+
+const CanTraceFrame &CanTraceSnapshot::frame(int idx) const
+{
+    return _chunks[idx / CanTraceChunk::num_frames]->frame(idx % CanTraceChunk::num_frames);
+}
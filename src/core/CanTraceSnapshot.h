@@ -0,0 +1,49 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#pragma once
+
+#include <QVector>
+#include "CanTraceChunk.h"
+#include "CanTraceFrame.h"
+
+// Read-only view of the frames a CanTrace held at the time the snapshot was
+// taken. The snapshot shares the trace's chunks, so taking it is cheap and
+// does not copy frames; chunks dropped from the trace (retention, clear)
+// stay alive until the last snapshot referencing them is gone.
+//
+// Frames in a snapshot are never written again, so it can be read from any
+// thread without holding the trace mutex.
+class CanTraceSnapshot
+{
+public:
+    CanTraceSnapshot();
+    CanTraceSnapshot(const QVector<CanTraceChunkPtr> &chunks, int size);
+
+    int size() const;
+    bool isEmpty() const;
+    const CanTraceFrame &frame(int idx) const;
+
+private:
+    QVector<CanTraceChunkPtr> _chunks;
+    int _size;
+};
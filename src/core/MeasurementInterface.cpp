@@ -72,6 +72,12 @@ bool MeasurementInterface::loadXML(Backend &backend, QDomElement &el)
 
     _CustomBitrate = el.attribute("custom-bitrate", "0").toInt();
     _CustomFdBitrate = el.attribute("custom-fdbitrate", "0").toInt();
+
+    QString filter = el.attribute("capture-filter");
+    if (!_captureFilter.parse(filter)) {
+        log_warning(QString("ignoring invalid capture filter \"%1\"").arg(filter));
+        _captureFilter = CanCaptureFilter();
+    }
     return true;
 }
 
@@ -102,6 +108,10 @@ bool MeasurementInterface::saveXML(Backend &backend, QDomDocument &xml, QDomElem
 
     root.setAttribute("custom-bitrate", _CustomBitrate);
     root.setAttribute("custom-fdbitrate", _CustomFdBitrate);
+
+    if (!_captureFilter.isEmpty()) {
+        root.setAttribute("capture-filter", _captureFilter.toString());
+    }
     return true;
 }
 
@@ -269,3 +279,13 @@ void MeasurementInterface::setCustomFdBitrate(uint32_t customFdBitrate)
 {
     _CustomFdBitrate = customFdBitrate;
 }
+
+const CanCaptureFilter &MeasurementInterface::captureFilter() const
+{
+    return _captureFilter;
+}
+
+void MeasurementInterface::setCaptureFilter(const CanCaptureFilter &captureFilter)
+{
+    _captureFilter = captureFilter;
+}
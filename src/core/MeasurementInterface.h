@@ -24,6 +24,7 @@
 #include <QDomDocument>
 #include <driver/CanDriver.h>
 #include <driver/CanInterface.h>
+#include <core/CanCaptureFilter.h>
 
 class Backend;
 
@@ -83,6 +84,9 @@ public:
 
     uint32_t customFdBitrate() const;
     void setCustomFdBitrate(uint32_t customFdBitrate);
+
+    const CanCaptureFilter &captureFilter() const;
+    void setCaptureFilter(const CanCaptureFilter &captureFilter);
 private:
     CanInterfaceId _canif;
 
@@ -106,4 +110,6 @@ private:
 
     uint32_t _CustomBitrate;
     uint32_t _CustomFdBitrate;
+
+    CanCaptureFilter _captureFilter;
 };
@@ -1,7 +1,13 @@
 SOURCES += \
     $$PWD/Backend.cpp \
     $$PWD/CanMessage.cpp \
+    $$PWD/CanTimestamp.cpp \
+    $$PWD/CanMessageQueue.cpp \
     $$PWD/CanTrace.cpp \
+    $$PWD/CanTraceFrame.cpp \
+    $$PWD/CanTraceChunk.cpp \
+    $$PWD/CanTraceIdIndex.cpp \
+    $$PWD/CanTraceSnapshot.cpp \
     $$PWD/CanDbMessage.cpp \
     $$PWD/CanDb.cpp \
     $$PWD/CanDbNode.cpp \
@@ -9,6 +15,7 @@ SOURCES += \
     $$PWD/MeasurementSetup.cpp \
     $$PWD/MeasurementNetwork.cpp \
     $$PWD/MeasurementInterface.cpp \
+    $$PWD/CanCaptureFilter.cpp \
     $$PWD/LogModel.cpp \
     $$PWD/ConfigurableWidget.cpp \
     $$PWD/Log.cpp
@@ -17,7 +24,13 @@ HEADERS += \
     $$PWD/portable_endian.h \
     $$PWD/Backend.h \
     $$PWD/CanMessage.h \
+    $$PWD/CanTimestamp.h \
+    $$PWD/CanMessageQueue.h \
     $$PWD/CanTrace.h \
+    $$PWD/CanTraceFrame.h \
+    $$PWD/CanTraceChunk.h \
+    $$PWD/CanTraceIdIndex.h \
+    $$PWD/CanTraceSnapshot.h \
     $$PWD/CanDbMessage.h \
     $$PWD/CanDb.h \
     $$PWD/CanDbNode.h \
@@ -25,6 +38,7 @@ HEADERS += \
     $$PWD/MeasurementSetup.h \
     $$PWD/MeasurementNetwork.h \
     $$PWD/MeasurementInterface.h \
+    $$PWD/CanCaptureFilter.h \
     $$PWD/LogModel.h \
     $$PWD/ConfigurableWidget.h \
     $$PWD/Log.h
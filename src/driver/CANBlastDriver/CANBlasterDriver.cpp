@@ -41,9 +41,8 @@
 
 CANBlasterDriver::CANBlasterDriver(Backend &backend)
   : CanDriver(backend),
-    setupPage(new GenericCanSetupPage())
+    setupPage(GenericCanSetupPage::create(backend))
 {
-    QObject::connect(&backend, SIGNAL(onSetupDialogCreated(SetupDialog&)), setupPage, SLOT(onSetupDialogCreated(SetupDialog&)));
 }
 
 CANBlasterDriver::~CANBlasterDriver() {
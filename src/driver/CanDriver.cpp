@@ -105,3 +105,18 @@ CanInterface *CanDriver::getInterfaceByName(QString ifName)
     }
     return 0;
 }
+
+bool CanDriver::saveXML(Backend &backend, QDomDocument &xml, QDomElement &root)
+{
+    (void) backend;
+    (void) xml;
+    (void) root;
+    return true;
+}
+
+bool CanDriver::loadXML(Backend &backend, QDomElement &el)
+{
+    (void) backend;
+    (void) el;
+    return true;
+}
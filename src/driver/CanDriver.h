@@ -27,6 +27,8 @@
 
 class Backend;
 class CanInterface;
+class QDomDocument;
+class QDomElement;
 
 typedef uint16_t CanInterfaceId;
 typedef QList<uint16_t> CanInterfaceIdList;
@@ -52,7 +54,11 @@ public:
     void deleteInterface(CanInterface *intf);
     void deleteAllInterfaces();
 
-    CanInterface *getInterfaceByName(QString ifName);
+    virtual CanInterface *getInterfaceByName(QString ifName);
+
+    // drivers with interfaces that only exist in the workspace keep them here
+    virtual bool saveXML(Backend &backend, QDomDocument &xml, QDomElement &root);
+    virtual bool loadXML(Backend &backend, QDomElement &el);
 
 private:
     Backend &_backend;
@@ -72,6 +72,11 @@ bool CanInterface::isOpen()
     return false;
 }
 
+bool CanInterface::isLive()
+{
+    return true;
+}
+
 bool CanInterface::updateStatistics()
 {
     return false;
@@ -74,6 +74,10 @@ public:
 
     virtual bool isOpen();
 
+    // false for sources that can be held back, like capture files; their
+    // listener waits for room in the queue instead of dropping frames
+    virtual bool isLive();
+
     virtual void sendMessage(const CanMessage &msg) = 0;
     virtual bool readMessage(QList<CanMessage> &msglist, unsigned int timeout_ms) = 0;
 
@@ -38,10 +38,12 @@ CanListener::CanListener(QObject *parent, Backend &backend, CanInterface &intf)
     _openComplete(false)
 {
     _thread = new QThread();
+    _backend.getTrace()->attachQueue(&_queue);
 }
 
 CanListener::~CanListener()
 {
+    _backend.getTrace()->detachQueue(&_queue);
     delete _thread;
 }
 
@@ -67,12 +69,18 @@ void CanListener::run()
     qRegisterMetaType<log_level_t >("log_level_t");
     log_info(QString(tr("interface: %1, Version: %2")).arg(_intf.getName(),_intf.getVersion()));
 
+    bool live = _intf.isLive();
+
     _openComplete = true;
     while (_shouldBeRunning) {
         if (_intf.readMessage(rxMessages, 500)) {
-            for(const CanMessage &msg: qAsConst(rxMessages))
-            {
-                trace->enqueueMessage(msg, false);
+            if (live) {
+                // never block here: frames go to our own lock-free queue,
+                // which the trace drains from its flush timer
+                _queue.push(rxMessages.constData(), rxMessages.size());
+                trace->notifyQueued();
+            } else {
+                pushWaiting(rxMessages);
             }
             rxMessages.clear();
         }
@@ -92,6 +100,23 @@ void CanListener::run()
     _thread->quit();
 }
 
+void CanListener::pushWaiting(const QList<CanMessage> &msgs)
+{
+    // sources that are not live wait for room instead of dropping
+    CanTrace *trace = _backend.getTrace();
+    int done = 0;
+    while ((done < msgs.size()) && _shouldBeRunning) {
+        int space = _queue.capacity() - _queue.available();
+        if (space == 0) {
+            trace->notifyQueued();
+            QThread::msleep(1);
+            continue;
+        }
+        done += _queue.push(msgs.constData() + done, qMin(space, msgs.size() - done));
+        trace->notifyQueued();
+    }
+}
+
 void CanListener::startThread()
 {
     moveToThread(_thread);
@@ -25,6 +25,7 @@
 #include <QObject>
 #include <driver/CanDriver.h>
 #include <driver/CanInterface.h>
+#include <core/CanMessageQueue.h>
 
 //class QThread;
 class CanMessage;
@@ -57,4 +58,7 @@ private:
     bool _shouldBeRunning;
     bool _openComplete;
     QThread *_thread;
+    CanMessageQueue _queue;
+
+    void pushWaiting(const QList<CanMessage> &msgs);
 };
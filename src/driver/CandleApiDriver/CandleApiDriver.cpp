@@ -27,9 +27,8 @@
 
 CandleApiDriver::CandleApiDriver(Backend &backend)
   : CanDriver(backend),
-    setupPage(new GenericCanSetupPage(0))
+    setupPage(GenericCanSetupPage::create(backend))
 {
-    QObject::connect(&backend, SIGNAL(onSetupDialogCreated(SetupDialog&)), setupPage, SLOT(onSetupDialogCreated(SetupDialog&)));
 }
 
 QString CandleApiDriver::getName()
@@ -0,0 +1,105 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "FileCanDriver.h"
+#include "FileCanInterface.h"
+#include <core/Backend.h>
+#include <driver/GenericCanSetupPage.h>
+#include <tracefile/TraceStreamReader.h>
+
+#include <QFileInfo>
+
+FileCanDriver::FileCanDriver(Backend &backend)
+  : CanDriver(backend),
+    setupPage(GenericCanSetupPage::create(backend))
+{
+}
+
+FileCanDriver::~FileCanDriver()
+{
+}
+
+QString FileCanDriver::getName()
+{
+    return "File";
+}
+
+bool FileCanDriver::update()
+{
+    // interfaces are only created by addFile(), keep them
+    return true;
+}
+
+CanInterface *FileCanDriver::getInterfaceByName(QString ifName)
+{
+    CanInterface *intf = CanDriver::getInterfaceByName(ifName);
+    if (!intf && QFileInfo(ifName).isFile()) {
+        intf = addFile(ifName);
+    }
+    return intf;
+}
+
+FileCanInterface *FileCanDriver::addFile(const QString &filename)
+{
+    if (!TraceStreamReader::canStream(filename)) {
+        log_error(QString("Cannot use %1 as interface, only cangaroo, BLF and pcap traces are supported").arg(filename));
+        return 0;
+    }
+
+    QString path = QFileInfo(filename).absoluteFilePath();
+    foreach (CanInterface *intf, getInterfaces()) {
+        if (intf->getName() == path) {
+            return dynamic_cast<FileCanInterface*>(intf);
+        }
+    }
+
+    FileCanInterface *intf = new FileCanInterface(this, path);
+    addInterface(intf);
+    return intf;
+}
+
+bool FileCanDriver::saveXML(Backend &backend, QDomDocument &xml, QDomElement &root)
+{
+    (void) backend;
+    foreach (CanInterface *intf, getInterfaces()) {
+        FileCanInterface *file = dynamic_cast<FileCanInterface*>(intf);
+        QDomElement el = xml.createElement("interface");
+        el.setAttribute("name", file->getName());
+        el.setAttribute("realtime", file->isRealTime() ? 1 : 0);
+        root.appendChild(el);
+    }
+    return true;
+}
+
+bool FileCanDriver::loadXML(Backend &backend, QDomElement &el)
+{
+    (void) backend;
+    QDomNodeList list = el.elementsByTagName("interface");
+    for (int i=0; i<list.length(); i++) {
+        QDomElement elIntf = list.item(i).toElement();
+        FileCanInterface *file = dynamic_cast<FileCanInterface*>(getInterfaceByName(elIntf.attribute("name")));
+        if (file) {
+            file->setRealTime(elIntf.attribute("realtime", "1").toInt() != 0);
+        }
+    }
+    return true;
+}
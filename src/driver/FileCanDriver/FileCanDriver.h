@@ -0,0 +1,55 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#pragma once
+
+#include <QString>
+#include <QDomDocument>
+#include <core/Backend.h>
+#include <driver/CanDriver.h>
+
+class FileCanInterface;
+class GenericCanSetupPage;
+
+// Virtual interfaces that serve the frames of a capture file, so the whole
+// receive path can be run without hardware. There is nothing to discover,
+// an interface exists for each file added; interfaces are named by the
+// absolute file path, so workspaces referencing them re-open the file and
+// keep whether it is played in real time.
+class FileCanDriver: public CanDriver {
+public:
+    FileCanDriver(Backend &backend);
+    virtual ~FileCanDriver();
+
+    virtual QString getName();
+    virtual bool update();
+
+    virtual CanInterface *getInterfaceByName(QString ifName);
+
+    FileCanInterface *addFile(const QString &filename);
+
+    virtual bool saveXML(Backend &backend, QDomDocument &xml, QDomElement &root);
+    virtual bool loadXML(Backend &backend, QDomElement &el);
+
+private:
+    GenericCanSetupPage *setupPage;
+};
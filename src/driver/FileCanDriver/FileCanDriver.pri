@@ -0,0 +1,9 @@
+SOURCES += \
+    $$PWD/FileCanInterface.cpp \
+    $$PWD/FileCanDriver.cpp
+
+HEADERS  += \
+    $$PWD/FileCanInterface.h \
+    $$PWD/FileCanDriver.h
+
+FORMS +=
@@ -0,0 +1,251 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "FileCanInterface.h"
+#include "FileCanDriver.h"
+
+#include <core/Backend.h>
+#include <tracefile/TraceStreamReader.h>
+
+#include <QFileInfo>
+#include <QThread>
+
+FileCanInterface::FileCanInterface(FileCanDriver *driver, QString filename)
+  : CanInterface((CanDriver *)driver),
+    _filename(filename),
+    _realTime(true),
+    _isOpen(false),
+    _atEnd(false),
+    _reader(0),
+    _pendingPos(0),
+    _started(false),
+    _first_ns(0),
+    _offset_ns(0),
+    _rx_count(0),
+    _tx_dropped(0)
+{
+}
+
+FileCanInterface::~FileCanInterface()
+{
+    close();
+}
+
+QString FileCanInterface::getName() const
+{
+    return _filename;
+}
+
+QString FileCanInterface::getDetailsStr() const
+{
+    return QString("%1, %2").arg(QFileInfo(_filename).fileName(), _realTime ? tr("real time") : tr("maximum speed"));
+}
+
+void FileCanInterface::applyConfig(const MeasurementInterface &mi)
+{
+    _settings = mi;
+}
+
+unsigned FileCanInterface::getBitrate()
+{
+    return _settings.bitrate();
+}
+
+uint32_t FileCanInterface::getCapabilities()
+{
+    return 0;
+}
+
+bool FileCanInterface::isRealTime() const
+{
+    return _realTime;
+}
+
+void FileCanInterface::setRealTime(bool realTime)
+{
+    _realTime = realTime;
+}
+
+bool FileCanInterface::atEnd() const
+{
+    return _atEnd;
+}
+
+void FileCanInterface::open()
+{
+    close();
+
+    _reader = new TraceStreamReader(getDriver()->backend());
+    if (!_reader->open(_filename)) {
+        log_error(QString(tr("Cannot open %1: %2")).arg(_filename, _reader->errorString()));
+        delete _reader;
+        _reader = 0;
+        return;
+    }
+
+    _pending.clear();
+    _pendingPos = 0;
+    _started = false;
+    _atEnd = false;
+    _rx_count = 0;
+    _tx_dropped = 0;
+    _isOpen = true;
+}
+
+void FileCanInterface::close()
+{
+    delete _reader;
+    _reader = 0;
+    _pending.clear();
+    _pendingPos = 0;
+    _isOpen = false;
+}
+
+bool FileCanInterface::isOpen()
+{
+    return _isOpen;
+}
+
+bool FileCanInterface::isLive()
+{
+    // nothing is lost by reading the file a bit later
+    return false;
+}
+
+void FileCanInterface::sendMessage(const CanMessage &msg)
+{
+    // a capture file has no bus to send to
+    (void) msg;
+    _tx_dropped++;
+}
+
+bool FileCanInterface::fillPending()
+{
+    if (_pendingPos < _pending.size()) {
+        return true;
+    }
+
+    _pending.clear();
+    _pendingPos = 0;
+    while (_pending.isEmpty() && !_reader->atEnd()) {
+        if (_reader->readMessages(_pending, batch_frames) < 0) {
+            log_error(QString(tr("Error reading %1: %2")).arg(_filename, _reader->errorString()));
+            break;
+        }
+    }
+
+    if (_pending.isEmpty() && !_atEnd) {
+        _atEnd = true;
+        log_info(QString(tr("End of %1 reached after %2 frames")).arg(_filename).arg(_rx_count));
+    }
+    return !_pending.isEmpty();
+}
+
+bool FileCanInterface::readMessage(QList<CanMessage> &msglist, unsigned int timeout_ms)
+{
+    if (!_reader) {
+        return false;
+    }
+
+    if (!fillPending()) {
+        // stay open at the end so the measurement keeps running, but don't spin
+        QThread::msleep(qMin(timeout_ms, 100u));
+        return false;
+    }
+
+    int count = 0;
+    if (!_realTime) {
+        while ((count < batch_frames) && fillPending()) {
+            CanMessage &msg = _pending[_pendingPos++];
+            msg.setInterfaceId(getId());
+            msglist.append(msg);
+            count++;
+        }
+        _rx_count += count;
+        return count > 0;
+    }
+
+    if (!_started) {
+        _first_ns = _pending[_pendingPos].getTimestampNsecs();
+        _offset_ns = currentTimestamp() - _first_ns;
+        _clock.start();
+        _started = true;
+    }
+
+    // wait for the next frame to become due, at most for timeout_ms
+    int64_t due_ns = _pending[_pendingPos].getTimestampNsecs() - _first_ns;
+    int64_t wait_us = (due_ns - _clock.nsecsElapsed()) / timestamp_nsecs_per_usec;
+    if (wait_us > 0) {
+        QThread::usleep(qMin(wait_us, (int64_t)timeout_ms * 1000));
+    }
+
+    int64_t now_ns = _clock.nsecsElapsed();
+    while ((count < batch_frames) && fillPending()) {
+        CanMessage &msg = _pending[_pendingPos];
+        CanTimestamp ts = msg.getTimestampNsecs();
+        if ((ts - _first_ns) > now_ns) {
+            break;
+        }
+        msg.setTimestampNsecs(ts + _offset_ns);
+        msg.setInterfaceId(getId());
+        msglist.append(msg);
+        _pendingPos++;
+        count++;
+    }
+    _rx_count += count;
+    return count > 0;
+}
+
+uint32_t FileCanInterface::getState()
+{
+    return _isOpen ? state_ok : state_stopped;
+}
+
+int FileCanInterface::getNumRxFrames()
+{
+    return _rx_count;
+}
+
+int FileCanInterface::getNumRxErrors()
+{
+    return 0;
+}
+
+int FileCanInterface::getNumRxOverruns()
+{
+    return 0;
+}
+
+int FileCanInterface::getNumTxFrames()
+{
+    return 0;
+}
+
+int FileCanInterface::getNumTxErrors()
+{
+    return 0;
+}
+
+int FileCanInterface::getNumTxDropped()
+{
+    return _tx_dropped;
+}
@@ -0,0 +1,97 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#pragma once
+
+#include "../CanInterface.h"
+#include <core/MeasurementInterface.h>
+#include <core/CanMessage.h>
+#include <QElapsedTimer>
+#include <QList>
+
+class FileCanDriver;
+class TraceStreamReader;
+
+class FileCanInterface: public CanInterface {
+    Q_OBJECT
+public:
+    enum {
+        batch_frames = 4096
+    };
+
+    FileCanInterface(FileCanDriver *driver, QString filename);
+    virtual ~FileCanInterface();
+
+    virtual QString getName() const;
+    virtual QString getDetailsStr() const;
+
+    virtual void applyConfig(const MeasurementInterface &mi);
+    virtual unsigned getBitrate();
+    virtual uint32_t getCapabilities();
+
+    virtual void open();
+    virtual void close();
+    virtual bool isOpen();
+    virtual bool isLive();
+
+    virtual void sendMessage(const CanMessage &msg);
+    virtual bool readMessage(QList<CanMessage> &msglist, unsigned int timeout_ms);
+
+    virtual uint32_t getState();
+    virtual int getNumRxFrames();
+    virtual int getNumRxErrors();
+    virtual int getNumRxOverruns();
+
+    virtual int getNumTxFrames();
+    virtual int getNumTxErrors();
+    virtual int getNumTxDropped();
+
+    // real time (default) paces frames by their recorded timestamps and moves
+    // them to the time of the measurement. otherwise the file is read as fast
+    // as the listener takes it, keeping the original timestamps
+    bool isRealTime() const;
+    void setRealTime(bool realTime);
+
+    // all frames of the file have been delivered
+    bool atEnd() const;
+
+private:
+    QString _filename;
+    bool _realTime;
+    bool _isOpen;
+    bool _atEnd;
+    MeasurementInterface _settings;
+    TraceStreamReader *_reader;
+
+    QList<CanMessage> _pending;
+    int _pendingPos;
+
+    bool _started;
+    QElapsedTimer _clock;
+    CanTimestamp _first_ns;
+    CanTimestamp _offset_ns;
+
+    uint64_t _rx_count;
+    uint64_t _tx_dropped;
+
+    bool fillPending();
+};
@@ -0,0 +1,109 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "GeneratorDriver.h"
+#include <core/Backend.h>
+#include <driver/GenericCanSetupPage.h>
+
+GeneratorDriver::GeneratorDriver(Backend &backend)
+  : CanDriver(backend),
+    setupPage(GenericCanSetupPage::create(backend))
+{
+}
+
+GeneratorDriver::~GeneratorDriver()
+{
+}
+
+QString GeneratorDriver::getName()
+{
+    return "Generator";
+}
+
+bool GeneratorDriver::update()
+{
+    // interfaces are only created by addGenerator(), keep them
+    return true;
+}
+
+CanInterface *GeneratorDriver::getInterfaceByName(QString ifName)
+{
+    CanInterface *intf = CanDriver::getInterfaceByName(ifName);
+    if (intf || !ifName.startsWith("gen")) {
+        return intf;
+    }
+
+    // referenced by a workspace without a spec, fill up with defaults
+    bool ok = false;
+    int index = ifName.mid(3).toInt(&ok);
+    if (!ok || (index < 0) || (index > 255)) {
+        return 0;
+    }
+    while (getInterfaces().size() <= index) {
+        addGenerator(GeneratorInterface::defaultConfig());
+    }
+    return CanDriver::getInterfaceByName(ifName);
+}
+
+GeneratorInterface *GeneratorDriver::addGenerator(const GeneratorInterface::config_t &config)
+{
+    GeneratorInterface *intf = new GeneratorInterface(this, QString("gen%1").arg(getInterfaces().size()));
+    intf->setConfig(config);
+    addInterface(intf);
+    return intf;
+}
+
+bool GeneratorDriver::saveXML(Backend &backend, QDomDocument &xml, QDomElement &root)
+{
+    (void) backend;
+    foreach (CanInterface *intf, getInterfaces()) {
+        GeneratorInterface *gen = dynamic_cast<GeneratorInterface*>(intf);
+        QDomElement el = xml.createElement("interface");
+        el.setAttribute("name", gen->getName());
+        el.setAttribute("config", GeneratorInterface::configToString(gen->config()));
+        root.appendChild(el);
+    }
+    return true;
+}
+
+bool GeneratorDriver::loadXML(Backend &backend, QDomElement &el)
+{
+    (void) backend;
+    QDomNodeList list = el.elementsByTagName("interface");
+    for (int i=0; i<list.length(); i++) {
+        QDomElement elIntf = list.item(i).toElement();
+        QString name = elIntf.attribute("name");
+
+        GeneratorInterface::config_t config;
+        QString error;
+        if (!GeneratorInterface::parseConfig(elIntf.attribute("config"), config, error)) {
+            log_error(QString("Invalid traffic spec for generator %1: %2").arg(name, error));
+            config = GeneratorInterface::defaultConfig();
+        }
+
+        GeneratorInterface *gen = dynamic_cast<GeneratorInterface*>(getInterfaceByName(name));
+        if (gen) {
+            gen->setConfig(config);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,53 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#pragma once
+
+#include <QString>
+#include <QDomDocument>
+#include <core/Backend.h>
+#include <driver/CanDriver.h>
+#include "GeneratorInterface.h"
+
+class GenericCanSetupPage;
+
+// Synthetic traffic sources for load testing the receive path. Interfaces
+// are created on request, named gen0, gen1, ..., and their traffic specs are
+// kept in the workspace.
+class GeneratorDriver: public CanDriver {
+public:
+    GeneratorDriver(Backend &backend);
+    virtual ~GeneratorDriver();
+
+    virtual QString getName();
+    virtual bool update();
+
+    virtual CanInterface *getInterfaceByName(QString ifName);
+
+    GeneratorInterface *addGenerator(const GeneratorInterface::config_t &config);
+
+    virtual bool saveXML(Backend &backend, QDomDocument &xml, QDomElement &root);
+    virtual bool loadXML(Backend &backend, QDomElement &el);
+
+private:
+    GenericCanSetupPage *setupPage;
+};
@@ -0,0 +1,9 @@
+SOURCES += \
+    $$PWD/GeneratorInterface.cpp \
+    $$PWD/GeneratorDriver.cpp
+
+HEADERS  += \
+    $$PWD/GeneratorInterface.h \
+    $$PWD/GeneratorDriver.h
+
+FORMS +=
@@ -0,0 +1,386 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "GeneratorInterface.h"
+#include "GeneratorDriver.h"
+
+#include <core/Backend.h>
+#include <core/CanMessage.h>
+
+#include <QStringList>
+#include <QThread>
+
+static const char *pattern_names[] = { "counter", "random", "constant", "ramp" };
+
+static bool isValidFdLength(unsigned len)
+{
+    return (len <= 8) || (len == 12) || (len == 16) || (len == 20) || (len == 24) || (len == 32) || (len == 48) || (len == 64);
+}
+
+GeneratorInterface::GeneratorInterface(GeneratorDriver *driver, QString name)
+  : CanInterface((CanDriver *)driver),
+    _name(name),
+    _config(defaultConfig()),
+    _isOpen(false),
+    _start_ns(0),
+    _periodicSent(0),
+    _burstSent(0),
+    _seq(0),
+    _idIndex(0),
+    _fdAccu(0),
+    _random(0x9E3779B97F4A7C15ULL),
+    _rx_count(0),
+    _tx_count(0)
+{
+}
+
+GeneratorInterface::~GeneratorInterface()
+{
+}
+
+GeneratorInterface::config_t GeneratorInterface::defaultConfig()
+{
+    config_t config;
+    config.base_id = 0x100;
+    config.id_count = 64;
+    config.extended = false;
+    config.rate = 10000;
+    config.length = 8;
+    config.pattern = pattern_counter;
+    config.fill = 0x55;
+    config.fd_share = 0;
+    config.fd_length = 64;
+    config.burst_frames = 0;
+    config.burst_interval_ms = 0;
+    return config;
+}
+
+bool GeneratorInterface::parseConfig(const QString &spec, config_t &config, QString &error)
+{
+    config = defaultConfig();
+
+    foreach (QString item, spec.split(' ', Qt::SkipEmptyParts)) {
+        int eq = item.indexOf('=');
+        if (eq < 1) {
+            error = QString("expected key=value: %1").arg(item);
+            return false;
+        }
+        QString key = item.left(eq);
+        QString value = item.mid(eq + 1);
+        bool ok = true;
+
+        if (key == "ids") {
+            config.id_count = value.toInt(&ok, 0);
+            ok = ok && (config.id_count >= 1);
+        } else if (key == "base") {
+            config.base_id = value.toUInt(&ok, 0);
+        } else if (key == "ext") {
+            config.extended = value.toInt(&ok, 0) != 0;
+        } else if (key == "rate") {
+            config.rate = value.toUInt(&ok, 0);
+        } else if (key == "len") {
+            unsigned len = value.toUInt(&ok, 0);
+            ok = ok && (len <= 8);
+            config.length = len;
+        } else if (key == "pattern") {
+            ok = false;
+            for (int i=0; i<4; i++) {
+                if (value == pattern_names[i]) {
+                    config.pattern = (pattern_t)i;
+                    ok = true;
+                }
+            }
+        } else if (key == "fill") {
+            unsigned fill = value.toUInt(&ok, 0);
+            ok = ok && (fill <= 0xFF);
+            config.fill = fill;
+        } else if (key == "fd") {
+            config.fd_share = value.toInt(&ok, 0);
+            ok = ok && (config.fd_share >= 0) && (config.fd_share <= 100);
+        } else if (key == "fdlen") {
+            unsigned len = value.toUInt(&ok, 0);
+            ok = ok && isValidFdLength(len);
+            config.fd_length = len;
+        } else if (key == "burst") {
+            QStringList parts = value.split('/');
+            ok = (parts.size() == 2);
+            if (ok) {
+                bool ok2 = false;
+                config.burst_frames = parts[0].toUInt(&ok, 0);
+                config.burst_interval_ms = parts[1].toUInt(&ok2, 0);
+                ok = ok && ok2 && ((config.burst_frames == 0) || (config.burst_interval_ms > 0));
+            }
+        } else {
+            error = QString("unknown key: %1").arg(key);
+            return false;
+        }
+
+        if (!ok) {
+            error = QString("invalid value for %1: %2").arg(key, value);
+            return false;
+        }
+    }
+
+    uint32_t max_id = config.extended ? 0x1FFFFFFF : 0x7FF;
+    if ((config.base_id > max_id) || ((uint32_t)config.id_count - 1 > max_id - config.base_id)) {
+        error = QString("ids exceed the %1 identifier range").arg(config.extended ? "29 bit" : "11 bit");
+        return false;
+    }
+    return true;
+}
+
+QString GeneratorInterface::configToString(const config_t &config)
+{
+    return QString("ids=%1 base=0x%2 ext=%3 rate=%4 len=%5 pattern=%6")
+            .arg(config.id_count)
+            .arg(config.base_id, 0, 16)
+            .arg(config.extended ? 1 : 0)
+            .arg(config.rate)
+            .arg(config.length)
+            .arg(pattern_names[config.pattern])
+        + QString(" fill=0x%1 fd=%2 fdlen=%3 burst=%4/%5")
+            .arg(config.fill, 2, 16, QLatin1Char('0'))
+            .arg(config.fd_share)
+            .arg(config.fd_length)
+            .arg(config.burst_frames)
+            .arg(config.burst_interval_ms);
+}
+
+GeneratorInterface::config_t GeneratorInterface::config() const
+{
+    return _config;
+}
+
+void GeneratorInterface::setConfig(const config_t &config)
+{
+    _config = config;
+}
+
+QString GeneratorInterface::getName() const
+{
+    return _name;
+}
+
+QString GeneratorInterface::getDetailsStr() const
+{
+    return configToString(_config);
+}
+
+void GeneratorInterface::applyConfig(const MeasurementInterface &mi)
+{
+    _settings = mi;
+}
+
+unsigned GeneratorInterface::getBitrate()
+{
+    return _settings.bitrate();
+}
+
+uint32_t GeneratorInterface::getCapabilities()
+{
+    return CanInterface::capability_canfd;
+}
+
+void GeneratorInterface::open()
+{
+    _start_ns = currentTimestamp();
+    _clock.start();
+    _periodicSent = 0;
+    _burstSent = 0;
+    _seq = 0;
+    _idIndex = 0;
+    _fdAccu = 0;
+    _rx_count = 0;
+    _tx_count = 0;
+    _isOpen = true;
+}
+
+void GeneratorInterface::close()
+{
+    _isOpen = false;
+}
+
+bool GeneratorInterface::isOpen()
+{
+    return _isOpen;
+}
+
+void GeneratorInterface::sendMessage(const CanMessage &msg)
+{
+    // there is no bus, accept and discard
+    (void) msg;
+    _tx_count++;
+}
+
+bool GeneratorInterface::readMessage(QList<CanMessage> &msglist, unsigned int timeout_ms)
+{
+    if (!_isOpen) {
+        return false;
+    }
+
+    int count = generate(msglist, _clock.nsecsElapsed());
+    if (count == 0) {
+        // sleep until the next frame is due, at most for timeout_ms
+        int64_t elapsed_ns = _clock.nsecsElapsed();
+        int64_t next_ns = (int64_t)(_periodicSent * 1e9 / _config.rate);
+        if (_config.burst_frames) {
+            int64_t interval_ns = (int64_t)_config.burst_interval_ms * 1000000;
+            next_ns = qMin(next_ns, (elapsed_ns / interval_ns + 1) * interval_ns);
+        }
+        int64_t wait_us = qMin((next_ns - elapsed_ns) / 1000 + 1, (int64_t)timeout_ms * 1000);
+        if (wait_us > 0) {
+            QThread::usleep(wait_us);
+        }
+        count = generate(msglist, _clock.nsecsElapsed());
+    }
+
+    _rx_count += count;
+    return count > 0;
+}
+
+int GeneratorInterface::generate(QList<CanMessage> &msglist, int64_t elapsed_ns)
+{
+    int count = 0;
+
+    if (_config.rate == 0) {
+        for (; count<batch_frames; count++) {
+            msglist.append(CanMessage());
+            fillFrame(msglist.last(), elapsed_ns);
+        }
+        return count;
+    }
+
+    uint64_t periodicDue = (uint64_t)((double)elapsed_ns * _config.rate / 1e9) + 1;
+    int64_t interval_ns = (int64_t)_config.burst_interval_ms * 1000000;
+    uint64_t burstDue = _config.burst_frames ? (uint64_t)(elapsed_ns / interval_ns) * _config.burst_frames : 0;
+
+    // merge the periodic and the burst schedule in time order
+    while (count < batch_frames) {
+        bool periodic = _periodicSent < periodicDue;
+        bool burst = _burstSent < burstDue;
+        if (!periodic && !burst) {
+            break;
+        }
+
+        int64_t periodic_ns = periodic ? (int64_t)(_periodicSent * 1e9 / _config.rate) : 0;
+        int64_t burst_ns = burst ? (int64_t)(_burstSent / _config.burst_frames + 1) * interval_ns : 0;
+
+        msglist.append(CanMessage());
+        if (periodic && (!burst || (periodic_ns <= burst_ns))) {
+            fillFrame(msglist.last(), periodic_ns);
+            _periodicSent++;
+        } else {
+            fillFrame(msglist.last(), burst_ns);
+            _burstSent++;
+        }
+        count++;
+    }
+    return count;
+}
+
+void GeneratorInterface::fillFrame(CanMessage &msg, int64_t ts_ns)
+{
+    msg.setId(_config.base_id + _idIndex);
+    if (_config.extended) {
+        msg.setExtended(true);
+    }
+    if (++_idIndex >= _config.id_count) {
+        _idIndex = 0;
+    }
+
+    bool fd = false;
+    if (_config.fd_share > 0) {
+        _fdAccu += _config.fd_share;
+        if (_fdAccu >= 100) {
+            _fdAccu -= 100;
+            fd = true;
+        }
+    }
+    uint8_t len = fd ? _config.fd_length : _config.length;
+    msg.setFD(fd);
+    msg.setBRS(fd);
+    msg.setLength(len);
+
+    uint64_t word = 0;
+    for (int i=0; i<len; i++) {
+        switch (_config.pattern) {
+            case pattern_counter:
+                msg.setByte(i, (_seq >> (8 * (i % 8))) & 0xFF);
+                break;
+            case pattern_random:
+                if ((i % 8) == 0) {
+                    // xorshift64
+                    _random ^= _random << 13;
+                    _random ^= _random >> 7;
+                    _random ^= _random << 17;
+                    word = _random;
+                }
+                msg.setByte(i, (word >> (8 * (i % 8))) & 0xFF);
+                break;
+            case pattern_constant:
+                msg.setByte(i, _config.fill);
+                break;
+            case pattern_ramp:
+                msg.setByte(i, (_seq + i) & 0xFF);
+                break;
+        }
+    }
+    _seq++;
+
+    msg.setTimestampNsecs(_start_ns + ts_ns);
+    msg.setInterfaceId(getId());
+}
+
+uint32_t GeneratorInterface::getState()
+{
+    return _isOpen ? state_ok : state_stopped;
+}
+
+int GeneratorInterface::getNumRxFrames()
+{
+    return _rx_count;
+}
+
+int GeneratorInterface::getNumRxErrors()
+{
+    return 0;
+}
+
+int GeneratorInterface::getNumRxOverruns()
+{
+    return 0;
+}
+
+int GeneratorInterface::getNumTxFrames()
+{
+    return _tx_count;
+}
+
+int GeneratorInterface::getNumTxErrors()
+{
+    return 0;
+}
+
+int GeneratorInterface::getNumTxDropped()
+{
+    return 0;
+}
@@ -0,0 +1,117 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#pragma once
+
+#include "../CanInterface.h"
+#include <core/MeasurementInterface.h>
+#include <core/CanTimestamp.h>
+#include <QElapsedTimer>
+#include <QList>
+
+class GeneratorDriver;
+
+class GeneratorInterface: public CanInterface {
+    Q_OBJECT
+public:
+    typedef enum {
+        pattern_counter,  // frame sequence number, little endian
+        pattern_random,
+        pattern_constant, // every byte set to fill
+        pattern_ramp      // byte n = sequence number + n
+    } pattern_t;
+
+    typedef struct {
+        uint32_t base_id;
+        int id_count;             // ids base_id .. base_id+id_count-1, sent round robin
+        bool extended;
+        uint32_t rate;            // frames per second, 0 = as fast as possible
+        uint8_t length;
+        pattern_t pattern;
+        uint8_t fill;
+        int fd_share;             // percentage of frames sent as CAN FD with BRS
+        uint8_t fd_length;
+        uint32_t burst_frames;    // extra frames sent at once every burst_interval_ms
+        uint32_t burst_interval_ms;
+    } config_t;
+
+    enum {
+        batch_frames = 4096
+    };
+
+    GeneratorInterface(GeneratorDriver *driver, QString name);
+    virtual ~GeneratorInterface();
+
+    // specs are space separated key=value pairs, e.g.
+    // "ids=64 base=0x100 ext=0 rate=10000 len=8 pattern=counter fill=0x55 fd=25 fdlen=64 burst=500/100"
+    static config_t defaultConfig();
+    static bool parseConfig(const QString &spec, config_t &config, QString &error);
+    static QString configToString(const config_t &config);
+
+    config_t config() const;
+    void setConfig(const config_t &config);
+
+    virtual QString getName() const;
+    virtual QString getDetailsStr() const;
+
+    virtual void applyConfig(const MeasurementInterface &mi);
+    virtual unsigned getBitrate();
+    virtual uint32_t getCapabilities();
+
+    virtual void open();
+    virtual void close();
+    virtual bool isOpen();
+
+    virtual void sendMessage(const CanMessage &msg);
+    virtual bool readMessage(QList<CanMessage> &msglist, unsigned int timeout_ms);
+
+    virtual uint32_t getState();
+    virtual int getNumRxFrames();
+    virtual int getNumRxErrors();
+    virtual int getNumRxOverruns();
+
+    virtual int getNumTxFrames();
+    virtual int getNumTxErrors();
+    virtual int getNumTxDropped();
+
+private:
+    QString _name;
+    config_t _config;
+    MeasurementInterface _settings;
+    bool _isOpen;
+
+    QElapsedTimer _clock;
+    CanTimestamp _start_ns;
+    uint64_t _periodicSent;
+    uint64_t _burstSent;
+
+    uint64_t _seq;
+    int _idIndex;
+    int _fdAccu;
+    uint64_t _random;
+
+    uint64_t _rx_count;
+    uint64_t _tx_count;
+
+    int generate(QList<CanMessage> &msglist, int64_t elapsed_ns);
+    void fillFrame(CanMessage &msg, int64_t ts_ns);
+};
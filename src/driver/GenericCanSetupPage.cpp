@@ -5,6 +5,7 @@
 #include <core/MeasurementInterface.h>
 #include <window/SetupDialog/SetupDialog.h>
 #include <QList>
+#include <QApplication>
 #include <QtAlgorithms>
 #include <algorithm>
 
@@ -38,6 +39,17 @@ GenericCanSetupPage::~GenericCanSetupPage()
     delete ui;
 }
 
+GenericCanSetupPage *GenericCanSetupPage::create(Backend &backend)
+{
+    if (!qobject_cast<QApplication*>(QCoreApplication::instance())) {
+        return 0;
+    }
+
+    GenericCanSetupPage *page = new GenericCanSetupPage();
+    connect(&backend, SIGNAL(onSetupDialogCreated(SetupDialog&)), page, SLOT(onSetupDialogCreated(SetupDialog&)));
+    return page;
+}
+
 void GenericCanSetupPage::onSetupDialogCreated(SetupDialog &dlg)
 {
     dlg.addPage(this);
@@ -20,6 +20,10 @@ public:
     explicit GenericCanSetupPage(QWidget *parent = 0);
     ~GenericCanSetupPage();
 
+    // page registered for the setup dialog, or 0 when running without a
+    // QApplication (benchmarks, headless capture), which has no widgets
+    static GenericCanSetupPage *create(Backend &backend);
+
 public slots:
     void onSetupDialogCreated(SetupDialog &dlg);
     void onShowInterfacePage(SetupDialog &dlg, MeasurementInterface *mi);
@@ -36,9 +36,8 @@
 
 GrIPDriver::GrIPDriver(Backend &backend)
   : CanDriver(backend),
-    setupPage(new GenericCanSetupPage())
+    setupPage(GenericCanSetupPage::create(backend))
 {
-    QObject::connect(&backend, SIGNAL(onSetupDialogCreated(SetupDialog&)), setupPage, SLOT(onSetupDialogCreated(SetupDialog&)));
     m_GrIPHandler = nullptr;
 }
 
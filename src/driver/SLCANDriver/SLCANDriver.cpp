@@ -35,9 +35,8 @@
 
 SLCANDriver::SLCANDriver(Backend &backend)
   : CanDriver(backend),
-    setupPage(new GenericCanSetupPage())
+    setupPage(GenericCanSetupPage::create(backend))
 {
-    QObject::connect(&backend, SIGNAL(onSetupDialogCreated(SetupDialog&)), setupPage, SLOT(onSetupDialogCreated(SetupDialog&)));
 }
 
 SLCANDriver::~SLCANDriver()
@@ -956,10 +956,9 @@ bool SLCANInterface::readMessage(QList<CanMessage> &msglist, unsigned int timeou
 
 bool SLCANInterface::parseMessage(CanMessage &msg)
 {
-    // Set timestamp to current time
-    struct timeval tv;
-    gettimeofday(&tv,NULL);
-    msg.setTimestamp(tv);
+    // SLCAN frames carry no usable timestamp, they are stamped with the
+    // host clock when the line is parsed
+    msg.setTimestampNsecs(currentTimestamp());
 
     // Defaults
     msg.setErrorFrame(0);
@@ -1157,6 +1156,8 @@ bool SLCANInterface::parseMessage(CanMessage &msg)
     return true;
 
 /*
+    // never built: left over from the SocketCAN driver, a serial port has
+    // no socket timestamps to read
     // FIXME
     if (_ts_mode == ts_mode_SIOCSHWTSTAMP) {
         // TODO implement me
@@ -1165,7 +1166,7 @@ bool SLCANInterface::parseMessage(CanMessage &msg)
 
     if (_ts_mode==ts_mode_SIOCGSTAMPNS) {
         if (ioctl(_fd, SIOCGSTAMPNS, &ts_rcv) == 0) {
-            msg.setTimestamp(ts_rcv.tv_sec, ts_rcv.tv_nsec/1000);
+            msg.setTimestamp(ts_rcv);
         } else {
             _ts_mode = ts_mode_SIOCGSTAMP;
         }
@@ -1173,6 +1174,6 @@ bool SLCANInterface::parseMessage(CanMessage &msg)
 
     if (_ts_mode==ts_mode_SIOCGSTAMP) {
         ioctl(_fd, SIOCGSTAMP, &tv_rcv);
-        msg.setTimestamp(tv_rcv.tv_sec, tv_rcv.tv_usec);
+        msg.setTimestamp(tv_rcv);
     }*/
 }
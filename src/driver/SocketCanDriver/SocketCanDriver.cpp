@@ -39,9 +39,8 @@
 
 SocketCanDriver::SocketCanDriver(Backend &backend)
   : CanDriver(backend),
-    setupPage(new GenericCanSetupPage())
+    setupPage(GenericCanSetupPage::create(backend))
 {
-    QObject::connect(&backend, SIGNAL(onSetupDialogCreated(SetupDialog&)), setupPage, SLOT(onSetupDialogCreated(SetupDialog&)));
 }
 
 SocketCanDriver::~SocketCanDriver() {
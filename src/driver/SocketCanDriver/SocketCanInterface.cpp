@@ -24,8 +24,11 @@
 #include <core/Backend.h>
 #include <core/MeasurementInterface.h>
 #include <core/CanMessage.h>
+#include <core/CanCaptureFilter.h>
 
 #include <stdio.h>
+#include <string.h>
+#include <errno.h>
 #include <unistd.h>
 #include <time.h>
 #include <QString>
@@ -35,12 +38,15 @@
 #include <sys/socket.h>
 #include <sys/ioctl.h>
 #include <sys/time.h>
+#include <sys/uio.h>
 
 #include <linux/if.h>
 #include <linux/can.h>
 #include <linux/can/raw.h>
 #include <linux/can/netlink.h>
 #include <linux/sockios.h>
+#include <linux/net_tstamp.h>
+#include <linux/errqueue.h>
 #include <netlink/version.h>
 #include <netlink/route/link.h>
 #include <netlink/route/link/can.h>
@@ -51,7 +57,9 @@ SocketCanInterface::SocketCanInterface(SocketCanDriver *driver, int index, QStri
     _isOpen(false),
 	_fd(0),
     _name(name),
-    _ts_mode(ts_mode_SIOCSHWTSTAMP)
+    _managed(false),
+    _fdFrames(false),
+    _txDropped(0)
 {
 }
 
@@ -131,7 +139,11 @@ QStringList SocketCanInterface::buildCanIfConfigArgs(const MeasurementInterface
 
 void SocketCanInterface::applyConfig(const MeasurementInterface &mi)
 {
-    if (!mi.doConfigure()) {
+    // the filter is a socket option, it applies to unmanaged interfaces too
+    _captureFilter = mi.captureFilter();
+    _managed = mi.doConfigure();
+
+    if (!_managed) {
         log_info(QString("interface %1 not managed by cangaroo, not touching configuration").arg(getName()));
         return;
     }
@@ -237,7 +249,7 @@ bool SocketCanInterface::readConfig()
 bool SocketCanInterface::readConfigFromLink(rtnl_link *link)
 {
     _config.state = state_unknown;
-    _config.supports_canfd = (rtnl_link_get_mtu(link)==72);
+    _config.supports_canfd = (rtnl_link_get_mtu(link)==CANFD_MTU);
     _config.supports_timing = rtnl_link_is_can(link);
     if (_config.supports_timing) {
         rtnl_link_can_freq(link, &_config.base_freq);
@@ -336,7 +348,8 @@ int SocketCanInterface::getNumRxOverruns()
 
 int SocketCanInterface::getNumTxDropped()
 {
-    return _status.tx_dropped;
+    // updateStatus() overwrites tx_dropped with the kernel counter
+    return _status.tx_dropped + _txDropped;
 }
 
 int SocketCanInterface::getIfIndex() {
@@ -367,9 +380,108 @@ void SocketCanInterface::open() {
         _isOpen = false;
 	}
 
+    // always ask for FD frames, classic ones still arrive with CAN_MTU.
+    // Any FD capable kernel accepts the option, only the interface MTU
+    // tells whether FD frames can actually be sent.
+    int fd_frames = 1;
+    _fdFrames = (setsockopt(_fd, SOL_CAN_RAW, CAN_RAW_FD_FRAMES, &fd_frames, sizeof(fd_frames)) == 0);
+    if (_fdFrames) {
+        _fdFrames = (ioctl(_fd, SIOCGIFMTU, &ifr) == 0) && (ifr.ifr_mtu == CANFD_MTU);
+    }
+    _txDropped = 0;
+
+    applyCaptureFilter();
+    enableTimestamps();
+    setupReceiveBuffers();
+
     _isOpen = true;
 }
 
+void SocketCanInterface::setupReceiveBuffers()
+{
+    _rxSlots.resize(batch_frames);
+    _rxHeaders.resize(batch_frames);
+    memset(_rxHeaders.data(), 0, batch_frames * sizeof(struct mmsghdr));
+
+    for (int i=0; i<batch_frames; i++) {
+        rx_slot_t &slot = _rxSlots[i];
+        slot.iov.iov_base = &slot.frame;
+        slot.iov.iov_len = sizeof(slot.frame);
+
+        struct msghdr &hdr = _rxHeaders[i].msg_hdr;
+        hdr.msg_iov = &slot.iov;
+        hdr.msg_iovlen = 1;
+        hdr.msg_control = slot.control.buf;
+        hdr.msg_controllen = sizeof(slot.control.buf);
+    }
+}
+
+void SocketCanInterface::applyCaptureFilter()
+{
+    // let the kernel drop unwanted frames before they reach user space;
+    // without rules the default filter of the socket accepts everything
+    const QList<CanCaptureFilter::rule_t> &rules = _captureFilter.rules();
+    if (!rules.isEmpty()) {
+        QVector<struct can_filter> filters;
+        filters.reserve(rules.size());
+        foreach (const CanCaptureFilter::rule_t &rule, rules) {
+            // include the EFF bit in the mask so standard and extended ids never alias
+            struct can_filter f;
+            f.can_id = rule.id | (rule.extended ? CAN_EFF_FLAG : 0);
+            f.can_mask = rule.mask | CAN_EFF_FLAG;
+            if (rule.inverted) {
+                f.can_id |= CAN_INV_FILTER;
+            }
+            filters.append(f);
+        }
+        if (setsockopt(_fd, SOL_CAN_RAW, CAN_RAW_FILTER, filters.constData(), filters.size() * sizeof(struct can_filter)) < 0) {
+            log_error(QString("interface %1: could not set capture filter: %2").arg(getName(), strerror(errno)));
+        } else {
+            log_info(QString("interface %1: capture filter %2").arg(getName(), _captureFilter.toString()));
+        }
+    }
+
+    can_err_mask_t err_mask = _captureFilter.errorMask() & CAN_ERR_MASK;
+    if (err_mask) {
+        if (setsockopt(_fd, SOL_CAN_RAW, CAN_RAW_ERR_FILTER, &err_mask, sizeof(err_mask)) < 0) {
+            log_error(QString("interface %1: could not set error frame filter: %2").arg(getName(), strerror(errno)));
+        }
+    }
+}
+
+void SocketCanInterface::enableTimestamps()
+{
+    // the adapter config is device wide, so only touch it on interfaces we
+    // manage; we only want receive stamps, leave transmit stamping off
+    if (_managed) {
+        struct hwtstamp_config hwcfg;
+        memset(&hwcfg, 0, sizeof(hwcfg));
+        hwcfg.tx_type = HWTSTAMP_TX_OFF;
+        hwcfg.rx_filter = HWTSTAMP_FILTER_ALL;
+
+        struct ifreq ifr;
+        memset(&ifr, 0, sizeof(ifr));
+        strlcpy(ifr.ifr_name, _name.toStdString().c_str(), IFNAMSIZ);
+        ifr.ifr_data = (char *)&hwcfg;
+        if (ioctl(_fd, SIOCSHWTSTAMP, &ifr) < 0) {
+            log_info(QString("interface %1: hardware timestamps not enabled (%2)").arg(getName(), strerror(errno)));
+        }
+    }
+
+    int flags = SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE
+              | SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+    if (setsockopt(_fd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) == 0) {
+        return;
+    }
+
+    // readTimestamp() picks whichever control message arrives
+    int on = 1;
+    if (setsockopt(_fd, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on)) < 0) {
+        setsockopt(_fd, SOL_SOCKET, SO_TIMESTAMP, &on, sizeof(on));
+    }
+    log_warning(QString("interface %1: SO_TIMESTAMPING not available, using software timestamps").arg(getName()));
+}
+
 bool SocketCanInterface::isOpen()
 {
     return _isOpen;
@@ -381,7 +493,8 @@ void SocketCanInterface::close() {
 }
 
 void SocketCanInterface::sendMessage(const CanMessage &msg) {
-	struct can_frame frame;
+	struct canfd_frame frame;
+	memset(&frame, 0, sizeof(frame));
 
 	frame.can_id = msg.getId();
 
@@ -397,24 +510,92 @@ void SocketCanInterface::sendMessage(const CanMessage &msg) {
 		frame.can_id |= CAN_ERR_FLAG;
 	}
 
+	bool fd = msg.isFD() && !msg.isRTR();
+	if (fd && !_fdFrames) {
+		// truncating to a classic frame would put different data on the bus
+		if (_txDropped++ == 0) {
+			log_warning(QString("interface %1 does not accept CAN FD frames, dropping them").arg(getName()));
+		}
+		return;
+	}
+
+	uint8_t max_len = fd ? CANFD_MAX_DLEN : CAN_MAX_DLEN;
+
 	uint8_t len = msg.getLength();
-	if (len>8) { len = 8; }
+	if (len>max_len) { len = max_len; }
 
-	frame.can_dlc = len;
+	frame.len = len;
 	for (int i=0; i<len; i++) {
 		frame.data[i] = msg.getByte(i);
 	}
 
-	::write(_fd, &frame, sizeof(struct can_frame));
+	if (fd) {
+		frame.flags = msg.isBRS() ? CANFD_BRS : 0;
+#ifdef CANFD_FDF
+		frame.flags |= CANFD_FDF;
+#endif
+	}
+
+	// struct can_frame is the first CAN_MTU bytes of struct canfd_frame
+	ssize_t mtu = fd ? CANFD_MTU : CAN_MTU;
+	if (::write(_fd, &frame, mtu) != mtu) {
+		if (_txDropped++ == 0) {
+			log_warning(QString("interface %1: could not send frame: %2").arg(getName(), strerror(errno)));
+		}
+	}
+}
+
+void SocketCanInterface::readTimestamp(struct msghdr *hdr, CanMessage &msg)
+{
+    struct cmsghdr *cmsg;
+    for (cmsg = CMSG_FIRSTHDR(hdr); cmsg; cmsg = CMSG_NXTHDR(hdr, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET) {
+            continue;
+        }
+
+        if (cmsg->cmsg_type == SCM_TIMESTAMPING) {
+            // ts[0] is the software, ts[2] the raw hardware timestamp,
+            // whichever the driver did not provide is zero. Many CAN
+            // adapters stamp with their own or the monotonic clock, the
+            // rest of cangaroo needs wall clock time, so only take the
+            // hardware stamp when it agrees with the software one.
+            struct scm_timestamping ts;
+            memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+            bool have_sw = ts.ts[0].tv_sec || ts.ts[0].tv_nsec;
+            bool have_hw = ts.ts[2].tv_sec || ts.ts[2].tv_nsec;
+            if (have_hw && have_sw) {
+                int64_t diff = (int64_t)(ts.ts[2].tv_sec - ts.ts[0].tv_sec) * 1000000000
+                             + (ts.ts[2].tv_nsec - ts.ts[0].tv_nsec);
+                have_hw = (diff > -max_hw_clock_offset_ns) && (diff < max_hw_clock_offset_ns);
+            }
+            if (have_hw) {
+                msg.setTimestamp(ts.ts[2]);
+            } else if (have_sw) {
+                msg.setTimestamp(ts.ts[0]);
+            } else {
+                msg.setTimestampNsecs(currentTimestamp());
+            }
+            return;
+        } else if (cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+            struct timespec ts;
+            memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+            msg.setTimestamp(ts);
+            return;
+        } else if (cmsg->cmsg_type == SCM_TIMESTAMP) {
+            struct timeval tv;
+            memcpy(&tv, CMSG_DATA(cmsg), sizeof(tv));
+            msg.setTimestamp(tv);
+            return;
+        }
+    }
+
+    // no timestamp from the kernel, the best we can do is now
+    msg.setTimestampNsecs(currentTimestamp());
 }
 
 bool SocketCanInterface::readMessage(QList<CanMessage> &msglist, unsigned int timeout_ms) {
 
-    struct can_frame frame;
-    struct timespec ts_rcv;
-    struct timeval tv_rcv;
     struct timeval timeout;
-    //struct ifreq hwtstamp;
     fd_set fdset;
 
     timeout.tv_sec = timeout_ms / 1000;
@@ -423,50 +604,49 @@ bool SocketCanInterface::readMessage(QList<CanMessage> &msglist, unsigned int ti
     FD_ZERO(&fdset);
     FD_SET(_fd, &fdset);
 
-    CanMessage msg;
-
     int rv = select(_fd+1, &fdset, NULL, NULL, &timeout);
-    if (rv>0) {
+    if (rv<=0) {
+        return false;
+    }
 
-        if (read(_fd, &frame, sizeof(struct can_frame)) < 0) {
-            return false;
-        }
+    // drain up to batch_frames in one syscall, each with its own
+    // timestamp as ancillary data; the kernel overwrites the lengths
+    for (int i=0; i<batch_frames; i++) {
+        struct msghdr &hdr = _rxHeaders[i].msg_hdr;
+        hdr.msg_controllen = sizeof(_rxSlots[i].control.buf);
+        hdr.msg_flags = 0;
+    }
 
-        if (_ts_mode == ts_mode_SIOCSHWTSTAMP) {
-            // TODO implement me
-            _ts_mode = ts_mode_SIOCGSTAMPNS;
-        }
+    int n = recvmmsg(_fd, _rxHeaders.data(), batch_frames, MSG_DONTWAIT, NULL);
+    if (n<=0) {
+        return false;
+    }
 
-        if (_ts_mode==ts_mode_SIOCGSTAMPNS) {
-            if (ioctl(_fd, SIOCGSTAMPNS, &ts_rcv) == 0) {
-                msg.setTimestamp(ts_rcv.tv_sec, ts_rcv.tv_nsec/1000);
-            } else {
-                _ts_mode = ts_mode_SIOCGSTAMP;
-            }
-        }
+    CanMessage msg;
+    msg.setInterfaceId(getId());
+    for (int k=0; k<n; k++) {
+        const struct canfd_frame &frame = _rxSlots[k].frame;
+        bool fd = (_rxHeaders[k].msg_len == CANFD_MTU);
 
-        if (_ts_mode==ts_mode_SIOCGSTAMP) {
-            ioctl(_fd, SIOCGSTAMP, &tv_rcv);
-            msg.setTimestamp(tv_rcv.tv_sec, tv_rcv.tv_usec);
-        }
+        readTimestamp(&_rxHeaders[k].msg_hdr, msg);
 
         msg.setId(frame.can_id);
         msg.setExtended((frame.can_id & CAN_EFF_FLAG)!=0);
         msg.setRTR((frame.can_id & CAN_RTR_FLAG)!=0);
         msg.setErrorFrame((frame.can_id & CAN_ERR_FLAG)!=0);
-        msg.setInterfaceId(getId());
+        msg.setFD(fd);
+        msg.setBRS(fd && (frame.flags & CANFD_BRS));
 
-        uint8_t len = frame.can_dlc;
-        if (len>8) { len = 8; }
+        uint8_t len = frame.len;
+        uint8_t max_len = fd ? CANFD_MAX_DLEN : CAN_MAX_DLEN;
+        if (len>max_len) { len = max_len; }
 
         msg.setLength(len);
         for (int i=0; i<len; i++) {
             msg.setByte(i, frame.data[i]);
         }
 
-	msglist.append(msg);
-        return true;
-    } else {
-        return false;
+        msglist.append(msg);
     }
+    return true;
 }
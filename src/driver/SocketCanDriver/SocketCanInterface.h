@@ -22,7 +22,13 @@
 #pragma once
 
 #include "../CanInterface.h"
+#include <core/CanCaptureFilter.h>
+#include <QVector>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <linux/can.h>
 #include <linux/can/netlink.h>
+#include <linux/errqueue.h>
 
 class SocketCanDriver;
 
@@ -51,6 +57,11 @@ typedef struct {
 
 class SocketCanInterface: public CanInterface {
 public:
+    enum {
+        batch_frames = 64, // frames received per recvmmsg() call
+        max_hw_clock_offset_ns = 1000000000 // hardware stamps further off are not wall clock
+    };
+
     SocketCanInterface(SocketCanDriver *driver, int index, QString name);
 	virtual ~SocketCanInterface();
 
@@ -92,11 +103,14 @@ public:
     int getIfIndex();
 
 private:
-    typedef enum {
-        ts_mode_SIOCSHWTSTAMP,
-        ts_mode_SIOCGSTAMPNS,
-        ts_mode_SIOCGSTAMP
-    } ts_mode_t;
+    typedef struct {
+        struct canfd_frame frame; // classic frames fill the first CAN_MTU bytes
+        struct iovec iov;
+        union {
+            struct cmsghdr align;
+            char buf[CMSG_SPACE(sizeof(struct scm_timestamping))];
+        } control;
+    } rx_slot_t;
 
     int _idx;
     bool _isOpen;
@@ -105,11 +119,23 @@ private:
 
     can_config_t _config;
     can_status_t _status;
-    ts_mode_t _ts_mode;
+    bool _managed;
+    bool _fdFrames;
+    int _txDropped; // frames sendMessage() could not hand to the kernel
+    CanCaptureFilter _captureFilter;
+
+    // preallocated receive buffers, _rxHeaders point into _rxSlots
+    QVector<rx_slot_t> _rxSlots;
+    QVector<struct mmsghdr> _rxHeaders;
 
     const char *cname();
     bool updateStatus();
 
+    void applyCaptureFilter();
+    void enableTimestamps();
+    void setupReceiveBuffers();
+    void readTimestamp(struct msghdr *hdr, CanMessage &msg);
+
     QString buildIpRouteCmd(const MeasurementInterface &mi);
     QStringList buildCanIfConfigArgs(const MeasurementInterface &mi);
 };
@@ -0,0 +1,268 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "HeadlessCapture.h"
+
+#include <core/Backend.h>
+#include <core/CanTrace.h>
+#include <core/MeasurementSetup.h>
+#include <core/MeasurementNetwork.h>
+#include <core/MeasurementInterface.h>
+#include <driver/CanInterface.h>
+#include <tracefile/TraceRecorder.h>
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDomDocument>
+#include <QFile>
+#include <QTextStream>
+#include <signal.h>
+
+static volatile sig_atomic_t stopRequested = 0;
+
+HeadlessCapture::HeadlessCapture(Backend &backend, QObject *parent)
+  : QObject(parent),
+    _backend(backend),
+    _exitCode(0),
+    _duration_s(0),
+    _lastStats_ms(0),
+    _frames(0),
+    _lastFrames(0)
+{
+    connect(&_statsTimer, SIGNAL(timeout()), this, SLOT(printStatistics()));
+    _durationTimer.setSingleShot(true);
+    connect(&_durationTimer, SIGNAL(timeout()), this, SLOT(stop()));
+    _signalTimer.setInterval(signal_poll_interval_ms);
+    connect(&_signalTimer, SIGNAL(timeout()), this, SLOT(checkSignals()));
+
+    // the recorder and listener threads log, too
+    qRegisterMetaType<log_level_t>("log_level_t");
+    connect(&_backend, SIGNAL(onLogMessage(QDateTime,log_level_t,QString)), this, SLOT(onLogMessage(QDateTime,log_level_t,QString)));
+    connect(_backend.getTrace(), SIGNAL(messagesEnqueued(int,int)), this, SLOT(onMessagesEnqueued(int,int)), Qt::DirectConnection);
+}
+
+bool HeadlessCapture::isRequested(int argc, char *argv[])
+{
+    for (int i=1; i<argc; i++) {
+        if (QString(argv[i]) == "--headless") {
+            return true;
+        }
+    }
+    return false;
+}
+
+int HeadlessCapture::exitCode() const
+{
+    return _exitCode;
+}
+
+bool HeadlessCapture::loadWorkspace(const QString &filename)
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        log_error(QString("Cannot open workspace settings file: %1").arg(filename));
+        return false;
+    }
+
+    QDomDocument doc;
+    if (!doc.setContent(&file)) {
+        file.close();
+        log_error(QString("Cannot load settings from file: %1").arg(filename));
+        return false;
+    }
+    file.close();
+
+    // the tabs of the workspace are windows and have no meaning here
+    QDomElement root = doc.firstChild().toElement();
+    if (!_backend.loadWorkspaceXML(root)) {
+        log_error(QString("Unable to read measurement setup from workspace config file: %1").arg(filename));
+        return false;
+    }
+    return true;
+}
+
+bool HeadlessCapture::setup(QCoreApplication &app)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Capture CAN traffic without a GUI, using the setup of a cangaroo workspace.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("workspace", "cangaroo workspace file with the measurement setup.");
+    QCommandLineOption headlessOption("headless", "Run without a GUI.");
+    QCommandLineOption recordOption("record", "Record to this file (.blf or native), overrides the workspace recorder.", "file");
+    QCommandLineOption rotateSizeOption("rotate-size", "Start a new recording file every <MB> megabytes.", "MB");
+    QCommandLineOption rotateTimeOption("rotate-time", "Start a new recording file every <minutes> minutes.", "minutes");
+    QCommandLineOption statsOption("stats", "Print statistics every <seconds> seconds, 0 to disable (default 10).", "seconds", QString::number(default_stats_interval_s));
+    QCommandLineOption durationOption("duration", "Stop after <seconds> seconds (default: run until SIGINT/SIGTERM).", "seconds", "0");
+    QCommandLineOption retentionOption("retention", "Frames kept in memory (default: workspace setting, or 100000 if unlimited).", "frames");
+    parser.addOption(headlessOption);
+    parser.addOption(recordOption);
+    parser.addOption(rotateSizeOption);
+    parser.addOption(rotateTimeOption);
+    parser.addOption(statsOption);
+    parser.addOption(durationOption);
+    parser.addOption(retentionOption);
+    parser.process(app);
+
+    if (parser.positionalArguments().size() != 1) {
+        QTextStream(stderr) << parser.helpText();
+        _exitCode = 2;
+        return false;
+    }
+
+    // enumerates the interfaces, like a new workspace in the GUI
+    _backend.addDefaultDrivers();
+    _backend.setDefaultSetup();
+    if (!loadWorkspace(parser.positionalArguments().first())) {
+        _exitCode = 2;
+        return false;
+    }
+
+    TraceRecorder *recorder = _backend.getRecorder();
+    if (parser.isSet(recordOption)) {
+        recorder->setFileName(parser.value(recordOption));
+        recorder->setEnabled(true);
+    }
+    if (parser.isSet(rotateSizeOption)) {
+        recorder->setRotation(TraceRecorder::rotate_size, parser.value(rotateSizeOption).toULongLong() * 1024 * 1024);
+    } else if (parser.isSet(rotateTimeOption)) {
+        recorder->setRotation(TraceRecorder::rotate_time, parser.value(rotateTimeOption).toULongLong() * 60 * 1000);
+    }
+
+    // nobody looks at the in-memory trace, it only has to feed the recorder
+    CanTrace *trace = _backend.getTrace();
+    if (parser.isSet(retentionOption)) {
+        trace->setRetention(CanTrace::retention_frames, parser.value(retentionOption).toULongLong());
+    } else if (trace->retentionMode() == CanTrace::retention_unlimited) {
+        trace->setRetention(CanTrace::retention_frames, default_retention_frames);
+    }
+
+    foreach (MeasurementNetwork *network, _backend.getSetup().getNetworks()) {
+        foreach (MeasurementInterface *mi, network->interfaces()) {
+            CanInterface *intf = _backend.getInterfaceById(mi->canInterface());
+            if (intf) {
+                _interfaces.append(intf);
+            }
+        }
+    }
+    if (_interfaces.isEmpty()) {
+        log_error("The workspace has no interfaces that are present on this machine");
+        _exitCode = 2;
+        return false;
+    }
+    if (!recorder->isEnabled()) {
+        log_warning("Recording is disabled, frames are only counted. Use --record to write them to disk.");
+    }
+
+    int stats_s = parser.value(statsOption).toInt();
+    if (stats_s > 0) {
+        _statsTimer.setInterval(stats_s * 1000);
+    }
+    _duration_s = parser.value(durationOption).toInt();
+    return true;
+}
+
+void HeadlessCapture::handleSignal(int signum)
+{
+    (void) signum;
+    stopRequested = 1;
+}
+
+void HeadlessCapture::start()
+{
+    signal(SIGINT, handleSignal);
+    signal(SIGTERM, handleSignal);
+
+    if (!_backend.startMeasurement()) {
+        _exitCode = 1;
+        QCoreApplication::exit(_exitCode);
+        return;
+    }
+
+    _elapsed.start();
+    _lastStats_ms = 0;
+    _lastFrames = 0;
+    if (_statsTimer.interval() > 0) {
+        _statsTimer.start();
+    }
+    if (_duration_s > 0) {
+        _durationTimer.start(_duration_s * 1000);
+    }
+    _signalTimer.start();
+}
+
+void HeadlessCapture::checkSignals()
+{
+    if (stopRequested) {
+        stop();
+    }
+}
+
+void HeadlessCapture::stop()
+{
+    _signalTimer.stop();
+    _statsTimer.stop();
+    _durationTimer.stop();
+
+    // stopping drains the listener queues into the trace and finishes the recording
+    _backend.stopMeasurement();
+    printStatistics();
+    QCoreApplication::exit(_exitCode);
+}
+
+void HeadlessCapture::printStatistics()
+{
+    qint64 now_ms = _elapsed.elapsed();
+    uint64_t frames = _frames;
+    double interval_s = (now_ms - _lastStats_ms) / 1000.0;
+    double rate = (interval_s > 0) ? (frames - _lastFrames) / interval_s : 0;
+    _lastStats_ms = now_ms;
+    _lastFrames = frames;
+
+    QTextStream out(stdout);
+    out << QString("[%1 s] %2 frames, %3 frames/s, dropped %4 in listeners, %5 in recorder")
+           .arg(now_ms / 1000)
+           .arg(frames)
+           .arg(rate, 0, 'f', 0)
+           .arg(_backend.getTrace()->droppedFrames())
+           .arg(_backend.getRecorder()->droppedFrames()) << Qt::endl;
+
+    foreach (CanInterface *intf, _interfaces) {
+        intf->updateStatistics();
+        out << QString("  %1: rx %2, rx errors %3, overruns %4")
+               .arg(intf->getName())
+               .arg(intf->getNumRxFrames())
+               .arg(intf->getNumRxErrors())
+               .arg(intf->getNumRxOverruns()) << Qt::endl;
+    }
+}
+
+void HeadlessCapture::onMessagesEnqueued(int first_idx, int num_messages)
+{
+    (void) first_idx;
+    _frames += num_messages;
+}
+
+void HeadlessCapture::onLogMessage(const QDateTime dt, const log_level_t level, const QString msg)
+{
+    static const char *levels[] = { "debug", "info", "warning", "error", "critical", "fatal" };
+    QTextStream(stderr) << dt.toString("hh:mm:ss.zzz") << " " << levels[level] << ": " << msg << Qt::endl;
+}
@@ -0,0 +1,86 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#pragma once
+
+#include <stdint.h>
+#include <QObject>
+#include <QString>
+#include <QList>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <core/Log.h>
+
+class QCoreApplication;
+class Backend;
+class CanInterface;
+
+// Command line capture without any widgets: loads the measurement setup,
+// recorder settings and generator interfaces from a workspace file, runs
+// the listeners and the recorder on a QCoreApplication and prints
+// throughput and drop statistics until interrupted or the duration is over.
+class HeadlessCapture : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum {
+        default_stats_interval_s = 10,
+        default_retention_frames = 100000,
+        signal_poll_interval_ms = 100
+    };
+
+    explicit HeadlessCapture(Backend &backend, QObject *parent = 0);
+
+    static bool isRequested(int argc, char *argv[]);
+
+    bool setup(QCoreApplication &app);
+    int exitCode() const;
+
+public slots:
+    void start();
+    void stop();
+
+private slots:
+    void printStatistics();
+    void checkSignals();
+    void onMessagesEnqueued(int first_idx, int num_messages);
+    void onLogMessage(const QDateTime dt, const log_level_t level, const QString msg);
+
+private:
+    Backend &_backend;
+    int _exitCode;
+    int _duration_s;
+
+    QTimer _statsTimer;
+    QTimer _durationTimer;
+    QTimer _signalTimer;
+    QElapsedTimer _elapsed;
+    qint64 _lastStats_ms;
+
+    uint64_t _frames;
+    uint64_t _lastFrames;
+    QList<CanInterface*> _interfaces;
+
+    bool loadWorkspace(const QString &filename);
+    static void handleSignal(int signum);
+};
@@ -0,0 +1,5 @@
+HEADERS += \
+    $$PWD/HeadlessCapture.h
+
+SOURCES += \
+    $$PWD/HeadlessCapture.cpp
@@ -23,9 +23,26 @@
 #include <QApplication>
 #include <QStyleFactory>
 #include <QTranslator>
+#include <QTimer>
+#include <core/Backend.h>
+#include <headless/HeadlessCapture.h>
 
 int main(int argc, char *argv[])
 {
+    if (HeadlessCapture::isRequested(argc, argv))
+    {
+        // no QApplication, so no widgets, setup pages or log model are created
+        QCoreApplication app(argc, argv);
+        HeadlessCapture capture(Backend::instance());
+        if (!capture.setup(app))
+        {
+            return capture.exitCode();
+        }
+        QTimer::singleShot(0, &capture, SLOT(start()));
+        app.exec();
+        return capture.exitCode();
+    }
+
     QApplication a(argc, argv);
     QTranslator translator;
     QLocale locale;
@@ -30,7 +30,12 @@
 #include <QPalette>
 
 #include <core/MeasurementSetup.h>
+#include <core/MeasurementNetwork.h>
 #include <core/CanTrace.h>
+#include <tracefile/TraceRecorder.h>
+#include <tracefile/TraceReplay.h>
+#include <tracefile/TraceExporter.h>
+#include <tracefile/TraceImporter.h>
 #include <window/TraceWindow/TraceWindow.h>
 #include <window/SetupDialog/SetupDialog.h>
 #include <window/LogWindow/LogWindow.h>
@@ -39,15 +44,9 @@
 #include <window/RawTxWindow/RawTxWindow.h>
 #include <window/TxGeneratorWindow/TxGeneratorWindow.h>
 
-#include <driver/SLCANDriver/SLCANDriver.h>
-#include <driver/GrIPDriver/GrIPDriver.h>
-#include <driver/CANBlastDriver/CANBlasterDriver.h>
-
-#if defined(__linux__)
-#include <driver/SocketCanDriver/SocketCanDriver.h>
-#else
-#include <driver/CandleApiDriver/CandleApiDriver.h>
-#endif
+#include <driver/FileCanDriver/FileCanDriver.h>
+#include <driver/FileCanDriver/FileCanInterface.h>
+#include <driver/GeneratorDriver/GeneratorDriver.h>
 
 
 MainWindow::MainWindow(QWidget *parent) :
@@ -78,20 +77,15 @@ MainWindow::MainWindow(QWidget *parent) :
 
     connect(&backend(), SIGNAL(beginMeasurement()), this, SLOT(updateMeasurementActions()));
     connect(&backend(), SIGNAL(endMeasurement()), this, SLOT(updateMeasurementActions()));
+    connect(backend().getReplay(), SIGNAL(finished()), this, SLOT(replayFinished()));
     updateMeasurementActions();
 
     connect(ui->actionSave_Trace_to_file, SIGNAL(triggered(bool)), this, SLOT(saveTraceToFile()));
+    connect(ui->actionLoad_Trace_from_file, SIGNAL(triggered(bool)), this, SLOT(loadTraceFromFile()));
     connect(ui->actionAbout, SIGNAL(triggered()), this, SLOT(showAboutDialog()));
 
 
-#if defined(__linux__)
-    Backend::instance().addCanDriver(*(new SocketCanDriver(Backend::instance())));
-#else
-    Backend::instance().addCanDriver(*(new CandleApiDriver(Backend::instance())));
-#endif
-    Backend::instance().addCanDriver(*(new SLCANDriver(Backend::instance())));
-    Backend::instance().addCanDriver(*(new GrIPDriver(Backend::instance())));
-    // Backend::instance().addCanDriver(*(new CANBlasterDriver(Backend::instance())));
+    Backend::instance().addDefaultDrivers();
 
     setWorkspaceModified(false);
     newWorkspace();
@@ -112,7 +106,14 @@ void MainWindow::updateMeasurementActions()
     bool running = backend().isMeasurementRunning();
     ui->actionStart_Measurement->setEnabled(!running);
     ui->actionSetup->setEnabled(!running);
+    ui->action_AddFileInterface->setEnabled(!running);
+    ui->action_AddGeneratorInterface->setEnabled(!running);
     ui->actionStop_Measurement->setEnabled(running);
+    ui->action_Replay->setEnabled(running);
+    if (!running)
+    {
+        ui->action_Replay->setChecked(false);
+    }
 }
 
 void MainWindow::closeEvent(QCloseEvent *event)
@@ -205,20 +206,6 @@ bool MainWindow::loadWorkspaceTab(QDomElement el)
     return true;
 }
 
-bool MainWindow::loadWorkspaceSetup(QDomElement el)
-{
-    MeasurementSetup setup(&backend());
-    if (setup.loadXML(backend(), el))
-    {
-        backend().setSetup(setup);
-        return true;
-    }
-    else
-    {
-        return false;
-    }
-}
-
 void MainWindow::loadWorkspaceFromFile(QString filename)
 {
     QFile file(filename);
@@ -251,8 +238,11 @@ void MainWindow::loadWorkspaceFromFile(QString filename)
         }
     }
 
-    QDomElement setupRoot = doc.firstChild().firstChildElement("setup");
-    if (loadWorkspaceSetup(setupRoot))
+    QDomElement root = doc.firstChild().toElement();
+    bool setupLoaded = backend().loadWorkspaceXML(root);
+    ui->action_Recording->setChecked(backend().getRecorder()->isEnabled());
+
+    if (setupLoaded)
     {
         _workspaceFileName = filename;
         setWorkspaceModified(false);
@@ -297,6 +287,34 @@ bool MainWindow::saveWorkspaceToFile(QString filename)
     }
     root.appendChild(setupRoot);
 
+    QDomElement traceRoot = doc.createElement("trace");
+    backend().getTrace()->saveXML(backend(), doc, traceRoot);
+    root.appendChild(traceRoot);
+
+    QDomElement recorderRoot = doc.createElement("recorder");
+    backend().getRecorder()->saveXML(backend(), doc, recorderRoot);
+    root.appendChild(recorderRoot);
+
+    QDomElement replayRoot = doc.createElement("replay");
+    backend().getReplay()->saveXML(backend(), doc, replayRoot);
+    root.appendChild(replayRoot);
+
+    GeneratorDriver *generators = dynamic_cast<GeneratorDriver*>(backend().getDriverByName("Generator"));
+    if (generators)
+    {
+        QDomElement generatorRoot = doc.createElement("generators");
+        generators->saveXML(backend(), doc, generatorRoot);
+        root.appendChild(generatorRoot);
+    }
+
+    CanDriver *files = backend().getDriverByName("File");
+    if (files)
+    {
+        QDomElement filesRoot = doc.createElement("files");
+        files->saveXML(backend(), doc, filesRoot);
+        root.appendChild(filesRoot);
+    }
+
     QFile outFile(filename);
     if(outFile.open(QIODevice::WriteOnly|QIODevice::Text))
     {
@@ -581,36 +599,117 @@ void MainWindow::stopMeasurement()
 
 void MainWindow::saveTraceToFile()
 {
-    QString filters("Vector ASC (*.asc);;Linux candump (*.candump))");
-    QString defaultFilter("Vector ASC (*.asc)");
+    QString filters("cangaroo trace (*.cgt);;Vector ASC (*.asc);;Vector BLF (*.blf);;ASAM MDF4 (*.mf4);;Linux candump (*.candump);;PCAPNG (*.pcapng)");
+    QString defaultFilter("cangaroo trace (*.cgt)");
 
     QFileDialog fileDialog(0, "Save Trace to file", QDir::currentPath(), filters);
     fileDialog.setAcceptMode(QFileDialog::AcceptSave);
     fileDialog.setOption(QFileDialog::DontConfirmOverwrite,false);
     //fileDialog.setConfirmOverwrite(true);
     fileDialog.selectNameFilter(defaultFilter);
-    fileDialog.setDefaultSuffix("asc");
+    fileDialog.setDefaultSuffix("cgt");
     if (fileDialog.exec()) {
         QString filename = fileDialog.selectedFiles()[0];
-        QFile file(filename);
-        if (file.open(QIODevice::ReadWrite | QIODevice::Truncate))
-        {
-            if (filename.endsWith(".candump", Qt::CaseInsensitive))
-            {
-                backend().getTrace()->saveCanDump(file);
-            }
-            else
-            {
-                backend().getTrace()->saveVectorAsc(file);
-            }
 
-            file.close();
+        // export a snapshot on a worker thread, capture keeps running meanwhile
+        TraceExporter *exporter = new TraceExporter(backend(), this);
+        QProgressDialog *progress = new QProgressDialog(tr("Saving trace to %1").arg(filename), tr("Cancel"), 0, 100, this);
+        progress->setAttribute(Qt::WA_DeleteOnClose);
+        progress->setMinimumDuration(500);
+        connect(exporter, SIGNAL(progress(int)), progress, SLOT(setValue(int)));
+        connect(exporter, SIGNAL(finished(bool)), progress, SLOT(close()));
+        connect(exporter, SIGNAL(finished(bool)), this, SLOT(traceExportFinished(bool)));
+        connect(progress, SIGNAL(canceled()), exporter, SLOT(cancel()));
+
+        TraceExporter::format_t format = TraceExporter::formatForFileName(filename);
+        if ((format == TraceExporter::format_mdf4) && hasCanDbs())
+        {
+            QMessageBox::StandardButton answer = QMessageBox::question(this, tr("Save Trace"), tr("Also write the signals decoded with the loaded CAN databases?"));
+            exporter->setDecodeSignals(answer == QMessageBox::Yes);
         }
-        else
+
+        exporter->start(backend().getTrace()->snapshot(), filename, format);
+    }
+}
+
+bool MainWindow::hasCanDbs()
+{
+    MeasurementSetup &setup = backend().getSetup();
+    for (int i=0; i<setup.countNetworks(); i++)
+    {
+        if (!setup.getNetwork(i)->_canDbs.isEmpty())
         {
-            // TODO error message
+            return true;
         }
     }
+    return false;
+}
+
+void MainWindow::traceExportFinished(bool success)
+{
+    TraceExporter *exporter = qobject_cast<TraceExporter*>(sender());
+    if (!exporter)
+    {
+        return;
+    }
+
+    if (success)
+    {
+        log_info(QString("Saved trace to %1").arg(exporter->fileName()));
+    }
+    else
+    {
+        log_error(QString("Could not save trace to %1: %2").arg(exporter->fileName(), exporter->errorString()));
+    }
+    exporter->deleteLater();
+}
+
+void MainWindow::loadTraceFromFile()
+{
+    if (backend().isMeasurementRunning())
+    {
+        QMessageBox::information(this, tr("Open Trace"), tr("Please stop the measurement before opening a trace file."));
+        return;
+    }
+
+    QString filters("All traces (*.cgt *.asc *.blf *.candump *.log *.pcapng *.pcap);;cangaroo trace (*.cgt);;Vector ASC (*.asc);;Vector BLF (*.blf);;Linux candump (*.candump *.log);;PCAP/PCAPNG (*.pcapng *.pcap)");
+    QString filename = QFileDialog::getOpenFileName(this, tr("Open Trace"), QDir::currentPath(), filters);
+    if (filename.isEmpty())
+    {
+        return;
+    }
+
+    backend().clearTrace();
+
+    TraceImporter *importer = new TraceImporter(backend(), this);
+    QProgressDialog *progress = new QProgressDialog(tr("Loading trace from %1").arg(filename), tr("Cancel"), 0, 100, this);
+    progress->setAttribute(Qt::WA_DeleteOnClose);
+    progress->setMinimumDuration(500);
+    connect(importer, SIGNAL(progress(int)), progress, SLOT(setValue(int)));
+    connect(importer, SIGNAL(finished(bool)), progress, SLOT(close()));
+    connect(importer, SIGNAL(finished(bool)), this, SLOT(traceImportFinished(bool)));
+    connect(progress, SIGNAL(canceled()), importer, SLOT(cancel()));
+
+    importer->start(filename, TraceImporter::formatForFileName(filename), *backend().getTrace());
+}
+
+void MainWindow::traceImportFinished(bool success)
+{
+    TraceImporter *importer = qobject_cast<TraceImporter*>(sender());
+    if (!importer)
+    {
+        return;
+    }
+
+    if (success)
+    {
+        log_info(QString("Loaded %1 frames from %2").arg(importer->framesImported()).arg(importer->fileName()));
+    }
+    else
+    {
+        log_error(QString("Error reading trace file %1: %2").arg(importer->fileName(), importer->errorString()));
+    }
+    importer->deleteLater();
 }
 
 void MainWindow::on_action_TraceClear_triggered()
@@ -619,6 +718,309 @@ void MainWindow::on_action_TraceClear_triggered()
     backend().clearLog();
 }
 
+void MainWindow::on_action_TraceRetention_triggered()
+{
+    CanTrace *trace = backend().getTrace();
+
+    QStringList modes;
+    modes << tr("Unlimited")
+          << tr("Keep last N frames")
+          << tr("Keep last N MiB")
+          << tr("Keep last N minutes");
+
+    bool ok = false;
+    QString mode = QInputDialog::getItem(this, tr("Trace retention"), tr("Retention mode:"), modes, trace->retentionMode(), false, &ok);
+    if (!ok)
+    {
+        return;
+    }
+
+    CanTrace::retention_mode_t new_mode = (CanTrace::retention_mode_t)modes.indexOf(mode);
+    uint64_t unit = 1;
+    int default_value = 1000000;
+    if (new_mode == CanTrace::retention_bytes)
+    {
+        unit = 1024*1024;
+        default_value = 1024;
+    }
+    else if (new_mode == CanTrace::retention_time)
+    {
+        unit = 60*1000;
+        default_value = 30;
+    }
+
+    uint64_t limit = 0;
+    if (new_mode != CanTrace::retention_unlimited)
+    {
+        if (new_mode == trace->retentionMode())
+        {
+            default_value = trace->retentionLimit() / unit;
+        }
+        limit = QInputDialog::getInt(this, tr("Trace retention"), mode + ":", default_value, 1, INT_MAX, 1, &ok);
+        if (!ok)
+        {
+            return;
+        }
+    }
+
+    trace->setRetention(new_mode, limit * unit);
+    setWorkspaceModified(true);
+}
+
+void MainWindow::on_action_Recording_triggered(bool checked)
+{
+    TraceRecorder *recorder = backend().getRecorder();
+    if (!checked)
+    {
+        recorder->setEnabled(false);
+        setWorkspaceModified(true);
+        return;
+    }
+
+    // restore the action state in case the dialogs get cancelled
+    ui->action_Recording->setChecked(false);
+
+    QString filename = QFileDialog::getSaveFileName(this, tr("Record measurement to"), recorder->fileName(), "cangaroo trace (*.cgt);;Vector BLF (*.blf)");
+    if (filename.isEmpty())
+    {
+        return;
+    }
+    if (!filename.endsWith(".cgt", Qt::CaseInsensitive) && !filename.endsWith(".blf", Qt::CaseInsensitive))
+    {
+        filename += ".cgt";
+    }
+
+    QStringList modes;
+    modes << tr("Single file")
+          << tr("New file every N MiB")
+          << tr("New file every N minutes");
+
+    bool ok = false;
+    QString mode = QInputDialog::getItem(this, tr("Recording"), tr("File rotation:"), modes, recorder->rotationMode(), false, &ok);
+    if (!ok)
+    {
+        return;
+    }
+
+    TraceRecorder::rotation_mode_t new_mode = (TraceRecorder::rotation_mode_t)modes.indexOf(mode);
+    uint64_t unit = (new_mode == TraceRecorder::rotate_size) ? 1024*1024 : 60*1000;
+    uint64_t limit = 0;
+    if (new_mode != TraceRecorder::rotate_none)
+    {
+        int default_value = (new_mode == TraceRecorder::rotate_size) ? 512 : 60;
+        if (new_mode == recorder->rotationMode())
+        {
+            default_value = recorder->rotationLimit() / unit;
+        }
+        limit = QInputDialog::getInt(this, tr("Recording"), mode + ":", default_value, 1, INT_MAX, 1, &ok);
+        if (!ok)
+        {
+            return;
+        }
+    }
+
+    recorder->setFileName(filename);
+    recorder->setRotation(new_mode, limit * unit);
+    recorder->setEnabled(true);
+    ui->action_Recording->setChecked(true);
+    setWorkspaceModified(true);
+
+    if (backend().isMeasurementRunning())
+    {
+        log_info(tr("Recording starts with the next measurement"));
+    }
+}
+
+void MainWindow::on_action_Replay_triggered(bool checked)
+{
+    TraceReplay *replay = backend().getReplay();
+    if (!checked)
+    {
+        replay->stop();
+        return;
+    }
+
+    // restore the action state in case the dialogs get cancelled
+    ui->action_Replay->setChecked(false);
+
+    QStringList sources;
+    sources << tr("Current trace") << tr("Trace file...");
+    bool ok = false;
+    QString source = QInputDialog::getItem(this, tr("Replay"), tr("Replay from:"), sources, replay->fileName().isEmpty() ? 0 : 1, false, &ok);
+    if (!ok)
+    {
+        return;
+    }
+
+    if (source == sources[0])
+    {
+        replay->setSnapshot(backend().getTrace()->snapshot());
+    }
+    else
+    {
+        QString filename = QFileDialog::getOpenFileName(this, tr("Replay Trace"), replay->fileName(), "Streamable traces (*.cgt *.blf *.pcapng *.pcap)");
+        if (filename.isEmpty())
+        {
+            return;
+        }
+        replay->setFileName(filename);
+    }
+
+    QStringList targets;
+    targets << tr("Original interfaces");
+    CanInterfaceIdList interfaces = backend().getInterfaceList();
+    int current = 0;
+    foreach (CanInterfaceId id, interfaces)
+    {
+        targets << backend().getInterfaceName(id);
+        if (id == replay->targetInterface())
+        {
+            current = targets.size() - 1;
+        }
+    }
+    QString target = QInputDialog::getItem(this, tr("Replay"), tr("Send on:"), targets, current, false, &ok);
+    if (!ok)
+    {
+        return;
+    }
+    int target_idx = targets.indexOf(target);
+    replay->setTargetInterface((target_idx > 0) ? interfaces[target_idx - 1] : 0);
+
+    double speed = QInputDialog::getDouble(this, tr("Replay"), tr("Speed factor (0 = as fast as possible):"), replay->speed(), 0, 1000, 2, &ok);
+    if (!ok)
+    {
+        return;
+    }
+    replay->setSpeed(speed);
+
+    QString spec = replay->idFilterString();
+    QString error;
+    while (true)
+    {
+        spec = QInputDialog::getText(this, tr("Replay"),
+            tr("Only replay these ids, all if empty (space separated, bit 31 marks extended ids):"),
+            QLineEdit::Normal, spec, &ok);
+        if (!ok)
+        {
+            return;
+        }
+        if (replay->setIdFilterString(spec, error))
+        {
+            break;
+        }
+        QMessageBox::warning(this, tr("Replay"), tr("Invalid id filter: %1").arg(error));
+    }
+
+    spec = replay->idMappingString();
+    while (true)
+    {
+        spec = QInputDialog::getText(this, tr("Replay"),
+            tr("Send ids under a different id (space separated from=to pairs, e.g. 0x100=0x200):"),
+            QLineEdit::Normal, spec, &ok);
+        if (!ok)
+        {
+            return;
+        }
+        if (replay->setIdMappingString(spec, error))
+        {
+            break;
+        }
+        QMessageBox::warning(this, tr("Replay"), tr("Invalid id mapping: %1").arg(error));
+    }
+
+    replay->setLooping(QMessageBox::question(this, tr("Replay"), tr("Loop the replay until it is stopped?")) == QMessageBox::Yes);
+    setWorkspaceModified(true);
+
+    if (!replay->start())
+    {
+        log_error(QString("Cannot start replay: %1").arg(replay->errorString()));
+        return;
+    }
+    ui->action_Replay->setChecked(true);
+    log_info(tr("Replay started"));
+}
+
+void MainWindow::on_action_AddFileInterface_triggered()
+{
+    FileCanDriver *driver = dynamic_cast<FileCanDriver*>(backend().getDriverByName("File"));
+    if (!driver)
+    {
+        return;
+    }
+
+    QString filename = QFileDialog::getOpenFileName(this, tr("Add Capture File Interface"), "", "Streamable traces (*.cgt *.blf *.pcapng *.pcap)");
+    if (filename.isEmpty())
+    {
+        return;
+    }
+
+    FileCanInterface *intf = driver->addFile(filename);
+    if (!intf)
+    {
+        return;
+    }
+    intf->setRealTime(QMessageBox::question(this, tr("Capture File Interface"),
+        tr("Play the capture in real time?\n\nChoose No to read it as fast as possible.")) == QMessageBox::Yes);
+
+    addNetworkForInterface(intf, QFileInfo(filename).fileName());
+    log_info(QString("Added capture file interface %1").arg(intf->getName()));
+}
+
+void MainWindow::on_action_AddGeneratorInterface_triggered()
+{
+    GeneratorDriver *driver = dynamic_cast<GeneratorDriver*>(backend().getDriverByName("Generator"));
+    if (!driver)
+    {
+        return;
+    }
+
+    QString spec = GeneratorInterface::configToString(GeneratorInterface::defaultConfig());
+    GeneratorInterface::config_t config;
+    QString error;
+    while (true)
+    {
+        bool ok = false;
+        spec = QInputDialog::getText(this, tr("Traffic Generator"),
+            tr("Traffic spec (rate=0 generates as fast as possible, fd is the CAN FD share in percent,\nburst=frames/interval_ms adds bursts):"),
+            QLineEdit::Normal, spec, &ok);
+        if (!ok)
+        {
+            return;
+        }
+        if (GeneratorInterface::parseConfig(spec, config, error))
+        {
+            break;
+        }
+        QMessageBox::warning(this, tr("Traffic Generator"), tr("Invalid traffic spec: %1").arg(error));
+    }
+
+    GeneratorInterface *intf = driver->addGenerator(config);
+    addNetworkForInterface(intf, intf->getName());
+    log_info(QString("Added traffic generator %1: %2").arg(intf->getName(), GeneratorInterface::configToString(config)));
+}
+
+void MainWindow::addNetworkForInterface(CanInterface *intf, QString name)
+{
+    MeasurementNetwork *network = backend().getSetup().createNetwork();
+    network->setName(name);
+    MeasurementInterface *mi = new MeasurementInterface();
+    mi->setCanInterface(intf->getId());
+    network->addInterface(mi);
+    setWorkspaceModified(true);
+}
+
+void MainWindow::replayFinished()
+{
+    TraceReplay::statistics_t stats = backend().getReplay()->statistics();
+    log_info(QString("Replay finished: %1 frames sent, %2 skipped, %3 more than 1 ms late, jitter avg %4 us, max %5 us")
+             .arg(stats.frames_sent)
+             .arg(stats.frames_skipped)
+             .arg(stats.frames_late)
+             .arg(stats.jitter_avg_ns / 1000.0, 0, 'f', 1)
+             .arg(stats.jitter_max_ns / 1000.0, 0, 'f', 1));
+    ui->action_Replay->setChecked(false);
+}
+
 void MainWindow::on_action_WorkspaceSave_triggered()
 {
     saveWorkspace();
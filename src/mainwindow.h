@@ -68,6 +68,10 @@ public slots:
     void startMeasurement();
     void stopMeasurement();
     void saveTraceToFile();
+    void loadTraceFromFile();
+    void traceExportFinished(bool success);
+    void traceImportFinished(bool success);
+    void replayFinished();
 
     void updateMeasurementActions();
 
@@ -77,6 +81,11 @@ private slots:
     void on_action_WorkspaceSave_triggered();
     void on_action_WorkspaceSaveAs_triggered();
     void on_action_TraceClear_triggered();
+    void on_action_TraceRetention_triggered();
+    void on_action_Recording_triggered(bool checked);
+    void on_action_Replay_triggered(bool checked);
+    void on_action_AddFileInterface_triggered();
+    void on_action_AddGeneratorInterface_triggered();
     void on_actionCan_Status_View_triggered();
     void on_actionGenerator_View_triggered();
 
@@ -99,7 +108,6 @@ private:
 
     void clearWorkspace();
     bool loadWorkspaceTab(QDomElement el);
-    bool loadWorkspaceSetup(QDomElement el);
     void loadWorkspaceFromFile(QString filename);
     bool saveWorkspaceToFile(QString filename);
 
@@ -111,4 +119,7 @@ private:
     void setWorkspaceModified(bool modified);
     int askSaveBecauseWorkspaceModified();
 
+    bool hasCanDbs();
+    void addNetworkForInterface(CanInterface *intf, QString name);
+
 };
@@ -38,6 +38,7 @@ RESOURCES = cangaroo.qrc
 include($$PWD/core/core.pri)
 include($$PWD/driver/driver.pri)
 include($$PWD/parser/dbc/dbc.pri)
+include($$PWD/tracefile/tracefile.pri)
 include($$PWD/window/TraceWindow/TraceWindow.pri)
 include($$PWD/window/SetupDialog/SetupDialog.pri)
 include($$PWD/window/LogWindow/LogWindow.pri)
@@ -45,6 +46,7 @@ include($$PWD/window/GraphWindow/GraphWindow.pri)
 include($$PWD/window/CanStatusWindow/CanStatusWindow.pri)
 include($$PWD/window/RawTxWindow/RawTxWindow.pri)
 include($$PWD/window/TxGeneratorWindow/TxGeneratorWindow.pri)
+include($$PWD/headless/headless.pri)
 
 
 unix:PKGCONFIG += libnl-3.0
@@ -54,7 +56,12 @@ unix:include($$PWD/driver/SocketCanDriver/SocketCanDriver.pri)
 include($$PWD/driver/CANBlastDriver/CANBlastDriver.pri)
 include($$PWD/driver/SLCANDriver/SLCANDriver.pri)
 include($$PWD/driver/GrIPDriver/GrIPDriver.pri)
+include($$PWD/driver/FileCanDriver/FileCanDriver.pri)
+include($$PWD/driver/GeneratorDriver/GeneratorDriver.pri)
 
 win32:include($$PWD/driver/CandleApiDriver/CandleApiDriver.pri)
 
+# registers the drivers above, so it is not part of core.pri
+SOURCES += $$PWD/core/BackendDrivers.cpp
+
 DISTFILES +=
@@ -0,0 +1,605 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "BlfTraceFile.h"
+
+#include <string.h>
+#include <QDateTime>
+#include <QtEndian>
+#include <core/Backend.h>
+#include <core/CanMessage.h>
+
+enum {
+    file_header_size = 144,
+    file_header_used_size = 72,
+    application_id = 5,
+
+    obj_header_base_size = 16,
+    obj_header_v1_size = 16,
+    container_header_size = 16,
+
+    obj_log_container = 10,
+    obj_can_message = 1,
+    obj_can_message2 = 86,
+    obj_can_fd_message = 100,
+    obj_can_fd_message_64 = 101,
+
+    compression_none = 0,
+    compression_zlib = 2,
+
+    time_ten_mics = 0x00000001,
+    time_one_nans = 0x00000002,
+
+    can_msg_dir_tx = 0x01,
+    can_msg_remote = 0x80,
+    can_msg_ext = 0x80000000,
+
+    id_flag_extended = 0x80000000,
+    id_flag_rtr = 0x40000000,
+    id_mask_extended = 0x1FFFFFFF,
+
+    canfd_edl = 0x01,
+    canfd_brs = 0x02,
+
+    canfd64_remote = 0x0010,
+    canfd64_edl = 0x1000,
+    canfd64_brs = 0x2000,
+
+    can_message_size = 16,
+    can_fd_message_size = 84,
+    can_fd_message_64_size = 40,
+
+    max_object_size = 1024*1024
+};
+
+static void putSystemTime(QByteArray &buf, int64_t ms)
+{
+    if (ms < 0) {
+        buf.append(16, (char)0);
+        return;
+    }
+
+    // SYSTEMTIME in local time, day of week counted from sunday
+    QDateTime dt = QDateTime::fromMSecsSinceEpoch(ms);
+    TraceFile::putU16(buf, dt.date().year());
+    TraceFile::putU16(buf, dt.date().month());
+    TraceFile::putU16(buf, dt.date().dayOfWeek() % 7);
+    TraceFile::putU16(buf, dt.date().day());
+    TraceFile::putU16(buf, dt.time().hour());
+    TraceFile::putU16(buf, dt.time().minute());
+    TraceFile::putU16(buf, dt.time().second());
+    TraceFile::putU16(buf, dt.time().msec());
+}
+
+static int64_t getSystemTime(const char *p)
+{
+    QDate date(TraceFile::getU16(p), TraceFile::getU16(p+2), TraceFile::getU16(p+6));
+    QTime time(TraceFile::getU16(p+8), TraceFile::getU16(p+10), TraceFile::getU16(p+12), TraceFile::getU16(p+14));
+    QDateTime dt(date, time);
+    return dt.isValid() ? dt.toMSecsSinceEpoch() : 0;
+}
+
+static void putObjectHeader(QByteArray &buf, uint32_t type, uint32_t obj_size, uint64_t timestamp_ns)
+{
+    buf.append("LOBJ", 4);
+    TraceFile::putU16(buf, obj_header_base_size + obj_header_v1_size);
+    TraceFile::putU16(buf, 1);
+    TraceFile::putU32(buf, obj_size);
+    TraceFile::putU32(buf, type);
+
+    TraceFile::putU32(buf, time_one_nans);
+    TraceFile::putU16(buf, 0); // client index
+    TraceFile::putU16(buf, 0); // object version
+    TraceFile::putU64(buf, timestamp_ns);
+}
+
+static const char *findObject(const char *p, const char *end)
+{
+    while (end - p >= 4) {
+        p = (const char *)memchr(p, 'L', end - p - 3);
+        if (!p) {
+            break;
+        }
+        if (memcmp(p, "LOBJ", 4) == 0) {
+            return p;
+        }
+        p++;
+    }
+    return 0;
+}
+
+
+BlfTraceWriter::BlfTraceWriter(Backend &backend)
+  : _backend(backend),
+    _hasStartTime(false),
+    _startTime_ms(-1),
+    _stopTime_ms(-1),
+    _uncompressedSize(file_header_size),
+    _objectCount(0)
+{
+}
+
+BlfTraceWriter::~BlfTraceWriter()
+{
+    close();
+}
+
+bool BlfTraceWriter::open(const QString &filename)
+{
+    close();
+
+    _file.setFileName(filename);
+    if (!_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        _error = _file.errorString();
+        return false;
+    }
+
+    _channels.clear();
+    foreach (CanInterfaceId id, _backend.getInterfaceList()) {
+        _channels.insert(id, _channels.size() + 1);
+    }
+
+    _objects.clear();
+    _objects.reserve(container_size + 1024);
+    _hasStartTime = false;
+    _startTime_ms = -1;
+    _stopTime_ms = -1;
+    _uncompressedSize = file_header_size;
+    _objectCount = 0;
+
+    return writeFileHeader();
+}
+
+bool BlfTraceWriter::isOpen() const
+{
+    return _file.isOpen();
+}
+
+bool BlfTraceWriter::close()
+{
+    if (!_file.isOpen()) {
+        return true;
+    }
+    bool ok = writeContainer() && writeFileHeader();
+    _file.close();
+    return ok;
+}
+
+bool BlfTraceWriter::addMessage(const CanMessage &msg)
+{
+    int64_t ts_ns = msg.getTimestampNsecs();
+    if (!_hasStartTime) {
+        _startTime_ms = ts_ns / 1000000;
+        _hasStartTime = true;
+    }
+    _stopTime_ms = ts_ns / 1000000;
+
+    int64_t rel_ns = ts_ns - _startTime_ms * 1000000;
+    if (rel_ns < 0) {
+        rel_ns = 0;
+    }
+
+    uint32_t id = msg.getId();
+    if (msg.isExtended()) {
+        id |= can_msg_ext;
+    }
+    uint8_t len = msg.getLength();
+
+    if (!msg.isFD() && (len <= 8)) {
+        putObjectHeader(_objects, obj_can_message, obj_header_base_size + obj_header_v1_size + can_message_size, rel_ns);
+        TraceFile::putU16(_objects, channel(msg.getInterfaceId()));
+        TraceFile::putU8(_objects, (msg.isRX() ? 0 : can_msg_dir_tx) | (msg.isRTR() ? can_msg_remote : 0));
+        TraceFile::putU8(_objects, len);
+        TraceFile::putU32(_objects, id);
+        for (int i=0; i<8; i++) {
+            _objects.append((i < len) ? (char)msg.getByte(i) : (char)0);
+        }
+    } else {
+        // payload padded to 4 bytes, so the next object stays aligned
+        int padded_len = (len + 3) & ~3;
+        uint32_t flags = canfd64_edl | (msg.isBRS() ? canfd64_brs : 0);
+        putObjectHeader(_objects, obj_can_fd_message_64, obj_header_base_size + obj_header_v1_size + can_fd_message_64_size + padded_len, rel_ns);
+        TraceFile::putU8(_objects, channel(msg.getInterfaceId()));
+        TraceFile::putU8(_objects, TraceFile::lengthToDlc(len));
+        TraceFile::putU8(_objects, len); // valid payload length
+        TraceFile::putU8(_objects, 0); // tx count
+        TraceFile::putU32(_objects, id);
+        TraceFile::putU32(_objects, 0); // frame length in ns
+        TraceFile::putU32(_objects, flags);
+        _objects.append(16, (char)0); // bit timing configuration, brs and crc delimiter offsets
+        TraceFile::putU16(_objects, 0); // bit count
+        TraceFile::putU8(_objects, msg.isRX() ? 0 : 1);
+        TraceFile::putU8(_objects, 0); // extended data offset
+        TraceFile::putU32(_objects, 0); // crc
+        for (int i=0; i<len; i++) {
+            _objects.append((char)msg.getByte(i));
+        }
+        _objects.append(padded_len - len, (char)0);
+    }
+    _objectCount++;
+
+    if (_objects.size() >= container_size) {
+        return writeContainer();
+    }
+    return true;
+}
+
+bool BlfTraceWriter::sync()
+{
+    // the header is rewritten as well, so the file is consistent up to here
+    return writeContainer() && writeFileHeader() && TraceFile::syncFile(_file);
+}
+
+uint64_t BlfTraceWriter::bytesWritten() const
+{
+    return _file.pos();
+}
+
+QString BlfTraceWriter::errorString() const
+{
+    return _error;
+}
+
+int BlfTraceWriter::channel(CanInterfaceId id)
+{
+    int ch = _channels.value(id, 0);
+    if (ch == 0) {
+        // interface that was not known when the file was opened
+        ch = _channels.size() + 1;
+        _channels.insert(id, ch);
+    }
+    return ch;
+}
+
+bool BlfTraceWriter::writeContainer()
+{
+    if (_objects.isEmpty()) {
+        return true;
+    }
+
+    // qCompress prepends the uncompressed size, BLF only wants the zlib stream
+    QByteArray compressed = qCompress(_objects, 1).mid(4);
+    uint32_t obj_size = obj_header_base_size + container_header_size + compressed.size();
+
+    QByteArray buf;
+    buf.reserve(obj_size + 4);
+    buf.append("LOBJ", 4);
+    TraceFile::putU16(buf, obj_header_base_size);
+    TraceFile::putU16(buf, 1);
+    TraceFile::putU32(buf, obj_size);
+    TraceFile::putU32(buf, obj_log_container);
+    TraceFile::putU16(buf, compression_zlib);
+    buf.append(6, (char)0);
+    TraceFile::putU32(buf, _objects.size());
+    buf.append(4, (char)0);
+    buf.append(compressed);
+    buf.append(obj_size % 4, (char)0);
+
+    if (_file.write(buf) != buf.size()) {
+        _error = _file.errorString();
+        return false;
+    }
+
+    _uncompressedSize += obj_header_base_size + container_header_size + _objects.size();
+    _objects.clear();
+    return true;
+}
+
+bool BlfTraceWriter::writeFileHeader()
+{
+    qint64 pos = _file.pos();
+
+    QByteArray header;
+    header.reserve(file_header_size);
+    header.append("LOGG", 4);
+    TraceFile::putU32(header, file_header_size);
+    TraceFile::putU8(header, application_id);
+    TraceFile::putU8(header, 0); // application version
+    TraceFile::putU8(header, 0);
+    TraceFile::putU8(header, 0);
+    TraceFile::putU8(header, 2); // binlog version 2.6.8.1
+    TraceFile::putU8(header, 6);
+    TraceFile::putU8(header, 8);
+    TraceFile::putU8(header, 1);
+    TraceFile::putU64(header, (pos > file_header_size) ? pos : file_header_size);
+    TraceFile::putU64(header, _uncompressedSize);
+    TraceFile::putU32(header, _objectCount);
+    TraceFile::putU32(header, 0);
+    putSystemTime(header, _startTime_ms);
+    putSystemTime(header, _stopTime_ms);
+    header.append(file_header_size - header.size(), (char)0);
+
+    if (!_file.seek(0) || (_file.write(header) != header.size()) || !_file.seek((pos > file_header_size) ? pos : file_header_size)) {
+        _error = _file.errorString();
+        return false;
+    }
+    return true;
+}
+
+
+BlfTraceReader::BlfTraceReader(Backend &backend)
+  : _begin(0),
+    _pos(0),
+    _end(0),
+    _failed(false),
+    _startTime_ms(0),
+    _dataPos(0),
+    _interfaceMap(backend)
+{
+}
+
+BlfTraceReader::~BlfTraceReader()
+{
+    close();
+}
+
+bool BlfTraceReader::open(const QString &filename)
+{
+    close();
+
+    _file.setFileName(filename);
+    if (!_file.open(QIODevice::ReadOnly)) {
+        _error = _file.errorString();
+        return false;
+    }
+
+    // map the file; containers are only read and inflated as they are consumed
+    qint64 size = _file.size();
+    _begin = (size > 0) ? (const char *)_file.map(0, size) : 0;
+    if (!_begin) {
+        _buffer = _file.readAll();
+        _begin = _buffer.constData();
+        size = _buffer.size();
+    }
+    _end = _begin + size;
+
+    if ((size < file_header_used_size) || (memcmp(_begin, "LOGG", 4) != 0)) {
+        _error = QString("not a BLF file");
+        close();
+        return false;
+    }
+
+    uint32_t header_size = TraceFile::getU32(_begin + 4);
+    if ((header_size < file_header_used_size) || (header_size > size)) {
+        _error = QString("corrupt file header");
+        close();
+        return false;
+    }
+
+    _startTime_ms = getSystemTime(_begin + 40);
+    _pos = _begin + header_size;
+    return true;
+}
+
+void BlfTraceReader::close()
+{
+    _file.close();
+    _buffer.clear();
+    _data.clear();
+    _dataPos = 0;
+    _begin = _pos = _end = 0;
+    _failed = false;
+}
+
+int BlfTraceReader::readMessages(QList<CanMessage> &msgs, int max_count)
+{
+    int count = 0;
+    while ((count < max_count) && !atEnd()) {
+        int avail = _data.size() - _dataPos;
+        const char *obj = _data.constData() + _dataPos;
+
+        if ((avail >= obj_header_base_size) && (memcmp(obj, "LOBJ", 4) != 0)) {
+            // lost sync inside the object stream, skip to the next object
+            const char *next = findObject(obj + 1, obj + avail);
+            _dataPos = next ? (next - _data.constData()) : (_data.size() - 3);
+            continue;
+        }
+
+        uint32_t header_size = (avail >= obj_header_base_size) ? TraceFile::getU16(obj + 4) : 0;
+        uint32_t obj_size = (avail >= obj_header_base_size) ? TraceFile::getU32(obj + 8) : 0;
+        if ((avail >= obj_header_base_size) && ((header_size < obj_header_base_size) || (obj_size < header_size) || (obj_size > max_object_size))) {
+            _dataPos += 4;
+            continue;
+        }
+
+        if ((avail < obj_header_base_size) || ((uint32_t)avail < obj_size)) {
+            // objects may span log containers
+            _data.remove(0, _dataPos);
+            _dataPos = 0;
+            if (!readContainer()) {
+                _dataPos = _data.size(); // drop a truncated object at the end of the file
+            }
+            continue;
+        }
+
+        uint32_t type = TraceFile::getU32(obj + 12);
+        CanMessage msg;
+        if (readObject(obj, header_size, obj_size, type, msg)) {
+            msgs.append(msg);
+            count++;
+        }
+
+        _dataPos += obj_size;
+        if (type != obj_can_fd_message_64) {
+            _dataPos += obj_size % 4;
+        }
+        if (_dataPos > _data.size()) {
+            _dataPos = _data.size();
+        }
+    }
+
+    return _failed ? -1 : count;
+}
+
+bool BlfTraceReader::atEnd() const
+{
+    return _failed || ((_pos >= _end) && (_dataPos >= _data.size()));
+}
+
+int BlfTraceReader::percentDone() const
+{
+    return (_end > _begin) ? (int)((int64_t)(_pos - _begin) * 100 / (_end - _begin)) : 100;
+}
+
+QString BlfTraceReader::errorString() const
+{
+    return _error;
+}
+
+bool BlfTraceReader::readContainer()
+{
+    while (_end - _pos >= obj_header_base_size) {
+        if (memcmp(_pos, "LOBJ", 4) != 0) {
+            const char *next = findObject(_pos + 1, _end);
+            _pos = next ? next : _end;
+            continue;
+        }
+
+        uint32_t obj_size = TraceFile::getU32(_pos + 8);
+        uint32_t type = TraceFile::getU32(_pos + 12);
+        if (obj_size < obj_header_base_size) {
+            _pos += 4;
+            continue;
+        }
+        if ((uint64_t)obj_size > (uint64_t)(_end - _pos)) {
+            break; // truncated file
+        }
+
+        const char *obj = _pos;
+        _pos += obj_size + (obj_size % 4);
+        if (_pos > _end) {
+            _pos = _end;
+        }
+
+        if (type != obj_log_container) {
+            // uncompressed object outside of a container
+            _data.append(obj, qMin<int64_t>(obj_size + (obj_size % 4), _end - obj));
+            return true;
+        }
+        if (obj_size < obj_header_base_size + container_header_size) {
+            continue;
+        }
+
+        uint16_t method = TraceFile::getU16(obj + obj_header_base_size);
+        uint32_t uncompressed_size = TraceFile::getU32(obj + obj_header_base_size + 8);
+        const char *payload = obj + obj_header_base_size + container_header_size;
+        int payload_size = obj_size - obj_header_base_size - container_header_size;
+
+        if (method == compression_none) {
+            _data.append(payload, payload_size);
+            return true;
+        } else if (method == compression_zlib) {
+            QByteArray compressed;
+            compressed.reserve(payload_size + 4);
+            uint32_t size_be = qToBigEndian((quint32)uncompressed_size);
+            compressed.append((const char *)&size_be, 4);
+            compressed.append(payload, payload_size);
+            QByteArray data = qUncompress(compressed);
+            if ((uint32_t)data.size() == uncompressed_size) {
+                _data.append(data);
+                return true;
+            }
+        }
+        // unknown compression or corrupt container: skip it
+    }
+
+    _pos = _end;
+    return false;
+}
+
+bool BlfTraceReader::readObject(const char *obj, uint32_t header_size, uint32_t obj_size, uint32_t type, CanMessage &msg)
+{
+    if (header_size < obj_header_base_size + obj_header_v1_size) {
+        return false;
+    }
+
+    // v1 and v2 object headers both have flags at 16 and the timestamp at 24
+    uint32_t flags = TraceFile::getU32(obj + 16);
+    uint64_t ts = TraceFile::getU64(obj + 24);
+    int64_t ts_ns = (flags & time_ten_mics) ? (int64_t)ts * 10000 : (int64_t)ts;
+
+    const char *p = obj + header_size;
+    uint32_t size = obj_size - header_size;
+    uint16_t channel;
+    uint32_t id;
+    uint8_t len;
+    bool rtr;
+    const char *data;
+
+    if ((type == obj_can_message) || (type == obj_can_message2)) {
+        if (size < can_message_size) {
+            return false;
+        }
+        channel = TraceFile::getU16(p);
+        uint8_t msg_flags = p[2];
+        len = qMin<uint8_t>(p[3], 8);
+        id = TraceFile::getU32(p + 4);
+        data = p + 8;
+        rtr = (msg_flags & can_msg_remote) != 0;
+        msg.setRX(!(msg_flags & can_msg_dir_tx));
+    } else if (type == obj_can_fd_message) {
+        if (size < can_fd_message_size) {
+            return false;
+        }
+        channel = TraceFile::getU16(p);
+        uint8_t msg_flags = p[2];
+        id = TraceFile::getU32(p + 4);
+        uint8_t fd_flags = p[13];
+        len = qMin<uint8_t>(p[14], 64);
+        data = p + 20;
+        msg.setFD(fd_flags & canfd_edl);
+        msg.setBRS(fd_flags & canfd_brs);
+        rtr = !(fd_flags & canfd_edl) && (msg_flags & can_msg_remote);
+        msg.setRX(!(msg_flags & can_msg_dir_tx));
+    } else if (type == obj_can_fd_message_64) {
+        if (size < can_fd_message_64_size) {
+            return false;
+        }
+        channel = (uint8_t)p[0];
+        len = qMin<uint32_t>((uint8_t)p[2], qMin<uint32_t>(size - can_fd_message_64_size, 64));
+        id = TraceFile::getU32(p + 4);
+        uint32_t fd_flags = TraceFile::getU32(p + 12);
+        data = p + can_fd_message_64_size;
+        msg.setFD(fd_flags & canfd64_edl);
+        msg.setBRS(fd_flags & canfd64_brs);
+        rtr = !(fd_flags & canfd64_edl) && (fd_flags & canfd64_remote);
+        msg.setRX(p[34] == 0);
+    } else {
+        return false;
+    }
+
+    uint32_t raw_id = id & id_mask_extended;
+    if (id & can_msg_ext) {
+        raw_id |= id_flag_extended;
+    }
+    if (rtr) {
+        raw_id |= id_flag_rtr;
+    }
+    msg.setRawId(raw_id);
+    msg.setInterfaceId(_interfaceMap.lookupChannel(channel));
+    msg.setLength(len);
+    for (int i=0; i<len; i++) {
+        msg.setByte(i, data[i]);
+    }
+
+    msg.setTimestampNsecs(_startTime_ms * timestamp_nsecs_per_msec + ts_ns);
+    return true;
+}
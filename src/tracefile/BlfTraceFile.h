@@ -0,0 +1,112 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <QFile>
+#include <QHash>
+#include <QList>
+#include <QByteArray>
+#include <driver/CanDriver.h>
+#include "TraceFile.h"
+
+class Backend;
+class CanMessage;
+
+// Vector binary logging format (*.blf), as written by CANalyzer and CANoe.
+//
+// A 144 byte file header is followed by log container objects, each holding
+// a zlib compressed run of CAN / CAN FD message objects. Object timestamps
+// are relative to the measurement start time stored in the file header.
+// Channels are numbered from 1, in the order of the backend interface list.
+class BlfTraceWriter : public TraceFileWriter
+{
+public:
+    enum {
+        container_size = 128*1024
+    };
+
+    BlfTraceWriter(Backend &backend);
+    virtual ~BlfTraceWriter();
+
+    virtual bool open(const QString &filename);
+    virtual bool isOpen() const;
+    virtual bool close();
+
+    virtual bool addMessage(const CanMessage &msg);
+    virtual bool sync();
+
+    virtual uint64_t bytesWritten() const;
+    virtual QString errorString() const;
+
+private:
+    Backend &_backend;
+    QFile _file;
+    QByteArray _objects;
+    QString _error;
+    QHash<CanInterfaceId, int> _channels;
+
+    bool _hasStartTime;
+    int64_t _startTime_ms;
+    int64_t _stopTime_ms;
+    uint64_t _uncompressedSize;
+    uint32_t _objectCount;
+
+    int channel(CanInterfaceId id);
+    bool writeContainer();
+    bool writeFileHeader();
+};
+
+class BlfTraceReader
+{
+public:
+    BlfTraceReader(Backend &backend);
+    ~BlfTraceReader();
+
+    bool open(const QString &filename);
+    void close();
+
+    int readMessages(QList<CanMessage> &msgs, int max_count);
+    bool atEnd() const;
+    int percentDone() const;
+
+    QString errorString() const;
+
+private:
+    QFile _file;
+    QByteArray _buffer;
+    const char *_begin;
+    const char *_pos;
+    const char *_end;
+    bool _failed;
+    int64_t _startTime_ms;
+
+    // uncompressed contents of the current log container(s)
+    QByteArray _data;
+    int _dataPos;
+
+    TraceFileInterfaceMap _interfaceMap;
+    QString _error;
+
+    bool readContainer();
+    bool readObject(const char *obj, uint32_t header_size, uint32_t obj_size, uint32_t type, CanMessage &msg);
+};
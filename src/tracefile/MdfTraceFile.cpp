@@ -0,0 +1,568 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "MdfTraceFile.h"
+
+#include <string.h>
+#include <QDateTime>
+#include <core/Backend.h>
+#include <core/CanMessage.h>
+#include <core/CanDbMessage.h>
+#include <core/CanDbSignal.h>
+
+enum {
+    id_block_size = 64,
+    hd_block_size = 104,
+    block_header_size = 24,
+    mdf_version = 410,
+
+    cn_type_fixed = 0,
+    cn_type_master = 2,
+    cn_sync_none = 0,
+    cn_sync_time = 1,
+    cn_data_uint_le = 0,
+    cn_data_float_le = 4,
+    cn_data_byte_array = 10,
+    cn_flag_inval_bit_valid = 0x0002,
+
+    cg_flag_bus_event = 0x0002,
+    cg_flag_plain_bus_event = 0x0004,
+
+    si_type_bus = 2,
+    si_bus_type_can = 2,
+
+    bus_record_header_size = 16,
+    bus_data_bytes = 64,
+
+    flag_dir_tx = 0x01,
+    flag_edl = 0x02,
+    flag_brs = 0x04
+};
+
+// members of the CAN_DataFrame / CAN_RemoteFrame structure channel.
+// Record layout: f64 time, u8 channel, u32 id (bit 31: IDE), u8 dlc,
+// u8 data length, u8 flags (see above), payload.
+typedef struct {
+    const char *name;
+    uint8_t data_type;
+    uint32_t byte_offset;
+    uint8_t bit_offset;
+    uint32_t bit_count;
+    bool data_frame_only;
+} bus_member_t;
+
+static const bus_member_t bus_members[] = {
+    { "BusChannel", cn_data_uint_le,     8, 0,  8, false },
+    { "ID",         cn_data_uint_le,     9, 0, 29, false },
+    { "IDE",        cn_data_uint_le,    12, 7,  1, false },
+    { "DLC",        cn_data_uint_le,    13, 0,  4, false },
+    { "DataLength", cn_data_uint_le,    14, 0,  7, false },
+    { "DataBytes",  cn_data_byte_array, 16, 0, bus_data_bytes*8, true },
+    { "Dir",        cn_data_uint_le,    15, 0,  1, false },
+    { "EDL",        cn_data_uint_le,    15, 1,  1, true },
+    { "BRS",        cn_data_uint_le,    15, 2,  1, true },
+};
+
+static inline void putDouble(QByteArray &buf, double value)
+{
+    uint64_t v;
+    memcpy(&v, &value, sizeof(v));
+    TraceFile::putU64(buf, v);
+}
+
+
+MdfTraceWriter::MdfTraceWriter(Backend &backend)
+  : _backend(backend),
+    _failed(false),
+    _dataFrames(0),
+    _remoteFrames(0),
+    _hasStartTime(false),
+    _startTime_ns(0)
+{
+}
+
+MdfTraceWriter::~MdfTraceWriter()
+{
+    close();
+}
+
+void MdfTraceWriter::setCanDbs(const QList<pCanDb> &dbs)
+{
+    // keep references, the databases must outlive the writer
+    _canDbs = dbs;
+}
+
+bool MdfTraceWriter::open(const QString &filename)
+{
+    close();
+
+    _file.setFileName(filename);
+    if (!_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        _error = _file.errorString();
+        return false;
+    }
+
+    _failed = false;
+    _hasStartTime = false;
+    _startTime_ns = 0;
+
+    _channels.clear();
+    foreach (CanInterfaceId id, _backend.getInterfaceList()) {
+        _channels.insert(id, _channels.size() + 1);
+    }
+
+    // same lookup order as MeasurementSetup::findDbMessage()
+    _dbMessages.clear();
+    foreach (pCanDb db, _canDbs) {
+        CanDbMessageList messages = db->getMessageList();
+        for (CanDbMessageList::const_iterator it = messages.constBegin(); it != messages.constEnd(); ++it) {
+            if (!_dbMessages.contains(it.key())) {
+                _dbMessages.insert(it.key(), it.value());
+            }
+        }
+    }
+
+    _dataFrames = createBusGroup("CAN_DataFrame", true);
+    _remoteFrames = createBusGroup("CAN_RemoteFrame", false);
+
+    // the header block is filled in on close, data blocks follow it
+    writeIdBlock(false);
+    _file.write(QByteArray(hd_block_size, (char)0));
+    return !_failed;
+}
+
+bool MdfTraceWriter::isOpen() const
+{
+    return _file.isOpen();
+}
+
+bool MdfTraceWriter::close()
+{
+    if (!_file.isOpen()) {
+        return true;
+    }
+
+    foreach (group_t *group, _groups) {
+        writeDataBlock(group);
+    }
+
+    uint64_t first_dg = 0;
+    for (int i=_groups.size()-1; i>=0; i--) {
+        if (_groups[i]->cycle_count > 0) {
+            first_dg = writeGroup(_groups[i], first_dg);
+        }
+    }
+
+    QString comment = QString("<FHcomment><TX>CAN trace</TX><tool_id>cangaroo</tool_id><tool_vendor>cangaroo</tool_vendor><tool_version>1</tool_version></FHcomment>");
+    QVector<uint64_t> md_links;
+    QByteArray md = comment.toUtf8();
+    md.append((char)0);
+    uint64_t fh_comment = writeBlock("##MD", md_links, md);
+
+    QVector<uint64_t> fh_links;
+    fh_links << 0 << fh_comment;
+    QByteArray fh;
+    TraceFile::putU64(fh, QDateTime::currentMSecsSinceEpoch() * 1000000);
+    TraceFile::putU16(fh, 0);
+    TraceFile::putU16(fh, 0);
+    fh.append(4, (char)0);
+    uint64_t first_fh = writeBlock("##FH", fh_links, fh);
+
+    writeHeaderBlock(first_dg, first_fh);
+    writeIdBlock(true);
+    _file.close();
+
+    qDeleteAll(_groups);
+    _groups.clear();
+    _signalGroups.clear();
+    _dataFrames = _remoteFrames = 0;
+
+    return !_failed;
+}
+
+bool MdfTraceWriter::addMessage(const CanMessage &msg)
+{
+    if (msg.isErrorFrame()) {
+        return true;
+    }
+
+    int64_t ts_ns = msg.getTimestampNsecs();
+    if (!_hasStartTime) {
+        _startTime_ns = ts_ns;
+        _hasStartTime = true;
+    }
+    double t = (double)(ts_ns - _startTime_ns) / 1e9;
+
+    uint8_t len = msg.getLength();
+    uint32_t id = msg.getId() | (msg.isExtended() ? 0x80000000 : 0);
+    uint8_t flags = (msg.isRX() ? 0 : flag_dir_tx);
+    if (msg.isFD()) {
+        flags |= flag_edl | (msg.isBRS() ? flag_brs : 0);
+    }
+
+    group_t *group = msg.isRTR() ? _remoteFrames : _dataFrames;
+    QByteArray &buf = group->buf;
+    putDouble(buf, t);
+    TraceFile::putU8(buf, channel(msg.getInterfaceId()));
+    TraceFile::putU32(buf, id);
+    TraceFile::putU8(buf, msg.isFD() ? TraceFile::lengthToDlc(len) : len);
+    TraceFile::putU8(buf, msg.isRTR() ? 0 : len);
+    TraceFile::putU8(buf, flags);
+    if (!msg.isRTR()) {
+        for (int i=0; i<len; i++) {
+            buf.append((char)msg.getByte(i));
+        }
+        buf.append(bus_data_bytes - len, (char)0);
+    }
+    group->cycle_count++;
+    if (buf.size() >= data_block_size) {
+        writeDataBlock(group);
+    }
+
+    CanDbMessage *dbmsg = _dbMessages.value(msg.getRawId(), 0);
+    group = dbmsg ? signalGroup(dbmsg) : 0;
+    if (group) {
+        QByteArray inval(group->inval_bytes, (char)0);
+        putDouble(group->buf, t);
+        for (int i=0; i<group->dbSignals.size(); i++) {
+            CanDbSignal *signal = group->dbSignals[i];
+            if (signal->isPresentInMessage(msg)) {
+                putDouble(group->buf, signal->extractPhysicalFromMessage(msg));
+            } else {
+                putDouble(group->buf, 0);
+                inval[i/8] = inval[i/8] | (1 << (i%8));
+            }
+        }
+        group->buf.append(inval);
+        group->cycle_count++;
+        if (group->buf.size() >= data_block_size) {
+            writeDataBlock(group);
+        }
+    }
+
+    return !_failed;
+}
+
+bool MdfTraceWriter::sync()
+{
+    // the block tree is only written on close, so just push out the data
+    foreach (group_t *group, _groups) {
+        writeDataBlock(group);
+    }
+    return !_failed && TraceFile::syncFile(_file);
+}
+
+uint64_t MdfTraceWriter::bytesWritten() const
+{
+    return _file.pos();
+}
+
+QString MdfTraceWriter::errorString() const
+{
+    return _error;
+}
+
+MdfTraceWriter::group_t *MdfTraceWriter::createBusGroup(const QString &name, bool withData)
+{
+    group_t *group = new group_t();
+    group->name = name;
+    group->isBusEvent = true;
+    group->record_size = bus_record_header_size + (withData ? bus_data_bytes : 0);
+    group->inval_bytes = 0;
+    group->cycle_count = 0;
+    group->data_size = 0;
+
+    for (size_t i=0; i<sizeof(bus_members)/sizeof(bus_members[0]); i++) {
+        const bus_member_t &member = bus_members[i];
+        if (member.data_frame_only && !withData) {
+            continue;
+        }
+        channel_t cn;
+        cn.name = name + "." + member.name;
+        cn.type = cn_type_fixed;
+        cn.sync_type = cn_sync_none;
+        cn.data_type = member.data_type;
+        cn.bit_offset = member.bit_offset;
+        cn.byte_offset = member.byte_offset;
+        cn.bit_count = member.bit_count;
+        cn.flags = 0;
+        cn.inval_bit_pos = 0;
+        group->channels.append(cn);
+    }
+
+    _groups.append(group);
+    return group;
+}
+
+MdfTraceWriter::group_t *MdfTraceWriter::signalGroup(CanDbMessage *dbmsg)
+{
+    QHash<CanDbMessage*, group_t*>::const_iterator it = _signalGroups.constFind(dbmsg);
+    if (it != _signalGroups.constEnd()) {
+        return it.value();
+    }
+
+    CanDbSignalList dbSignals = dbmsg->getSignals();
+    if (dbSignals.isEmpty()) {
+        _signalGroups.insert(dbmsg, 0);
+        return 0;
+    }
+
+    group_t *group = new group_t();
+    group->name = dbmsg->getName();
+    group->isBusEvent = false;
+    group->record_size = 8 + 8 * dbSignals.size();
+    group->inval_bytes = (dbSignals.size() + 7) / 8;
+    group->cycle_count = 0;
+    group->data_size = 0;
+
+    foreach (CanDbSignal *signal, dbSignals) {
+        channel_t cn;
+        cn.name = signal->name();
+        cn.unit = signal->getUnit();
+        cn.type = cn_type_fixed;
+        cn.sync_type = cn_sync_none;
+        cn.data_type = cn_data_float_le;
+        cn.bit_offset = 0;
+        cn.byte_offset = 8 + 8 * group->dbSignals.size();
+        cn.bit_count = 64;
+        cn.flags = cn_flag_inval_bit_valid;
+        cn.inval_bit_pos = group->dbSignals.size();
+        group->channels.append(cn);
+        group->dbSignals.append(signal);
+    }
+
+    _groups.append(group);
+    _signalGroups.insert(dbmsg, group);
+    return group;
+}
+
+int MdfTraceWriter::channel(CanInterfaceId id)
+{
+    int ch = _channels.value(id, 0);
+    if (ch == 0) {
+        ch = _channels.size() + 1;
+        _channels.insert(id, ch);
+    }
+    return ch;
+}
+
+void MdfTraceWriter::writeDataBlock(MdfTraceWriter::group_t *group)
+{
+    if (group->buf.isEmpty()) {
+        return;
+    }
+
+    QVector<uint64_t> links;
+    group->blocks.append(writeBlock("##DT", links, group->buf));
+    group->block_offsets.append(group->data_size);
+    group->data_size += group->buf.size();
+    group->buf.clear();
+}
+
+uint64_t MdfTraceWriter::writeGroup(MdfTraceWriter::group_t *group, uint64_t next_dg)
+{
+    // blocks are written children first, so every link target is known
+    uint64_t data = 0;
+    if (group->blocks.size() == 1) {
+        data = group->blocks.first();
+    } else if (group->blocks.size() > 1) {
+        QVector<uint64_t> links;
+        links << 0;
+        QByteArray dl;
+        TraceFile::putU8(dl, 0); // flags: blocks of individual length
+        dl.append(3, (char)0);
+        TraceFile::putU32(dl, group->blocks.size());
+        for (int i=0; i<group->blocks.size(); i++) {
+            links << group->blocks[i];
+            TraceFile::putU64(dl, group->block_offsets[i]);
+        }
+        data = writeBlock("##DL", links, dl);
+    }
+
+    uint64_t first_cn = 0;
+    if (group->isBusEvent) {
+        uint64_t member = 0;
+        for (int i=group->channels.size()-1; i>=0; i--) {
+            member = writeChannel(group->channels[i], member, 0);
+        }
+
+        channel_t frame;
+        frame.name = group->name;
+        frame.type = cn_type_fixed;
+        frame.sync_type = cn_sync_none;
+        frame.data_type = cn_data_byte_array;
+        frame.bit_offset = 0;
+        frame.byte_offset = 8;
+        frame.bit_count = (group->record_size - 8) * 8;
+        frame.flags = 0;
+        frame.inval_bit_pos = 0;
+        first_cn = writeChannel(frame, 0, member);
+    } else {
+        for (int i=group->channels.size()-1; i>=0; i--) {
+            first_cn = writeChannel(group->channels[i], first_cn, 0);
+        }
+    }
+
+    channel_t time;
+    time.name = "t";
+    time.unit = "s";
+    time.type = cn_type_master;
+    time.sync_type = cn_sync_time;
+    time.data_type = cn_data_float_le;
+    time.bit_offset = 0;
+    time.byte_offset = 0;
+    time.bit_count = 64;
+    time.flags = 0;
+    time.inval_bit_pos = 0;
+    first_cn = writeChannel(time, first_cn, 0);
+
+    uint64_t source = 0;
+    if (group->isBusEvent) {
+        QVector<uint64_t> si_links;
+        si_links << writeText("CAN") << 0 << 0;
+        QByteArray si;
+        TraceFile::putU8(si, si_type_bus);
+        TraceFile::putU8(si, si_bus_type_can);
+        si.append(6, (char)0);
+        source = writeBlock("##SI", si_links, si);
+    }
+
+    QVector<uint64_t> cg_links;
+    cg_links << 0 << first_cn << writeText(group->name) << source << 0 << 0;
+    QByteArray cg;
+    TraceFile::putU64(cg, 0); // record id
+    TraceFile::putU64(cg, group->cycle_count);
+    TraceFile::putU16(cg, group->isBusEvent ? (cg_flag_bus_event | cg_flag_plain_bus_event) : 0);
+    TraceFile::putU16(cg, '.');
+    cg.append(4, (char)0);
+    TraceFile::putU32(cg, group->record_size);
+    TraceFile::putU32(cg, group->inval_bytes);
+    uint64_t cg_block = writeBlock("##CG", cg_links, cg);
+
+    QVector<uint64_t> dg_links;
+    dg_links << next_dg << cg_block << data << 0;
+    QByteArray dg(8, (char)0); // no record ids, one channel group per data group
+    return writeBlock("##DG", dg_links, dg);
+}
+
+uint64_t MdfTraceWriter::writeChannel(const MdfTraceWriter::channel_t &cn, uint64_t next, uint64_t composition)
+{
+    QVector<uint64_t> links;
+    links << next << composition << writeText(cn.name) << 0 << 0 << 0 << writeText(cn.unit) << 0;
+
+    QByteArray data;
+    TraceFile::putU8(data, cn.type);
+    TraceFile::putU8(data, cn.sync_type);
+    TraceFile::putU8(data, cn.data_type);
+    TraceFile::putU8(data, cn.bit_offset);
+    TraceFile::putU32(data, cn.byte_offset);
+    TraceFile::putU32(data, cn.bit_count);
+    TraceFile::putU32(data, cn.flags);
+    TraceFile::putU32(data, cn.inval_bit_pos);
+    TraceFile::putU8(data, 0); // precision
+    TraceFile::putU8(data, 0);
+    TraceFile::putU16(data, 0); // attachments
+    data.append(6*8, (char)0); // value range and limits, not used
+    return writeBlock("##CN", links, data);
+}
+
+uint64_t MdfTraceWriter::writeText(const QString &text)
+{
+    if (text.isEmpty()) {
+        return 0;
+    }
+    QVector<uint64_t> links;
+    QByteArray data = text.toUtf8();
+    data.append((char)0);
+    return writeBlock("##TX", links, data);
+}
+
+uint64_t MdfTraceWriter::writeBlock(const char *id, const QVector<uint64_t> &links, const QByteArray &data)
+{
+    uint64_t offset = _file.pos();
+
+    QByteArray buf;
+    buf.reserve(block_header_size + links.size()*8 + data.size() + 8);
+    buf.append(id, 4);
+    buf.append(4, (char)0);
+    TraceFile::putU64(buf, block_header_size + links.size()*8 + data.size());
+    TraceFile::putU64(buf, links.size());
+    foreach (uint64_t link, links) {
+        TraceFile::putU64(buf, link);
+    }
+    buf.append(data);
+    buf.append((8 - buf.size() % 8) % 8, (char)0); // blocks start 8 byte aligned
+
+    if (_file.write(buf) != buf.size()) {
+        _error = _file.errorString();
+        _failed = true;
+    }
+    return offset;
+}
+
+void MdfTraceWriter::writeIdBlock(bool finalized)
+{
+    QByteArray id;
+    id.append(finalized ? "MDF     " : "UnFinMF ", 8);
+    id.append("4.10    ", 8);
+    id.append("cangaroo", 8);
+    id.append(4, (char)0);
+    TraceFile::putU16(id, mdf_version);
+    id.append(30, (char)0);
+    TraceFile::putU16(id, 0); // standard unfinalized flags
+    TraceFile::putU16(id, 0); // custom unfinalized flags
+
+    qint64 pos = qMax<qint64>(_file.pos(), id_block_size);
+    if (!_file.seek(0) || (_file.write(id) != id.size()) || !_file.seek(pos)) {
+        _error = _file.errorString();
+        _failed = true;
+    }
+}
+
+void MdfTraceWriter::writeHeaderBlock(uint64_t first_dg, uint64_t first_fh)
+{
+    QByteArray hd;
+    hd.append("##HD", 4);
+    hd.append(4, (char)0);
+    TraceFile::putU64(hd, hd_block_size);
+    TraceFile::putU64(hd, 6);
+    TraceFile::putU64(hd, first_dg);
+    TraceFile::putU64(hd, first_fh);
+    TraceFile::putU64(hd, 0); // channel hierarchy
+    TraceFile::putU64(hd, 0); // attachments
+    TraceFile::putU64(hd, 0); // events
+    TraceFile::putU64(hd, 0); // comment
+    TraceFile::putU64(hd, _hasStartTime ? _startTime_ns : QDateTime::currentMSecsSinceEpoch() * 1000000);
+    TraceFile::putU16(hd, 0); // time zone offset, start time is UTC
+    TraceFile::putU16(hd, 0); // dst offset
+    TraceFile::putU8(hd, 0); // time flags
+    TraceFile::putU8(hd, 0); // time class: local PC time
+    TraceFile::putU8(hd, 0); // flags
+    TraceFile::putU8(hd, 0);
+    putDouble(hd, 0); // start angle
+    putDouble(hd, 0); // start distance
+
+    qint64 pos = _file.pos();
+    if (!_file.seek(id_block_size) || (_file.write(hd) != hd.size()) || !_file.seek(pos)) {
+        _error = _file.errorString();
+        _failed = true;
+    }
+}
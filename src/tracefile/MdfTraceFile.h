@@ -0,0 +1,129 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <QFile>
+#include <QHash>
+#include <QList>
+#include <QVector>
+#include <QByteArray>
+#include <core/CanDb.h>
+#include <driver/CanDriver.h>
+#include "TraceFile.h"
+
+class Backend;
+class CanMessage;
+class CanDbMessage;
+class CanDbSignal;
+
+// ASAM MDF 4.10 files (*.mf4).
+//
+// Raw frames go to the CAN_DataFrame / CAN_RemoteFrame channel groups of the
+// ASAM bus logging convention. If CAN databases are set, every decoded
+// message additionally gets its own channel group with a float64 channel
+// per signal; signals that are not present in a frame (e.g. multiplexed
+// ones) are flagged through the invalidation bits.
+//
+// Each channel group has its own data group. Records are collected per
+// group and written out as DT blocks of data_block_size bytes, so memory use
+// stays bounded and the file is sorted when it is closed. The block tree
+// describing the groups is written on close.
+class MdfTraceWriter : public TraceFileWriter
+{
+public:
+    enum {
+        data_block_size = 64*1024
+    };
+
+    MdfTraceWriter(Backend &backend);
+    virtual ~MdfTraceWriter();
+
+    void setCanDbs(const QList<pCanDb> &dbs);
+
+    virtual bool open(const QString &filename);
+    virtual bool isOpen() const;
+    virtual bool close();
+
+    virtual bool addMessage(const CanMessage &msg);
+    virtual bool sync();
+
+    virtual uint64_t bytesWritten() const;
+    virtual QString errorString() const;
+
+private:
+    typedef struct {
+        QString name;
+        QString unit;
+        uint8_t type;
+        uint8_t sync_type;
+        uint8_t data_type;
+        uint8_t bit_offset;
+        uint32_t byte_offset;
+        uint32_t bit_count;
+        uint32_t flags;
+        uint32_t inval_bit_pos;
+    } channel_t;
+
+    typedef struct {
+        QString name;
+        bool isBusEvent;
+        QVector<channel_t> channels; // after the master channel
+        uint32_t record_size;
+        uint32_t inval_bytes;
+        QList<CanDbSignal*> dbSignals;
+
+        uint64_t cycle_count;
+        uint64_t data_size;
+        QByteArray buf;
+        QList<uint64_t> blocks; // file offsets of the DT blocks
+        QList<uint64_t> block_offsets; // their offsets in the record data
+    } group_t;
+
+    Backend &_backend;
+    QFile _file;
+    QString _error;
+    bool _failed;
+
+    QList<pCanDb> _canDbs;
+    QHash<uint32_t, CanDbMessage*> _dbMessages;
+    QHash<CanDbMessage*, group_t*> _signalGroups;
+    QHash<CanInterfaceId, int> _channels;
+    QList<group_t*> _groups;
+    group_t *_dataFrames;
+    group_t *_remoteFrames;
+
+    bool _hasStartTime;
+    int64_t _startTime_ns;
+
+    group_t *createBusGroup(const QString &name, bool withData);
+    group_t *signalGroup(CanDbMessage *dbmsg);
+    int channel(CanInterfaceId id);
+
+    void writeDataBlock(group_t *group);
+    uint64_t writeGroup(group_t *group, uint64_t next_dg);
+    uint64_t writeChannel(const channel_t &cn, uint64_t next, uint64_t composition);
+    uint64_t writeText(const QString &text);
+    uint64_t writeBlock(const char *id, const QVector<uint64_t> &links, const QByteArray &data);
+    void writeIdBlock(bool finalized);
+    void writeHeaderBlock(uint64_t first_dg, uint64_t first_fh);
+};
@@ -0,0 +1,528 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "NativeTraceFile.h"
+
+#include <string.h>
+#include <QDateTime>
+#include <core/Backend.h>
+#include <core/CanMessage.h>
+
+enum {
+    file_header_size = 32,
+    file_version = 1,
+    file_trailer_size = 16,
+    block_magic = 0x4b424743,   // "CGBK"
+    index_magic = 0x58494743,   // "CGIX"
+    trailer_magic = 0x4e454743, // "CGEN"
+    frame_header_size = 16,
+    frame_flag_fd = 0x01,
+    frame_flag_brs = 0x02,
+    frame_flag_rx = 0x04,
+    compression_level = 1
+};
+
+static const char file_magic[8] = { 'C', 'G', 'T', 'R', 'A', 'C', 'E', '1' };
+
+
+NativeTraceBlockInfo::NativeTraceBlockInfo()
+  : offset(0),
+    num_frames(0),
+    compressed_size(0),
+    t_min_ns(0),
+    t_max_ns(0)
+{
+    memset(id_summary, 0, sizeof(id_summary));
+}
+
+static inline int summaryBit(uint32_t raw_id)
+{
+    return (raw_id * 2654435761u) >> 24;
+}
+
+void NativeTraceBlockInfo::addId(uint32_t raw_id)
+{
+    int bit = summaryBit(raw_id);
+    id_summary[bit/8] |= (1 << (bit%8));
+}
+
+bool NativeTraceBlockInfo::mayContainId(uint32_t raw_id) const
+{
+    int bit = summaryBit(raw_id);
+    return (id_summary[bit/8] & (1 << (bit%8))) != 0;
+}
+
+void NativeTraceBlockInfo::toHeader(QByteArray &buf) const
+{
+    TraceFile::putU32(buf, block_magic);
+    TraceFile::putU32(buf, num_frames);
+    TraceFile::putU32(buf, compressed_size);
+    TraceFile::putU32(buf, 0);
+    TraceFile::putU64(buf, t_min_ns);
+    TraceFile::putU64(buf, t_max_ns);
+    buf.append((const char*)id_summary, id_summary_bytes);
+}
+
+bool NativeTraceBlockInfo::fromHeader(const char *p)
+{
+    if (TraceFile::getU32(p) != block_magic) {
+        return false;
+    }
+    num_frames = TraceFile::getU32(p+4);
+    compressed_size = TraceFile::getU32(p+8);
+    t_min_ns = TraceFile::getU64(p+16);
+    t_max_ns = TraceFile::getU64(p+24);
+    memcpy(id_summary, p+32, id_summary_bytes);
+    return true;
+}
+
+
+NativeTraceWriter::NativeTraceWriter(Backend &backend)
+  : _backend(backend),
+    _offset(0),
+    _framesWritten(0)
+{
+}
+
+NativeTraceWriter::~NativeTraceWriter()
+{
+    close();
+}
+
+bool NativeTraceWriter::open(const QString &filename)
+{
+    close();
+
+    _file.setFileName(filename);
+    if (!_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        _error = _file.errorString();
+        return false;
+    }
+
+    _offset = 0;
+    _framesWritten = 0;
+    _index.clear();
+    _frameData.clear();
+    _frameData.reserve(frames_per_block * (frame_header_size + 8));
+    _block = NativeTraceBlockInfo();
+    _blockInterfaces.clear();
+
+    QByteArray header;
+    header.append(file_magic, sizeof(file_magic));
+    TraceFile::putU32(header, file_version);
+    TraceFile::putU32(header, file_header_size);
+    TraceFile::putU64(header, QDateTime::currentMSecsSinceEpoch());
+    TraceFile::putU64(header, 0);
+    return write(header);
+}
+
+bool NativeTraceWriter::isOpen() const
+{
+    return _file.isOpen();
+}
+
+bool NativeTraceWriter::close()
+{
+    if (!_file.isOpen()) {
+        return true;
+    }
+
+    bool ok = writeBlock();
+
+    QByteArray index;
+    uint64_t index_offset = _offset;
+    TraceFile::putU32(index, index_magic);
+    foreach (const NativeTraceBlockInfo &info, _index) {
+        TraceFile::putU64(index, info.offset);
+        info.toHeader(index);
+    }
+    TraceFile::putU64(index, index_offset);
+    TraceFile::putU32(index, _index.size());
+    TraceFile::putU32(index, trailer_magic);
+    ok = ok && write(index);
+
+    _file.close();
+    return ok;
+}
+
+bool NativeTraceWriter::addMessage(const CanMessage &msg)
+{
+    int64_t t = msg.getTimestampNsecs();
+    if (_block.num_frames == 0) {
+        _block.t_min_ns = t;
+        _block.t_max_ns = t;
+    } else if (t < _block.t_min_ns) {
+        _block.t_min_ns = t;
+    } else if (t > _block.t_max_ns) {
+        _block.t_max_ns = t;
+    }
+
+    CanInterfaceId intf = msg.getInterfaceId();
+    if (!_blockInterfaces.contains(intf)) {
+        _blockInterfaces.append(intf);
+    }
+
+    uint8_t flags = 0;
+    if (msg.isFD()) { flags |= frame_flag_fd; }
+    if (msg.isBRS()) { flags |= frame_flag_brs; }
+    if (msg.isRX()) { flags |= frame_flag_rx; }
+
+    uint8_t len = msg.getLength();
+    TraceFile::putU64(_frameData, t);
+    TraceFile::putU32(_frameData, msg.getRawId());
+    TraceFile::putU16(_frameData, intf);
+    TraceFile::putU8(_frameData, flags);
+    TraceFile::putU8(_frameData, len);
+    for (int i=0; i<len; i++) {
+        _frameData.append((char)msg.getByte(i));
+    }
+
+    _block.addId(msg.getRawId());
+    if (++_block.num_frames >= frames_per_block) {
+        return writeBlock();
+    }
+    return true;
+}
+
+bool NativeTraceWriter::addMessages(const CanMessage *msgs, int count)
+{
+    for (int i=0; i<count; i++) {
+        if (!addMessage(msgs[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool NativeTraceWriter::flush()
+{
+    return writeBlock() && _file.flush();
+}
+
+bool NativeTraceWriter::sync()
+{
+    // write out the pending partial block and ask the OS to commit it,
+    // so the file is readable up to this point even after a power loss
+    return flush() && TraceFile::syncFile(_file);
+}
+
+uint64_t NativeTraceWriter::framesWritten() const
+{
+    return _framesWritten;
+}
+
+uint64_t NativeTraceWriter::bytesWritten() const
+{
+    return _offset;
+}
+
+QString NativeTraceWriter::errorString() const
+{
+    return _error;
+}
+
+bool NativeTraceWriter::writeBlock()
+{
+    if (_block.num_frames == 0) {
+        return true;
+    }
+
+    QByteArray payload;
+    payload.reserve(_frameData.size() + 256);
+    TraceFile::putU16(payload, _blockInterfaces.size());
+    foreach (CanInterfaceId intf, _blockInterfaces) {
+        if (!_interfaceNames.contains(intf)) {
+            _interfaceNames.insert(intf, _backend.getInterfaceName(intf));
+        }
+        QByteArray name = _interfaceNames.value(intf).toUtf8();
+        TraceFile::putU16(payload, intf);
+        TraceFile::putU16(payload, name.size());
+        payload.append(name);
+    }
+    payload.append(_frameData);
+
+    QByteArray compressed = qCompress(payload, compression_level);
+    _block.offset = _offset;
+    _block.compressed_size = compressed.size();
+
+    QByteArray header;
+    _block.toHeader(header);
+    if (!write(header) || !write(compressed)) {
+        return false;
+    }
+
+    _index.append(_block);
+    _framesWritten += _block.num_frames;
+
+    _block = NativeTraceBlockInfo();
+    _blockInterfaces.clear();
+    _frameData.clear();
+    return true;
+}
+
+bool NativeTraceWriter::write(const QByteArray &data)
+{
+    if (_file.write(data) != data.size()) {
+        _error = _file.errorString();
+        return false;
+    }
+    _offset += data.size();
+    return true;
+}
+
+
+NativeTraceReader::NativeTraceReader(Backend &backend)
+  : _indexed(false),
+    _interfaces(backend)
+{
+}
+
+bool NativeTraceReader::open(const QString &filename)
+{
+    close();
+
+    _file.setFileName(filename);
+    if (!_file.open(QIODevice::ReadOnly)) {
+        _error = _file.errorString();
+        return false;
+    }
+
+    QByteArray header = _file.read(file_header_size);
+    if ((header.size() != file_header_size) || memcmp(header.constData(), file_magic, sizeof(file_magic))) {
+        _error = QString("not a cangaroo trace file");
+        _file.close();
+        return false;
+    }
+    if (TraceFile::getU32(header.constData()+8) > file_version) {
+        _error = QString("unsupported trace file version");
+        _file.close();
+        return false;
+    }
+
+    _indexed = readIndex();
+    if (!_indexed && !scanBlocks()) {
+        _file.close();
+        return false;
+    }
+    return true;
+}
+
+void NativeTraceReader::close()
+{
+    _file.close();
+    _blocks.clear();
+    _indexed = false;
+}
+
+bool NativeTraceReader::isIndexed() const
+{
+    return _indexed;
+}
+
+int NativeTraceReader::blockCount() const
+{
+    return _blocks.size();
+}
+
+const NativeTraceBlockInfo &NativeTraceReader::blockInfo(int block) const
+{
+    return _blocks[block];
+}
+
+uint64_t NativeTraceReader::frameCount() const
+{
+    uint64_t count = 0;
+    foreach (const NativeTraceBlockInfo &info, _blocks) {
+        count += info.num_frames;
+    }
+    return count;
+}
+
+int NativeTraceReader::findBlockByTime(int64_t t_ns) const
+{
+    for (int i=0; i<_blocks.size(); i++) {
+        if (_blocks[i].t_max_ns >= t_ns) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool NativeTraceReader::readBlock(int block, QList<CanMessage> &msgs)
+{
+    const NativeTraceBlockInfo &info = _blocks[block];
+
+    if (!_file.seek(info.offset + NativeTraceBlockInfo::header_size)) {
+        _error = _file.errorString();
+        return false;
+    }
+    QByteArray payload = qUncompress(_file.read(info.compressed_size));
+    if (payload.size() < 2) {
+        _error = QString("corrupt block at offset %1").arg(info.offset);
+        return false;
+    }
+
+    const char *p = payload.constData();
+    const char *end = p + payload.size();
+
+    QHash<uint16_t, QString> names;
+    int num_interfaces = TraceFile::getU16(p);
+    p += 2;
+    for (int i=0; i<num_interfaces; i++) {
+        if (end-p < 4) {
+            _error = QString("corrupt block at offset %1").arg(info.offset);
+            return false;
+        }
+        uint16_t id = TraceFile::getU16(p);
+        uint16_t name_len = TraceFile::getU16(p+2);
+        p += 4;
+        if (end-p < name_len) {
+            _error = QString("corrupt block at offset %1").arg(info.offset);
+            return false;
+        }
+        QString name = QString::fromUtf8(p, name_len);
+        names.insert(id, name);
+        _interfaces.reserve(name);
+        p += name_len;
+    }
+
+    QHash<uint16_t, CanInterfaceId> interfaces;
+    QHash<uint16_t, QString>::const_iterator it;
+    for (it = names.constBegin(); it != names.constEnd(); ++it) {
+        interfaces.insert(it.key(), _interfaces.lookup(it.value()));
+    }
+
+    // num_frames comes from the file, don't let it size the allocation unchecked
+    if ((info.num_frames > NativeTraceWriter::frames_per_block) || (info.num_frames > (uint32_t)(end-p) / frame_header_size)) {
+        _error = QString("corrupt block at offset %1").arg(info.offset);
+        return false;
+    }
+
+    msgs.reserve(msgs.size() + info.num_frames);
+    CanMessage msg;
+    for (uint32_t i=0; i<info.num_frames; i++) {
+        if (end-p < frame_header_size) {
+            _error = QString("corrupt block at offset %1").arg(info.offset);
+            return false;
+        }
+        int64_t t_ns = TraceFile::getU64(p);
+        uint32_t raw_id = TraceFile::getU32(p+8);
+        uint16_t intf = TraceFile::getU16(p+12);
+        uint8_t flags = p[14];
+        uint8_t len = p[15];
+        p += frame_header_size;
+        if (end-p < len) {
+            _error = QString("corrupt block at offset %1").arg(info.offset);
+            return false;
+        }
+
+        msg.setTimestampNsecs(t_ns);
+        msg.setRawId(raw_id);
+        msg.setInterfaceId(interfaces.value(intf));
+        msg.setFD(flags & frame_flag_fd);
+        msg.setBRS(flags & frame_flag_brs);
+        msg.setRX(flags & frame_flag_rx);
+        msg.setLength(len);
+        for (int k=0; k<len; k++) {
+            msg.setByte(k, p[k]);
+        }
+        p += len;
+
+        msgs.append(msg);
+    }
+
+    return true;
+}
+
+QString NativeTraceReader::errorString() const
+{
+    return _error;
+}
+
+bool NativeTraceReader::readIndex()
+{
+    qint64 size = _file.size();
+    if (size < file_header_size + file_trailer_size) {
+        return false;
+    }
+
+    _file.seek(size - file_trailer_size);
+    QByteArray trailer = _file.read(file_trailer_size);
+    if ((trailer.size() != file_trailer_size) || (TraceFile::getU32(trailer.constData()+12) != trailer_magic)) {
+        return false;
+    }
+
+    uint64_t index_offset = TraceFile::getU64(trailer.constData());
+    uint32_t num_blocks = TraceFile::getU32(trailer.constData()+8);
+    const int entry_size = 8 + NativeTraceBlockInfo::header_size;
+    if ((index_offset < file_header_size) || (index_offset + 4 + (uint64_t)num_blocks*entry_size + file_trailer_size != (uint64_t)size)) {
+        return false;
+    }
+
+    _file.seek(index_offset);
+    QByteArray index = _file.read(4 + num_blocks*entry_size);
+    if (TraceFile::getU32(index.constData()) != index_magic) {
+        return false;
+    }
+
+    _blocks.resize(num_blocks);
+    const char *p = index.constData() + 4;
+    for (uint32_t i=0; i<num_blocks; i++) {
+        _blocks[i].offset = TraceFile::getU64(p);
+        if (!_blocks[i].fromHeader(p+8)) {
+            _blocks.clear();
+            return false;
+        }
+        p += entry_size;
+    }
+    return true;
+}
+
+bool NativeTraceReader::scanBlocks()
+{
+    // no usable index, e.g. the recording was not closed properly:
+    // walk the block headers and stop at the first incomplete block.
+    _blocks.clear();
+
+    qint64 size = _file.size();
+    uint64_t offset = file_header_size;
+    while (offset + NativeTraceBlockInfo::header_size <= (uint64_t)size) {
+        _file.seek(offset);
+        QByteArray header = _file.read(NativeTraceBlockInfo::header_size);
+
+        NativeTraceBlockInfo info;
+        if (!info.fromHeader(header.constData())) {
+            break;
+        }
+        info.offset = offset;
+        offset += NativeTraceBlockInfo::header_size + info.compressed_size;
+        if (offset > (uint64_t)size) {
+            break;
+        }
+        _blocks.append(info);
+    }
+
+    if (_blocks.isEmpty() && (size > file_header_size)) {
+        _error = QString("no readable blocks in trace file");
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,145 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <QFile>
+#include <QHash>
+#include <QList>
+#include <QVector>
+#include <QByteArray>
+#include <driver/CanDriver.h>
+#include "TraceFile.h"
+
+class Backend;
+class CanMessage;
+
+// Native cangaroo trace file (*.cgt)
+//
+// Layout (all integers little endian):
+//
+//   file header   "CGTRACE1", u32 version, u32 header size, i64 creation time [ms], u64 reserved
+//   block         u32 "CGBK", u32 frame count, u32 compressed size, u32 reserved,
+//                 i64 t_min [ns], i64 t_max [ns], u8 id_summary[32],
+//                 followed by a qCompress()ed payload
+//   ...
+//   index         u32 "CGIX", then per block: u64 file offset + copy of the block header
+//   trailer       u64 index offset, u32 block count, u32 "CGEN"
+//
+// A block payload starts with the interfaces it references
+// (u16 count, then u16 id, u16 name length, utf8 name) followed by the frames
+// (i64 timestamp [ns], u32 raw id, u16 interface id, u8 flags, u8 length, data).
+//
+// Every block header is self-contained, so a file whose writer did not get
+// to write the index (crash, power loss) can still be read by scanning the
+// block headers.
+class NativeTraceBlockInfo
+{
+public:
+    enum {
+        header_size = 64,
+        id_summary_bytes = 32
+    };
+
+    uint64_t offset;
+    uint32_t num_frames;
+    uint32_t compressed_size;
+    int64_t t_min_ns;
+    int64_t t_max_ns;
+    uint8_t id_summary[id_summary_bytes];
+
+    NativeTraceBlockInfo();
+    void addId(uint32_t raw_id);
+    bool mayContainId(uint32_t raw_id) const;
+
+    void toHeader(QByteArray &buf) const;
+    bool fromHeader(const char *p);
+};
+
+class NativeTraceWriter : public TraceFileWriter
+{
+public:
+    enum {
+        frames_per_block = 8192
+    };
+
+    NativeTraceWriter(Backend &backend);
+    virtual ~NativeTraceWriter();
+
+    virtual bool open(const QString &filename);
+    virtual bool isOpen() const;
+    virtual bool close();
+
+    virtual bool addMessage(const CanMessage &msg);
+    bool addMessages(const CanMessage *msgs, int count);
+    bool flush();
+    virtual bool sync();
+
+    uint64_t framesWritten() const;
+    virtual uint64_t bytesWritten() const;
+    virtual QString errorString() const;
+
+private:
+    Backend &_backend;
+    QFile _file;
+    uint64_t _offset;
+    uint64_t _framesWritten;
+    QString _error;
+
+    QByteArray _frameData;
+    NativeTraceBlockInfo _block;
+    QList<CanInterfaceId> _blockInterfaces;
+    QHash<CanInterfaceId, QString> _interfaceNames;
+    QVector<NativeTraceBlockInfo> _index;
+
+    bool writeBlock();
+    bool write(const QByteArray &data);
+};
+
+class NativeTraceReader
+{
+public:
+    NativeTraceReader(Backend &backend);
+
+    bool open(const QString &filename);
+    void close();
+
+    bool isIndexed() const;
+    int blockCount() const;
+    const NativeTraceBlockInfo &blockInfo(int block) const;
+    uint64_t frameCount() const;
+    int findBlockByTime(int64_t t_ns) const;
+
+    bool readBlock(int block, QList<CanMessage> &msgs);
+
+    QString errorString() const;
+
+private:
+    QFile _file;
+    bool _indexed;
+    QVector<NativeTraceBlockInfo> _blocks;
+    TraceFileInterfaceMap _interfaces;
+    QString _error;
+
+    bool readIndex();
+    bool scanBlocks();
+};
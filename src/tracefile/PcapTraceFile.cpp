@@ -0,0 +1,551 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "PcapTraceFile.h"
+
+#include <string.h>
+#include <QtEndian>
+#include <core/Backend.h>
+#include <core/CanMessage.h>
+
+enum {
+    linktype_can_socketcan = 227,
+
+    block_section_header = 0x0A0D0D0A,
+    block_interface_description = 0x00000001,
+    block_enhanced_packet = 0x00000006,
+    byte_order_magic = 0x1A2B3C4D,
+
+    opt_endofopt = 0,
+    opt_shb_userappl = 4,
+    opt_if_name = 2,
+    opt_if_tsresol = 9,
+    opt_if_tsoffset = 14,
+
+    pcap_magic_usec = 0xA1B2C3D4,
+    pcap_magic_nsec = 0xA1B23C4D,
+    pcap_header_size = 24,
+    pcap_record_header_size = 16,
+
+    canfd_brs = 0x01,
+    canfd_esi = 0x02,
+    canfd_fdf = 0x04,
+    can_header_size = 8,
+    can_max_dlen = 8,
+    canfd_max_dlen = 64
+};
+
+static inline void putOption(QByteArray &buf, uint16_t code, const QByteArray &value)
+{
+    TraceFile::putU16(buf, code);
+    TraceFile::putU16(buf, value.size());
+    buf.append(value);
+    while (buf.size() % 4) {
+        buf.append((char)0);
+    }
+}
+
+static inline void finishBlock(QByteArray &buf, int start)
+{
+    // block total length goes to the header and the trailer
+    uint32_t len = buf.size() - start + 4;
+    TraceFile::putU32(buf, len);
+    len = qToLittleEndian(len);
+    memcpy(buf.data() + start + 4, &len, 4);
+}
+
+static int64_t toNsecs(uint64_t ts, uint8_t tsresol)
+{
+    if (tsresol & 0x80) {
+        int bits = tsresol & 0x7F;
+        uint64_t secs = ts >> bits;
+        uint64_t frac = ts & ((1ULL << bits) - 1);
+        return secs * 1000000000LL + (int64_t)((double)frac * 1e9 / (double)(1ULL << bits));
+    }
+
+    int64_t factor = 1;
+    for (int i=tsresol; i<9; i++) {
+        factor *= 10;
+    }
+    int64_t divisor = 1;
+    for (int i=9; i<tsresol; i++) {
+        divisor *= 10;
+    }
+    return (int64_t)ts * factor / divisor;
+}
+
+
+PcapngTraceWriter::PcapngTraceWriter()
+  : _bytesWritten(0)
+{
+}
+
+PcapngTraceWriter::~PcapngTraceWriter()
+{
+    close();
+}
+
+void PcapngTraceWriter::setInterfaceName(CanInterfaceId id, const QString &name)
+{
+    _interfaceNames.insert(id, name);
+}
+
+bool PcapngTraceWriter::open(const QString &filename)
+{
+    close();
+
+    _file.setFileName(filename);
+    if (!_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        _error = _file.errorString();
+        return false;
+    }
+
+    _interfaceBlocks.clear();
+    _bytesWritten = 0;
+    _buf.clear();
+    _buf.reserve(write_buffer_size + 1024);
+
+    TraceFile::putU32(_buf, block_section_header);
+    TraceFile::putU32(_buf, 0);
+    TraceFile::putU32(_buf, byte_order_magic);
+    TraceFile::putU16(_buf, 1); // version 1.0
+    TraceFile::putU16(_buf, 0);
+    TraceFile::putU64(_buf, (uint64_t)-1); // section length not specified
+    putOption(_buf, opt_shb_userappl, QByteArray("cangaroo"));
+    TraceFile::putU32(_buf, opt_endofopt);
+    finishBlock(_buf, 0);
+
+    return writeBuffer();
+}
+
+bool PcapngTraceWriter::isOpen() const
+{
+    return _file.isOpen();
+}
+
+bool PcapngTraceWriter::close()
+{
+    if (!_file.isOpen()) {
+        return true;
+    }
+    bool ok = writeBuffer();
+    _file.close();
+    return ok;
+}
+
+bool PcapngTraceWriter::addMessage(const CanMessage &msg)
+{
+    CanInterfaceId intf = msg.getInterfaceId();
+    QHash<CanInterfaceId, uint32_t>::const_iterator it = _interfaceBlocks.constFind(intf);
+    if (it == _interfaceBlocks.constEnd()) {
+        writeInterfaceBlock(intf);
+        it = _interfaceBlocks.constFind(intf);
+    }
+
+    // pcapng timestamps are unsigned, frames before the epoch are pinned to it
+    CanTimestamp t_ns = msg.getTimestampNsecs();
+    uint64_t ts = (t_ns > 0) ? t_ns : 0;
+
+    uint8_t len = msg.getLength();
+    bool fd = msg.isFD() || (len > can_max_dlen);
+    int caplen = can_header_size + (fd ? canfd_max_dlen : can_max_dlen);
+
+    int start = _buf.size();
+    TraceFile::putU32(_buf, block_enhanced_packet);
+    TraceFile::putU32(_buf, 0);
+    TraceFile::putU32(_buf, it.value());
+    TraceFile::putU32(_buf, ts >> 32);
+    TraceFile::putU32(_buf, ts & 0xFFFFFFFF);
+    TraceFile::putU32(_buf, caplen);
+    TraceFile::putU32(_buf, caplen);
+
+    uint32_t can_id = qToBigEndian((quint32)msg.getRawId());
+    _buf.append((const char*)&can_id, 4);
+    TraceFile::putU8(_buf, len);
+    TraceFile::putU8(_buf, fd ? (canfd_fdf | (msg.isBRS() ? canfd_brs : 0)) : 0);
+    TraceFile::putU16(_buf, 0);
+    for (int i=0; i<len; i++) {
+        _buf.append((char)msg.getByte(i));
+    }
+    _buf.append(caplen - can_header_size - len, (char)0);
+
+    finishBlock(_buf, start);
+
+    if (_buf.size() >= write_buffer_size) {
+        return writeBuffer();
+    }
+    return true;
+}
+
+bool PcapngTraceWriter::sync()
+{
+    return writeBuffer() && TraceFile::syncFile(_file);
+}
+
+uint64_t PcapngTraceWriter::bytesWritten() const
+{
+    return _bytesWritten + _buf.size();
+}
+
+QString PcapngTraceWriter::errorString() const
+{
+    return _error;
+}
+
+void PcapngTraceWriter::writeInterfaceBlock(CanInterfaceId id)
+{
+    QString name = _interfaceNames.value(id);
+    if (name.isEmpty()) {
+        name = QString("can%1").arg(id);
+    }
+
+    int start = _buf.size();
+    TraceFile::putU32(_buf, block_interface_description);
+    TraceFile::putU32(_buf, 0);
+    TraceFile::putU16(_buf, linktype_can_socketcan);
+    TraceFile::putU16(_buf, 0);
+    TraceFile::putU32(_buf, can_header_size + canfd_max_dlen); // snaplen
+    putOption(_buf, opt_if_name, name.toUtf8());
+    putOption(_buf, opt_if_tsresol, QByteArray(1, (char)9)); // nanoseconds
+    TraceFile::putU32(_buf, opt_endofopt);
+    finishBlock(_buf, start);
+
+    _interfaceBlocks.insert(id, _interfaceBlocks.size());
+}
+
+bool PcapngTraceWriter::writeBuffer()
+{
+    if (_file.write(_buf) != _buf.size()) {
+        _error = _file.errorString();
+        return false;
+    }
+    _bytesWritten += _buf.size();
+    _buf.clear();
+    return true;
+}
+
+
+PcapTraceReader::PcapTraceReader(Backend &backend)
+  : _begin(0),
+    _pos(0),
+    _end(0),
+    _isPcapng(false),
+    _swapped(false),
+    _failed(false),
+    _interfaceMap(backend)
+{
+}
+
+PcapTraceReader::~PcapTraceReader()
+{
+    close();
+}
+
+bool PcapTraceReader::open(const QString &filename)
+{
+    close();
+
+    _file.setFileName(filename);
+    if (!_file.open(QIODevice::ReadOnly)) {
+        _error = _file.errorString();
+        return false;
+    }
+
+    // map the file; pages are only read as packets are consumed
+    qint64 size = _file.size();
+    _begin = (size > 0) ? (const char *)_file.map(0, size) : 0;
+    if (!_begin) {
+        _buffer = _file.readAll();
+        _begin = _buffer.constData();
+        size = _buffer.size();
+    }
+    _pos = _begin;
+    _end = _begin + size;
+
+    if (size < 12) {
+        _error = QString("file too short");
+        close();
+        return false;
+    }
+
+    uint32_t magic = qFromLittleEndian<quint32>(_begin);
+    if (magic == block_section_header) {
+        _isPcapng = true;
+        reserveInterfaceNames();
+        return true;
+    }
+
+    // classic pcap: one interface, described by the file header
+    _isPcapng = false;
+    interface_t intf;
+    intf.tsoffset_s = 0;
+    if ((magic == pcap_magic_usec) || (magic == pcap_magic_nsec)) {
+        _swapped = false;
+    } else if ((qbswap(magic) == pcap_magic_usec) || (qbswap(magic) == pcap_magic_nsec)) {
+        _swapped = true;
+        magic = qbswap(magic);
+    } else {
+        _error = QString("not a pcap or pcapng file");
+        close();
+        return false;
+    }
+    if (size < pcap_header_size) {
+        _error = QString("file too short");
+        close();
+        return false;
+    }
+
+    intf.tsresol = (magic == pcap_magic_nsec) ? 9 : 6;
+    intf.linktype = u32(_begin + 20) & 0xFFFF;
+    intf.id = _interfaceMap.lookupChannel(1);
+    if (intf.linktype != linktype_can_socketcan) {
+        _error = QString("unsupported link type %1").arg(intf.linktype);
+        close();
+        return false;
+    }
+    _interfaces.append(intf);
+    _pos = _begin + pcap_header_size;
+    return true;
+}
+
+void PcapTraceReader::close()
+{
+    _file.close();
+    _buffer.clear();
+    _begin = _pos = _end = 0;
+    _interfaces.clear();
+    _failed = false;
+}
+
+int PcapTraceReader::readMessages(QList<CanMessage> &msgs, int max_count)
+{
+    int count = 0;
+    while ((count < max_count) && !atEnd()) {
+        CanMessage msg;
+
+        if (!_isPcapng) {
+            if (_end - _pos < pcap_record_header_size) {
+                _pos = _end;
+                break;
+            }
+            uint32_t caplen = u32(_pos + 8);
+            if ((uint64_t)(_end - _pos) < pcap_record_header_size + (uint64_t)caplen) {
+                _pos = _end; // truncated capture
+                break;
+            }
+            const interface_t &intf = _interfaces.first();
+            uint64_t ts = (uint64_t)u32(_pos) * (intf.tsresol == 9 ? 1000000000 : 1000000) + u32(_pos + 4);
+            if (readPacket(_pos + pcap_record_header_size, caplen, intf, ts, msg)) {
+                msgs.append(msg);
+                count++;
+            }
+            _pos += pcap_record_header_size + caplen;
+            continue;
+        }
+
+        if (_end - _pos < 12) {
+            _pos = _end;
+            break;
+        }
+
+        uint32_t type = u32(_pos);
+        if (type == block_section_header) {
+            uint32_t bom = qFromLittleEndian<quint32>(_pos + 8);
+            _swapped = (bom != byte_order_magic);
+        }
+        uint32_t len = u32(_pos + 4);
+        if ((len < 12) || (len % 4) || ((uint64_t)len > (uint64_t)(_end - _pos))) {
+            if ((uint64_t)len > (uint64_t)(_end - _pos)) {
+                _pos = _end; // truncated capture
+            } else {
+                _error = QString("corrupt block at offset %1").arg(_pos - _begin);
+                _failed = true;
+            }
+            break;
+        }
+
+        if (type == block_section_header) {
+            if (!readSectionHeader(_pos, len)) {
+                _failed = true;
+                break;
+            }
+        } else if (type == block_interface_description) {
+            readInterfaceBlock(_pos, len);
+        } else if ((type == block_enhanced_packet) && (len >= 32)) {
+            uint32_t idx = u32(_pos + 8);
+            uint32_t caplen = u32(_pos + 20);
+            if ((idx < (uint32_t)_interfaces.size()) && (caplen <= len - 32)) {
+                const interface_t &intf = _interfaces[idx];
+                uint64_t ts = ((uint64_t)u32(_pos + 12) << 32) | u32(_pos + 16);
+                if (readPacket(_pos + 28, caplen, intf, ts, msg)) {
+                    msgs.append(msg);
+                    count++;
+                }
+            }
+        }
+        _pos += len;
+    }
+
+    return _failed ? -1 : count;
+}
+
+bool PcapTraceReader::atEnd() const
+{
+    return _failed || (_pos >= _end);
+}
+
+int PcapTraceReader::percentDone() const
+{
+    return (_end > _begin) ? (int)((int64_t)(_pos - _begin) * 100 / (_end - _begin)) : 100;
+}
+
+QString PcapTraceReader::errorString() const
+{
+    return _error;
+}
+
+uint16_t PcapTraceReader::u16(const char *p) const
+{
+    uint16_t v = qFromLittleEndian<quint16>(p);
+    return _swapped ? qbswap(v) : v;
+}
+
+uint32_t PcapTraceReader::u32(const char *p) const
+{
+    uint32_t v = qFromLittleEndian<quint32>(p);
+    return _swapped ? qbswap(v) : v;
+}
+
+bool PcapTraceReader::readSectionHeader(const char *block, uint32_t len)
+{
+    if (len < 28) {
+        _error = QString("corrupt section header");
+        return false;
+    }
+    if (u16(block + 12) != 1) {
+        _error = QString("unsupported pcapng version %1").arg(u16(block + 12));
+        return false;
+    }
+
+    // interface numbering restarts with every section
+    _interfaces.clear();
+    return true;
+}
+
+void PcapTraceReader::readInterfaceBlock(const char *block, uint32_t len)
+{
+    QString name;
+    interface_t intf = parseInterfaceBlock(block, len, &name);
+    intf.id = name.isEmpty() ? _interfaceMap.lookupChannel(_interfaces.size() + 1) : _interfaceMap.lookup(name);
+    _interfaces.append(intf);
+}
+
+PcapTraceReader::interface_t PcapTraceReader::parseInterfaceBlock(const char *block, uint32_t len, QString *name) const
+{
+    interface_t intf;
+    intf.linktype = u16(block + 8);
+    intf.id = 0;
+    intf.tsresol = 6;
+    intf.tsoffset_s = 0;
+
+    const char *opt = block + 16;
+    const char *end = block + len - 4;
+    while (opt + 4 <= end) {
+        uint16_t code = u16(opt);
+        uint16_t optlen = u16(opt + 2);
+        const char *value = opt + 4;
+        if ((code == opt_endofopt) || (value + optlen > end)) {
+            break;
+        }
+
+        if (code == opt_if_name) {
+            *name = QString::fromUtf8(value, strnlen(value, optlen));
+        } else if ((code == opt_if_tsresol) && (optlen >= 1)) {
+            intf.tsresol = value[0];
+        } else if ((code == opt_if_tsoffset) && (optlen >= 8)) {
+            uint64_t v = qFromLittleEndian<quint64>(value);
+            intf.tsoffset_s = _swapped ? qbswap(v) : v;
+        }
+
+        opt = value + ((optlen + 3) & ~3);
+    }
+
+    return intf;
+}
+
+void PcapTraceReader::reserveInterfaceNames()
+{
+    // interface blocks may come anywhere before their first packet, walk
+    // the block headers once so names of this file are matched before any
+    // unknown name is given a spare interface
+    bool swapped = _swapped;
+    const char *p = _begin;
+    while (_end - p >= 12) {
+        uint32_t type = u32(p);
+        if (type == block_section_header) {
+            _swapped = (qFromLittleEndian<quint32>(p + 8) != byte_order_magic);
+        }
+        uint32_t len = u32(p + 4);
+        if ((len < 12) || (len % 4) || ((uint64_t)len > (uint64_t)(_end - p))) {
+            break;
+        }
+        if ((type == block_interface_description) && (len >= 20)) {
+            QString name;
+            parseInterfaceBlock(p, len, &name);
+            if (!name.isEmpty()) {
+                _interfaceMap.reserve(name);
+            }
+        }
+        p += len;
+    }
+    _swapped = swapped;
+}
+
+bool PcapTraceReader::readPacket(const char *data, uint32_t caplen, const PcapTraceReader::interface_t &intf, uint64_t ts, CanMessage &msg) const
+{
+    if ((intf.linktype != linktype_can_socketcan) || (caplen < can_header_size)) {
+        return false;
+    }
+
+    uint32_t can_id = qFromBigEndian<quint32>(data);
+    uint8_t len = data[4];
+    uint8_t fd_flags = data[5];
+    bool fd = (fd_flags & canfd_fdf) || (caplen > can_header_size + can_max_dlen) || (len > can_max_dlen);
+
+    if (len > canfd_max_dlen) {
+        len = canfd_max_dlen;
+    }
+    if (len > caplen - can_header_size) {
+        len = caplen - can_header_size;
+    }
+
+    msg.setRawId(can_id);
+    msg.setInterfaceId(intf.id);
+    msg.setFD(fd);
+    msg.setBRS(fd && (fd_flags & canfd_brs));
+    msg.setLength(len);
+    for (int i=0; i<len; i++) {
+        msg.setByte(i, data[can_header_size + i]);
+    }
+
+    msg.setTimestampNsecs(toNsecs(ts, intf.tsresol) + intf.tsoffset_s * timestamp_nsecs_per_sec);
+    return true;
+}
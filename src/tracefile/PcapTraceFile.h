@@ -0,0 +1,119 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <QFile>
+#include <QHash>
+#include <QList>
+#include <QVector>
+#include <QByteArray>
+#include <driver/CanDriver.h>
+#include "TraceFile.h"
+
+class Backend;
+class CanMessage;
+
+// PCAPNG / PCAP files with LINKTYPE_CAN_SOCKETCAN (227) packets, as captured
+// by tcpdump or Wireshark on SocketCAN interfaces.
+//
+// Each packet is the Linux can_frame / canfd_frame: can_id (big endian,
+// with the EFF/RTR/ERR flags in the upper bits, same as CanMessage raw ids),
+// payload length, CAN FD flags, two reserved bytes and the payload.
+class PcapngTraceWriter : public TraceFileWriter
+{
+public:
+    enum {
+        write_buffer_size = 1024*1024
+    };
+
+    PcapngTraceWriter();
+    virtual ~PcapngTraceWriter();
+
+    void setInterfaceName(CanInterfaceId id, const QString &name);
+
+    virtual bool open(const QString &filename);
+    virtual bool isOpen() const;
+    virtual bool close();
+
+    virtual bool addMessage(const CanMessage &msg);
+    virtual bool sync();
+
+    virtual uint64_t bytesWritten() const;
+    virtual QString errorString() const;
+
+private:
+    QFile _file;
+    QByteArray _buf;
+    uint64_t _bytesWritten;
+    QString _error;
+    QHash<CanInterfaceId, QString> _interfaceNames;
+    QHash<CanInterfaceId, uint32_t> _interfaceBlocks;
+
+    void writeInterfaceBlock(CanInterfaceId id);
+    bool writeBuffer();
+};
+
+class PcapTraceReader
+{
+public:
+    PcapTraceReader(Backend &backend);
+    ~PcapTraceReader();
+
+    bool open(const QString &filename);
+    void close();
+
+    int readMessages(QList<CanMessage> &msgs, int max_count);
+    bool atEnd() const;
+    int percentDone() const;
+
+    QString errorString() const;
+
+private:
+    typedef struct {
+        uint16_t linktype;
+        CanInterfaceId id;
+        uint8_t tsresol;
+        int64_t tsoffset_s;
+    } interface_t;
+
+    QFile _file;
+    QByteArray _buffer;
+    const char *_begin;
+    const char *_pos;
+    const char *_end;
+    bool _isPcapng;
+    bool _swapped;
+    bool _failed;
+    QVector<interface_t> _interfaces;
+    TraceFileInterfaceMap _interfaceMap;
+    QString _error;
+
+    uint16_t u16(const char *p) const;
+    uint32_t u32(const char *p) const;
+
+    bool readSectionHeader(const char *block, uint32_t len);
+    void readInterfaceBlock(const char *block, uint32_t len);
+    interface_t parseInterfaceBlock(const char *block, uint32_t len, QString *name) const;
+    void reserveInterfaceNames();
+    bool readPacket(const char *data, uint32_t caplen, const interface_t &intf, uint64_t ts, CanMessage &msg) const;
+};
@@ -0,0 +1,562 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "TraceExporter.h"
+
+#include <string.h>
+#include <QThread>
+#include <QThreadPool>
+#include <QVector>
+#include <QFile>
+#include <QLocale>
+#include <core/Backend.h>
+#include <core/CanMessage.h>
+#include <core/CanTraceFrame.h>
+#include <core/MeasurementSetup.h>
+#include <core/MeasurementNetwork.h>
+#include "TraceFile.h"
+#include "NativeTraceFile.h"
+#include "BlfTraceFile.h"
+#include "MdfTraceFile.h"
+#include "PcapTraceFile.h"
+
+// Lookup tables for the text formatters, so no printf-style parsing or
+// temporary strings are involved in formatting a frame.
+class TextFormatTables
+{
+public:
+    char hex_upper[256][2];
+    char dec[100][2];
+
+    TextFormatTables()
+    {
+        static const char digits[] = "0123456789ABCDEF";
+        for (int i=0; i<256; i++) {
+            hex_upper[i][0] = digits[i >> 4];
+            hex_upper[i][1] = digits[i & 0x0F];
+        }
+        for (int i=0; i<100; i++) {
+            dec[i][0] = '0' + (i / 10);
+            dec[i][1] = '0' + (i % 10);
+        }
+    }
+};
+
+static const TextFormatTables tables;
+
+static inline char *putString(char *p, const char *s, int len)
+{
+    memcpy(p, s, len);
+    return p + len;
+}
+
+static inline char *putHexByte(char *p, uint8_t b)
+{
+    p[0] = tables.hex_upper[b][0];
+    p[1] = tables.hex_upper[b][1];
+    return p + 2;
+}
+
+static inline char *putHex(char *p, uint32_t v, int min_digits, bool lowercase)
+{
+    const char *digits = lowercase ? "0123456789abcdef" : "0123456789ABCDEF";
+    int n = 1;
+    while ((n < 8) && (v >> (4*n))) {
+        n++;
+    }
+    if (n < min_digits) {
+        n = min_digits;
+    }
+    for (int i=n-1; i>=0; i--) {
+        *p++ = digits[(v >> (4*i)) & 0x0F];
+    }
+    return p;
+}
+
+static inline char *putDecimal(char *p, uint64_t v)
+{
+    char tmp[20];
+    char *t = tmp + sizeof(tmp);
+    while (v >= 100) {
+        t -= 2;
+        memcpy(t, tables.dec[v % 100], 2);
+        v /= 100;
+    }
+    if (v >= 10) {
+        t -= 2;
+        memcpy(t, tables.dec[v], 2);
+    } else {
+        *--t = '0' + v;
+    }
+    return putString(p, t, tmp + sizeof(tmp) - t);
+}
+
+// "seconds.microseconds", nanoseconds are truncated like formatTimestamp(p, nsecs, 6)
+static inline char *putSeconds(char *p, CanTimestamp nsecs)
+{
+    if (nsecs < 0) {
+        *p++ = '-';
+        nsecs = -nsecs;
+    }
+    int64_t usecs = nsecs / timestamp_nsecs_per_usec;
+    p = putDecimal(p, usecs / 1000000);
+    *p++ = '.';
+    uint32_t frac = usecs % 1000000;
+    p = putString(p, tables.dec[frac / 10000], 2);
+    p = putString(p, tables.dec[(frac / 100) % 100], 2);
+    return putString(p, tables.dec[frac % 100], 2);
+}
+
+static inline char *putPadded(char *p, const char *s, int len, int width, bool left_align)
+{
+    if (!left_align) {
+        for (int i=len; i<width; i++) {
+            *p++ = ' ';
+        }
+    }
+    p = putString(p, s, len);
+    if (left_align) {
+        for (int i=len; i<width; i++) {
+            *p++ = ' ';
+        }
+    }
+    return p;
+}
+
+
+TraceExporter::TraceExporter(Backend &backend, QObject *parent)
+  : QObject(parent),
+    _backend(backend),
+    _thread(0),
+    _cancelRequested(0),
+    _format(format_native),
+    _decodeSignals(false)
+{
+}
+
+TraceExporter::~TraceExporter()
+{
+    if (_thread) {
+        cancel();
+        _thread->wait();
+        delete _thread;
+    }
+}
+
+TraceExporter::format_t TraceExporter::formatForFileName(const QString &filename)
+{
+    if (filename.endsWith(".candump", Qt::CaseInsensitive)) {
+        return format_candump;
+    } else if (filename.endsWith(".asc", Qt::CaseInsensitive)) {
+        return format_vector_asc;
+    } else if (filename.endsWith(".blf", Qt::CaseInsensitive)) {
+        return format_blf;
+    } else if (filename.endsWith(".mf4", Qt::CaseInsensitive)) {
+        return format_mdf4;
+    } else if (filename.endsWith(".pcapng", Qt::CaseInsensitive)) {
+        return format_pcapng;
+    } else {
+        return format_native;
+    }
+}
+
+bool TraceExporter::start(const CanTraceSnapshot &snapshot, const QString &filename, TraceExporter::format_t format)
+{
+    if (isRunning()) {
+        return false;
+    }
+    delete _thread;
+
+    prepare(snapshot, filename, format);
+    _thread = new QThread();
+    connect(_thread, SIGNAL(started()), this, SLOT(run()), Qt::DirectConnection);
+    _thread->start();
+    return true;
+}
+
+bool TraceExporter::exportSnapshot(const CanTraceSnapshot &snapshot, const QString &filename, TraceExporter::format_t format)
+{
+    if (isRunning()) {
+        return false;
+    }
+
+    prepare(snapshot, filename, format);
+    bool retval = doExport();
+    _snapshot = CanTraceSnapshot();
+    _canDbs.clear();
+    return retval;
+}
+
+void TraceExporter::cancel()
+{
+    _cancelRequested.storeRelease(1);
+}
+
+void TraceExporter::setDecodeSignals(bool decode)
+{
+    _decodeSignals = decode;
+}
+
+bool TraceExporter::isRunning() const
+{
+    return _thread && _thread->isRunning();
+}
+
+QString TraceExporter::fileName() const
+{
+    return _fileName;
+}
+
+QString TraceExporter::errorString() const
+{
+    return _error;
+}
+
+void TraceExporter::run()
+{
+    bool success = doExport();
+    _snapshot = CanTraceSnapshot();
+    _canDbs.clear();
+    _thread->quit();
+    emit finished(success);
+}
+
+void TraceExporter::prepare(const CanTraceSnapshot &snapshot, const QString &filename, TraceExporter::format_t format)
+{
+    _snapshot = snapshot;
+    _fileName = filename;
+    _format = format;
+    _error.clear();
+    _cancelRequested.storeRelease(0);
+
+    // resolve names up front, formatter threads must not call into the backend
+    _interfaceNames.clear();
+    foreach (CanInterfaceId id, _backend.getInterfaceList()) {
+        _interfaceNames.insert(id, _backend.getInterfaceName(id).toUtf8());
+    }
+
+    // hold on to the databases, the setup may be changed while we export
+    _canDbs.clear();
+    if (_decodeSignals) {
+        MeasurementSetup &setup = _backend.getSetup();
+        for (int i=0; i<setup.countNetworks(); i++) {
+            _canDbs.append(setup.getNetwork(i)->_canDbs);
+        }
+    }
+}
+
+bool TraceExporter::doExport()
+{
+    bool success;
+    if (_format == format_native) {
+        success = exportNative();
+    } else if (_format == format_blf) {
+        success = exportBlf();
+    } else if (_format == format_mdf4) {
+        success = exportMdf();
+    } else if (_format == format_pcapng) {
+        success = exportPcapng();
+    } else {
+        QFile file(_fileName);
+        if (file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            success = exportText(file);
+            file.close();
+        } else {
+            _error = file.errorString();
+            return false;
+        }
+    }
+
+    if (!success) {
+        QFile::remove(_fileName);
+    }
+    return success;
+}
+
+bool TraceExporter::exportNative()
+{
+    NativeTraceWriter writer(_backend);
+    return exportBinary(writer);
+}
+
+bool TraceExporter::exportBlf()
+{
+    BlfTraceWriter writer(_backend);
+    return exportBinary(writer);
+}
+
+bool TraceExporter::exportMdf()
+{
+    MdfTraceWriter writer(_backend);
+    writer.setCanDbs(_canDbs);
+    return exportBinary(writer);
+}
+
+bool TraceExporter::exportPcapng()
+{
+    PcapngTraceWriter writer;
+    for (QHash<CanInterfaceId, QByteArray>::const_iterator it = _interfaceNames.constBegin(); it != _interfaceNames.constEnd(); ++it) {
+        writer.setInterfaceName(it.key(), QString::fromUtf8(it.value()));
+    }
+    return exportBinary(writer);
+}
+
+bool TraceExporter::exportBinary(TraceFileWriter &writer)
+{
+    if (!writer.open(_fileName)) {
+        _error = writer.errorString();
+        return false;
+    }
+
+    int total = _snapshot.size();
+    int last_percent = -1;
+    CanMessage msg;
+    for (int i=0; i<total; i++) {
+        if ((i % slice_size) == 0) {
+            if (_cancelRequested.loadAcquire()) {
+                _error = tr("Export cancelled");
+                return false;
+            }
+            reportProgress(i, &last_percent);
+        }
+
+        _snapshot.frame(i).toMessage(msg);
+        if (!writer.addMessage(msg)) {
+            _error = writer.errorString();
+            return false;
+        }
+    }
+
+    if (!writer.close()) {
+        _error = writer.errorString();
+        return false;
+    }
+    reportProgress(total, &last_percent);
+    return true;
+}
+
+bool TraceExporter::exportText(QFile &file)
+{
+    int total = _snapshot.size();
+    if (total == 0) {
+        return true;
+    }
+
+    if (_format == format_vector_asc) {
+        writeVectorAscHeader(file);
+    }
+
+    int num_slices = (total + slice_size - 1) / slice_size;
+    int batch_size = 2 * qMax(1, QThread::idealThreadCount());
+    QVector<QByteArray> buffers(batch_size);
+    QThreadPool pool;
+    int last_percent = -1;
+
+    for (int slice=0; slice<num_slices; slice+=batch_size) {
+        if (_cancelRequested.loadAcquire()) {
+            _error = tr("Export cancelled");
+            return false;
+        }
+
+        int batch = qMin(batch_size, num_slices - slice);
+        for (int i=0; i<batch; i++) {
+            int first = (slice + i) * slice_size;
+            int count = qMin((int)slice_size, total - first);
+            QByteArray *buf = &buffers[i];
+            pool.start([this, first, count, buf]() { formatSlice(first, count, *buf); });
+        }
+        pool.waitForDone();
+
+        for (int i=0; i<batch; i++) {
+            if (file.write(buffers[i]) != buffers[i].size()) {
+                _error = file.errorString();
+                return false;
+            }
+        }
+        reportProgress(qMin(total, (slice + batch) * slice_size), &last_percent);
+    }
+
+    if (_format == format_vector_asc) {
+        file.write("End TriggerBlock\n");
+    }
+    return true;
+}
+
+void TraceExporter::writeVectorAscHeader(QFile &file)
+{
+    CanMessage firstMessage;
+    _snapshot.frame(0).toMessage(firstMessage);
+
+    QLocale locale_c(QLocale::C);
+    QByteArray dt_start = locale_c.toString(firstMessage.getDateTime(), "ddd MMM dd hh:mm:ss.zzz ap yyyy").toUtf8();
+
+    QByteArray header;
+    header.append("date " + dt_start + "\n");
+    header.append("base hex  timestamps absolute\n");
+    header.append("internal events logged\n");
+    header.append("// version 8.5.0\n");
+    header.append("Begin Triggerblock " + dt_start + "\n");
+    header.append("   0.000000 Start of measurement\n");
+    file.write(header);
+}
+
+void TraceExporter::formatSlice(int first, int count, QByteArray &buf) const
+{
+    static const char asc_length[] = "  Length = 0 BitCount = 0 ID = ";
+    // <duration> <bit count> <flags: EDL, BRS> <crc> <bit timing> x4, only the flags are filled in
+    static const char asc_fd_tail[] = "       0    0     1000        0        0        0        0        0";
+    static const char asc_fd_tail_brs[] = "       0    0     3000        0        0        0        0        0";
+    // longest possible line apart from the interface name (64 byte CAN FD in ASC)
+    const int max_line = 64 + 64*3 + sizeof(asc_fd_tail) + 64;
+
+    CanTimestamp t_start = _snapshot.frame(0).getTimestampNsecs();
+
+    buf.resize(count * 48);
+    int used = 0;
+
+    for (int i=first; i<first+count; i++) {
+        const CanTraceFrame &frame = _snapshot.frame(i);
+        QHash<CanInterfaceId, QByteArray>::const_iterator intf = _interfaceNames.constFind(frame.getInterfaceId());
+        int name_len = (intf == _interfaceNames.constEnd()) ? 0 : intf.value().size();
+
+        if (buf.size() - used < max_line + name_len) {
+            buf.resize(2 * buf.size() + max_line + name_len);
+        }
+        char *line = buf.data() + used;
+        char *p = line;
+
+        uint8_t len = frame.getLength();
+        const uint8_t *data = frame.getData();
+
+        if (_format == format_candump) {
+            // (1436509053.249713) can0 12345678#DEADBEEF
+            // (1436509053.249713) can0 123##1DEADBEEF
+            *p++ = '(';
+            p = putSeconds(p, frame.getTimestampNsecs());
+            *p++ = ')';
+            *p++ = ' ';
+            if (name_len) {
+                p = putString(p, intf.value().constData(), name_len);
+            }
+            *p++ = ' ';
+            p = putHex(p, frame.getId(), frame.isExtended() ? 8 : 3, false);
+            *p++ = '#';
+            if (frame.isRTR()) {
+                // 123#R8, remote frame with its requested DLC
+                *p++ = 'R';
+                p = putDecimal(p, len);
+            } else {
+                if (frame.isFD()) {
+                    // 123##1DEADBEEF, flags nibble: bit 0 = BRS
+                    *p++ = '#';
+                    *p++ = frame.isBRS() ? '1' : '0';
+                }
+                for (int k=0; k<len; k++) {
+                    p = putHexByte(p, data[k]);
+                }
+            }
+        } else if (frame.isFD()) {
+            //    0.010000 CANFD   1 Rx        1a2x                                   1 0 9 12 01 02 ...       0    0     3000        0 ...
+            char tmp[32];
+            char *t = putSeconds(tmp, frame.getTimestampNsecs() - t_start);
+            p = putPadded(p, tmp, t - tmp, 11, false);
+            p = putString(p, frame.isRX() ? " CANFD   1 Rx   " : " CANFD   1 Tx   ", 16);
+
+            // no symbolic name
+            t = putHex(tmp, frame.getId(), 1, true);
+            if (frame.isExtended()) {
+                *t++ = 'x';
+            }
+            p = putPadded(p, tmp, t - tmp, 8, false);
+            p = putPadded(p, "", 0, 35, false);
+
+            *p++ = frame.isBRS() ? '1' : '0';
+            p = putString(p, " 0 ", 3);
+            p = putHex(p, TraceFile::lengthToDlc(len), 1, true);
+            *p++ = ' ';
+            t = putDecimal(tmp, len);
+            p = putPadded(p, tmp, t - tmp, 2, false);
+            *p++ = ' ';
+            for (int k=0; k<len; k++) {
+                p = putHexByte(p, data[k]);
+                *p++ = ' ';
+            }
+
+            if (frame.isBRS()) {
+                p = putString(p, asc_fd_tail_brs, sizeof(asc_fd_tail_brs)-1);
+            } else {
+                p = putString(p, asc_fd_tail, sizeof(asc_fd_tail)-1);
+            }
+        } else {
+            //    0.010000 1  1a2x            Rx   d 8 01 02 03 04 05 06 07 08   Length = 0 BitCount = 0 ID = 418x
+            //    0.020000 1  123             Tx   r 8   Length = 0 BitCount = 0 ID = 291
+            char tmp[32];
+            char *t = putSeconds(tmp, frame.getTimestampNsecs() - t_start);
+            p = putPadded(p, tmp, t - tmp, 11, false);
+            p = putString(p, " 1  ", 4);
+
+            t = putHex(tmp, frame.getId(), 1, true);
+            if (frame.isExtended()) {
+                *t++ = 'x';
+            }
+            p = putPadded(p, tmp, t - tmp, 15, true);
+
+            p = putString(p, frame.isRX() ? " Rx   " : " Tx   ", 6);
+            if (frame.isRTR()) {
+                // remote frames carry the requested DLC but no data
+                p = putString(p, "r ", 2);
+                p = putHex(p, len, 1, true);
+                *p++ = ' ';
+            } else {
+                p = putString(p, "d ", 2);
+                p = putDecimal(p, len);
+                *p++ = ' ';
+                for (int k=0; k<len; k++) {
+                    p = putHexByte(p, data[k]);
+                    *p++ = ' ';
+                }
+            }
+
+            // Length (transfer time) and BitCount depend on the bit rate and
+            // stuff bits, neither is in the trace; 0 marks them as unknown
+            p = putString(p, asc_length, sizeof(asc_length)-1);
+            p = putDecimal(p, frame.getId());
+            if (frame.isExtended()) {
+                *p++ = 'x';
+            }
+        }
+        *p++ = '\n';
+
+        used += p - line;
+    }
+
+    buf.resize(used);
+}
+
+void TraceExporter::reportProgress(int done, int *last_percent)
+{
+    int total = _snapshot.size();
+    int percent = (total > 0) ? (int)(((int64_t)done * 100) / total) : 100;
+    if (percent != *last_percent) {
+        *last_percent = percent;
+        emit progress(percent);
+    }
+}
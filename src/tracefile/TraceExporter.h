@@ -0,0 +1,109 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <QObject>
+#include <QString>
+#include <QHash>
+#include <QByteArray>
+#include <QAtomicInt>
+#include <core/CanTraceSnapshot.h>
+#include <core/CanDb.h>
+#include <driver/CanDriver.h>
+
+class QThread;
+class QFile;
+class Backend;
+class TraceFileWriter;
+
+// Writes a trace snapshot to a file.
+//
+// Export runs on its own thread and never touches the live trace, so
+// capture continues undisturbed. Text formats are produced in slices of
+// slice_size frames which are formatted in parallel into byte buffers and
+// then written in order.
+class TraceExporter : public QObject
+{
+    Q_OBJECT
+
+public:
+    typedef enum {
+        format_native,
+        format_candump,
+        format_vector_asc,
+        format_blf,
+        format_mdf4,
+        format_pcapng
+    } format_t;
+
+    enum {
+        slice_size = 16384
+    };
+
+    explicit TraceExporter(Backend &backend, QObject *parent = 0);
+    virtual ~TraceExporter();
+
+    static format_t formatForFileName(const QString &filename);
+
+    bool start(const CanTraceSnapshot &snapshot, const QString &filename, format_t format);
+    bool exportSnapshot(const CanTraceSnapshot &snapshot, const QString &filename, format_t format);
+    void setDecodeSignals(bool decode);
+    bool isRunning() const;
+    QString fileName() const;
+    QString errorString() const;
+
+public slots:
+    void cancel();
+
+signals:
+    void progress(int percent);
+    void finished(bool success);
+
+private slots:
+    void run();
+
+private:
+    Backend &_backend;
+    QThread *_thread;
+    QAtomicInt _cancelRequested;
+    QString _error;
+
+    CanTraceSnapshot _snapshot;
+    QString _fileName;
+    format_t _format;
+    QHash<CanInterfaceId, QByteArray> _interfaceNames;
+    bool _decodeSignals;
+    QList<pCanDb> _canDbs;
+
+    void prepare(const CanTraceSnapshot &snapshot, const QString &filename, format_t format);
+    bool doExport();
+    bool exportNative();
+    bool exportBlf();
+    bool exportMdf();
+    bool exportPcapng();
+    bool exportBinary(TraceFileWriter &writer);
+    bool exportText(QFile &file);
+    void writeVectorAscHeader(QFile &file);
+    void formatSlice(int first, int count, QByteArray &buf) const;
+    void reportProgress(int done, int *last_percent);
+};
@@ -0,0 +1,156 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "TraceFile.h"
+#include <QFile>
+#include <core/Backend.h>
+
+#if defined(Q_OS_WIN)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+static const uint8_t dlc_to_len[16] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48, 64 };
+
+uint8_t TraceFile::dlcToLength(uint8_t dlc)
+{
+    return dlc_to_len[dlc & 0x0F];
+}
+
+uint8_t TraceFile::lengthToDlc(uint8_t len)
+{
+    uint8_t dlc = 0;
+    while ((dlc < 15) && (dlc_to_len[dlc] < len)) {
+        dlc++;
+    }
+    return dlc;
+}
+
+bool TraceFile::syncFile(QFile &file)
+{
+    if (!file.flush()) {
+        return false;
+    }
+#if defined(Q_OS_WIN)
+    return _commit(file.handle()) == 0;
+#else
+    return fsync(file.handle()) == 0;
+#endif
+}
+
+TraceFileInterfaceMap::TraceFileInterfaceMap(Backend &backend)
+  : _backend(backend),
+    _interfaces(backend.getInterfaceList()),
+    _unknownNames(0)
+{
+}
+
+bool TraceFileInterfaceMap::isUsed(CanInterfaceId id) const
+{
+    foreach (CanInterfaceId used, _ids) {
+        if (used == id) {
+            return true;
+        }
+    }
+    return false;
+}
+
+CanInterfaceId TraceFileInterfaceMap::lookup(const QString &name)
+{
+    QHash<QString, CanInterfaceId>::const_iterator it = _ids.constFind(name);
+    if (it != _ids.constEnd()) {
+        return it.value();
+    }
+
+    CanInterfaceId id;
+    if (findInterface(name, &id)) {
+        _ids.insert(name, id);
+
+        // an unknown name seen earlier may have been given this interface,
+        // the file's own bus wins and the other name moves to a spare
+        foreach (const QString &spareName, _spareNames) {
+            if (_ids.value(spareName) == id) {
+                _ids.remove(spareName);
+                assignSpare(spareName);
+            }
+        }
+        return id;
+    }
+
+    if (_interfaces.isEmpty()) {
+        _ids.insert(name, 0);
+        return 0;
+    }
+
+    _spareNames.append(name);
+    return assignSpare(name);
+}
+
+void TraceFileInterfaceMap::reserve(const QString &name)
+{
+    CanInterfaceId id;
+    if (!_ids.contains(name) && findInterface(name, &id)) {
+        lookup(name);
+    }
+}
+
+bool TraceFileInterfaceMap::findInterface(const QString &name, CanInterfaceId *id) const
+{
+    foreach (CanInterfaceId candidate, _interfaces) {
+        if (_backend.getInterfaceName(candidate) == name) {
+            *id = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+CanInterfaceId TraceFileInterfaceMap::assignSpare(const QString &name)
+{
+    // prefer an interface no other name of this file maps to
+    CanInterfaceId result = _interfaces[_unknownNames++ % _interfaces.size()];
+    bool merged = true;
+    foreach (CanInterfaceId id, _interfaces) {
+        if (!isUsed(id)) {
+            result = id;
+            merged = false;
+            break;
+        }
+    }
+
+    if (merged) {
+        log_warning(QString("interface %1 of the trace file is not available, its frames are merged into %2").arg(name, _backend.getInterfaceName(result)));
+    } else {
+        log_warning(QString("interface %1 of the trace file is not available, its frames are shown on %2").arg(name, _backend.getInterfaceName(result)));
+    }
+
+    _ids.insert(name, result);
+    return result;
+}
+
+CanInterfaceId TraceFileInterfaceMap::lookupChannel(int channel)
+{
+    if ((channel >= 1) && (channel <= _interfaces.size())) {
+        return _interfaces[channel-1];
+    }
+    return _interfaces.isEmpty() ? 0 : _interfaces.first();
+}
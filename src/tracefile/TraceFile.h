@@ -0,0 +1,108 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QtEndian>
+#include <driver/CanDriver.h>
+
+class QFile;
+class Backend;
+class CanMessage;
+
+// Helpers shared by the trace file readers and writers.
+//
+// All binary formats handled here are little endian. Interface ids are only
+// meaningful within one cangaroo session, so files store interface names and
+// readers map them back to the interfaces known to the backend on load.
+class TraceFile
+{
+public:
+    static inline void putU8(QByteArray &buf, uint8_t v) { buf.append((char)v); }
+    static inline void putU16(QByteArray &buf, uint16_t v) { v = qToLittleEndian(v); buf.append((const char*)&v, sizeof(v)); }
+    static inline void putU32(QByteArray &buf, uint32_t v) { v = qToLittleEndian(v); buf.append((const char*)&v, sizeof(v)); }
+    static inline void putU64(QByteArray &buf, uint64_t v) { v = qToLittleEndian(v); buf.append((const char*)&v, sizeof(v)); }
+
+    static inline uint16_t getU16(const char *p) { return qFromLittleEndian<quint16>(p); }
+    static inline uint32_t getU32(const char *p) { return qFromLittleEndian<quint32>(p); }
+    static inline uint64_t getU64(const char *p) { return qFromLittleEndian<quint64>(p); }
+
+    // CAN FD data length code <-> payload length
+    static uint8_t dlcToLength(uint8_t dlc);
+    static uint8_t lengthToDlc(uint8_t len);
+
+    static bool syncFile(QFile &file);
+};
+
+// Common interface of the writers that can stream frames to disk, used by
+// the recorder and the exporter.
+class TraceFileWriter
+{
+public:
+    virtual ~TraceFileWriter() {}
+
+    virtual bool open(const QString &filename) = 0;
+    virtual bool isOpen() const = 0;
+    virtual bool close() = 0;
+
+    virtual bool addMessage(const CanMessage &msg) = 0;
+
+    // write out everything buffered and commit it to disk
+    virtual bool sync() = 0;
+
+    virtual uint64_t bytesWritten() const = 0;
+    virtual QString errorString() const = 0;
+};
+
+// Maps interface names (or 1-based channel numbers) found in a file to
+// interface ids of this session. Names without a matching interface get an
+// interface no other name of the file uses, so buses stay apart; only when
+// there are more buses than interfaces are some of them merged. Every
+// remapped name is logged.
+//
+// A name that matches an interface always gets it. Readers should reserve()
+// the names a file uses before looking up its frames; a name matched later
+// takes its interface back from an unknown name, whose following frames
+// then move to another spare.
+class TraceFileInterfaceMap
+{
+public:
+    TraceFileInterfaceMap(Backend &backend);
+    CanInterfaceId lookup(const QString &name);
+    CanInterfaceId lookupChannel(int channel);
+    void reserve(const QString &name);
+
+private:
+    Backend &_backend;
+    CanInterfaceIdList _interfaces;
+    QHash<QString, CanInterfaceId> _ids;
+    QStringList _spareNames;
+    int _unknownNames;
+
+    bool isUsed(CanInterfaceId id) const;
+    bool findInterface(const QString &name, CanInterfaceId *id) const;
+    CanInterfaceId assignSpare(const QString &name);
+};
@@ -0,0 +1,806 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "TraceImporter.h"
+
+#include <string.h>
+#include <QThread>
+#include <QThreadPool>
+#include <QVector>
+#include <QFile>
+#include <QLocale>
+#include <QDateTime>
+#include <core/Backend.h>
+#include <core/CanTrace.h>
+#include "TraceFile.h"
+#include "NativeTraceFile.h"
+#include "BlfTraceFile.h"
+#include "PcapTraceFile.h"
+
+enum {
+    id_flag_extended = 0x80000000,
+    id_flag_rtr      = 0x40000000,
+    id_flag_error    = 0x20000000,
+    id_mask_extended = 0x1FFFFFFF,
+    max_payload_size = 64,
+    asc_flag_edl     = 0x1000
+};
+
+// Lookup table for the line parsers: hex digit value, or -1
+class HexValueTable
+{
+public:
+    int8_t value[256];
+
+    HexValueTable()
+    {
+        for (int i=0; i<256; i++) {
+            value[i] = -1;
+        }
+        for (int i=0; i<10; i++) {
+            value['0'+i] = i;
+        }
+        for (int i=0; i<6; i++) {
+            value['a'+i] = 10+i;
+            value['A'+i] = 10+i;
+        }
+    }
+};
+
+static const HexValueTable hex_table;
+
+static inline int hexValue(char c)
+{
+    return hex_table.value[(uint8_t)c];
+}
+
+static inline bool isSpace(char c)
+{
+    return (c == ' ') || (c == '\t');
+}
+
+static inline const char *skipSpaces(const char *p, const char *end)
+{
+    while ((p < end) && isSpace(*p)) {
+        p++;
+    }
+    return p;
+}
+
+static inline const char *parseHex(const char *p, const char *end, uint32_t *value, int *digits)
+{
+    uint32_t v = 0;
+    int n = 0;
+    int d;
+    while ((p < end) && ((d = hexValue(*p)) >= 0)) {
+        v = (v << 4) | d;
+        n++;
+        p++;
+    }
+    *value = v;
+    *digits = n;
+    return p;
+}
+
+static inline const char *parseDecimal(const char *p, const char *end, uint32_t *value, int *digits)
+{
+    uint32_t v = 0;
+    int n = 0;
+    while ((p < end) && (*p >= '0') && (*p <= '9')) {
+        v = 10*v + (*p - '0');
+        n++;
+        p++;
+    }
+    *value = v;
+    *digits = n;
+    return p;
+}
+
+// "seconds[.fraction]" to nanoseconds, extra fraction digits are truncated
+static inline const char *parseTimestamp(const char *p, const char *end, CanTimestamp *nsecs)
+{
+    int64_t secs = 0;
+    int n = 0;
+    while ((p < end) && (*p >= '0') && (*p <= '9')) {
+        secs = 10*secs + (*p++ - '0');
+        n++;
+    }
+    if (n == 0) {
+        return 0;
+    }
+
+    int64_t frac = 0;
+    if ((p < end) && (*p == '.')) {
+        p++;
+        int frac_digits = 0;
+        while ((p < end) && (*p >= '0') && (*p <= '9')) {
+            if (frac_digits < 9) {
+                frac = 10*frac + (*p - '0');
+                frac_digits++;
+            }
+            p++;
+        }
+        while (frac_digits++ < 9) {
+            frac *= 10;
+        }
+    }
+
+    *nsecs = secs * timestamp_nsecs_per_sec + frac;
+    return p;
+}
+
+static inline const char *parseHexBytes(const char *p, const char *end, CanMessage &msg, int max_len, bool spaced)
+{
+    int len = 0;
+    while ((p+1 < end) && (len < max_len)) {
+        int hi = hexValue(p[0]);
+        int lo = hexValue(p[1]);
+        if ((hi < 0) || (lo < 0)) {
+            break;
+        }
+        msg.setByte(len++, (hi << 4) | lo);
+        p += 2;
+        if (spaced) {
+            p = skipSpaces(p, end);
+        }
+    }
+    msg.setLength(len);
+    return p;
+}
+
+
+TraceImporter::TraceImporter(Backend &backend, QObject *parent)
+  : QObject(parent),
+    _backend(backend),
+    _thread(0),
+    _cancelRequested(0),
+    _format(format_native),
+    _trace(0),
+    _framesImported(0),
+    _ascHexIds(true),
+    _ascRelativeTimestamps(false),
+    _ascStartTime_ns(0)
+{
+}
+
+TraceImporter::~TraceImporter()
+{
+    if (_thread) {
+        cancel();
+        _thread->wait();
+        delete _thread;
+    }
+}
+
+TraceImporter::format_t TraceImporter::formatForFileName(const QString &filename)
+{
+    if (filename.endsWith(".cgt", Qt::CaseInsensitive)) {
+        return format_native;
+    } else if (filename.endsWith(".asc", Qt::CaseInsensitive)) {
+        return format_vector_asc;
+    } else if (filename.endsWith(".blf", Qt::CaseInsensitive)) {
+        return format_blf;
+    } else if (filename.endsWith(".pcapng", Qt::CaseInsensitive) || filename.endsWith(".pcap", Qt::CaseInsensitive)) {
+        return format_pcap;
+    } else {
+        return format_candump;
+    }
+}
+
+bool TraceImporter::start(const QString &filename, TraceImporter::format_t format, CanTrace &trace)
+{
+    if (isRunning()) {
+        return false;
+    }
+    delete _thread;
+
+    prepare(filename, format, trace);
+    _thread = new QThread();
+    connect(_thread, SIGNAL(started()), this, SLOT(run()), Qt::DirectConnection);
+    _thread->start();
+    return true;
+}
+
+bool TraceImporter::importFile(const QString &filename, TraceImporter::format_t format, CanTrace &trace)
+{
+    if (isRunning()) {
+        return false;
+    }
+
+    prepare(filename, format, trace);
+    return doImport();
+}
+
+bool TraceImporter::isRunning() const
+{
+    return _thread && _thread->isRunning();
+}
+
+QString TraceImporter::fileName() const
+{
+    return _fileName;
+}
+
+QString TraceImporter::errorString() const
+{
+    return _error;
+}
+
+uint64_t TraceImporter::framesImported() const
+{
+    return _framesImported;
+}
+
+void TraceImporter::cancel()
+{
+    _cancelRequested.storeRelease(1);
+}
+
+void TraceImporter::run()
+{
+    bool success = doImport();
+    _thread->quit();
+    emit finished(success);
+}
+
+void TraceImporter::prepare(const QString &filename, TraceImporter::format_t format, CanTrace &trace)
+{
+    _fileName = filename;
+    _format = format;
+    _trace = &trace;
+    _framesImported = 0;
+    _error.clear();
+    _cancelRequested.storeRelease(0);
+}
+
+bool TraceImporter::doImport()
+{
+    if (_format == format_native) {
+        return importNative();
+    } else if (_format == format_blf) {
+        return importBlf();
+    } else if (_format == format_pcap) {
+        return importPcap();
+    } else {
+        return importText();
+    }
+}
+
+bool TraceImporter::importNative()
+{
+    NativeTraceReader reader(_backend);
+    if (!reader.open(_fileName)) {
+        _error = reader.errorString();
+        return false;
+    }
+    if (!reader.isIndexed()) {
+        log_warning(QString("Trace file %1 has no index, it was probably not closed properly").arg(_fileName));
+    }
+
+    QList<CanMessage> msgs;
+    for (int i=0; i<reader.blockCount(); i++) {
+        if (_cancelRequested.loadAcquire()) {
+            _error = tr("Import cancelled");
+            return false;
+        }
+
+        msgs.clear();
+        if (!reader.readBlock(i, msgs)) {
+            _error = reader.errorString();
+            return false;
+        }
+        _trace->enqueueMessages(msgs);
+        _framesImported += msgs.size();
+        emit progress((i+1) * 100 / reader.blockCount());
+    }
+    return true;
+}
+
+bool TraceImporter::importBlf()
+{
+    BlfTraceReader reader(_backend);
+    return importStream(reader);
+}
+
+bool TraceImporter::importPcap()
+{
+    PcapTraceReader reader(_backend);
+    return importStream(reader);
+}
+
+template <class T> bool TraceImporter::importStream(T &reader)
+{
+    if (!reader.open(_fileName)) {
+        _error = reader.errorString();
+        return false;
+    }
+
+    QList<CanMessage> msgs;
+    int last_percent = -1;
+    while (!reader.atEnd()) {
+        if (_cancelRequested.loadAcquire()) {
+            _error = tr("Import cancelled");
+            return false;
+        }
+
+        msgs.clear();
+        if (reader.readMessages(msgs, batch_frames) < 0) {
+            _error = reader.errorString();
+            return false;
+        }
+        _trace->enqueueMessages(msgs);
+        _framesImported += msgs.size();
+
+        int percent = reader.percentDone();
+        if (percent != last_percent) {
+            last_percent = percent;
+            emit progress(percent);
+        }
+    }
+    return true;
+}
+
+bool TraceImporter::importText()
+{
+    QFile file(_fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        _error = file.errorString();
+        return false;
+    }
+
+    qint64 size = file.size();
+    if (size == 0) {
+        return true;
+    }
+
+    // map the whole file, the OS pages it in as the parsers get to it
+    QByteArray buffer;
+    const char *begin = (const char *)file.map(0, size);
+    if (!begin) {
+        buffer = file.readAll();
+        begin = buffer.constData();
+        size = buffer.size();
+    }
+    const char *end = begin + size;
+
+    if (_format == format_vector_asc) {
+        parseAscHeader(begin, end);
+    }
+
+    TraceFileInterfaceMap interfaces(_backend);
+    CanTimestamp last_timestamp_ns = _ascStartTime_ns;
+    int last_percent = -1;
+
+    int batch_size = qMax(1, QThread::idealThreadCount());
+    QVector<slice_t> slices(batch_size);
+    QThreadPool pool;
+
+    const char *pos = begin;
+    while (pos < end) {
+        if (_cancelRequested.loadAcquire()) {
+            _error = tr("Import cancelled");
+            return false;
+        }
+
+        int batch = 0;
+        while ((batch < batch_size) && (pos < end)) {
+            slice_t &slice = slices[batch++];
+            slice.begin = pos;
+            slice.end = (end - pos > slice_bytes) ? pos + slice_bytes : end;
+            const char *nl = (const char *)memchr(slice.end, '\n', end - slice.end);
+            slice.end = nl ? nl + 1 : end;
+            pos = slice.end;
+
+            slice_t *s = &slice;
+            pool.start([this, s]() { parseSlice(*s); });
+        }
+        pool.waitForDone();
+
+        // names with a matching interface must not be handed out as spares
+        for (int i=0; i<batch; i++) {
+            foreach (const QByteArray &name, slices[i].interfaces) {
+                interfaces.reserve(QString::fromUtf8(name));
+            }
+        }
+
+        for (int i=0; i<batch; i++) {
+            finishSlice(slices[i], interfaces, &last_timestamp_ns);
+            _trace->enqueueMessages(slices[i].messages);
+            _framesImported += slices[i].messages.size();
+            slices[i].messages.clear();
+        }
+
+        int percent = (int)((pos - begin) * 100 / size);
+        if (percent != last_percent) {
+            last_percent = percent;
+            emit progress(percent);
+        }
+    }
+
+    return true;
+}
+
+void TraceImporter::parseAscHeader(const char *begin, const char *end)
+{
+    _ascHexIds = true;
+    _ascRelativeTimestamps = false;
+    _ascStartTime_ns = 0;
+
+    static const char *date_formats[] = {
+        "ddd MMM dd hh:mm:ss.zzz ap yyyy",
+        "ddd MMM d hh:mm:ss.zzz ap yyyy",
+        "ddd MMM dd hh:mm:ss ap yyyy",
+        "ddd MMM d hh:mm:ss ap yyyy",
+        "ddd MMM dd HH:mm:ss.zzz yyyy",
+        "ddd MMM d HH:mm:ss.zzz yyyy",
+        "ddd MMM dd HH:mm:ss yyyy",
+        "ddd MMM d HH:mm:ss yyyy"
+    };
+    QLocale locale_c(QLocale::C);
+
+    // header lines come before the first line starting with a timestamp
+    const char *p = begin;
+    while (p < end) {
+        const char *eol = (const char *)memchr(p, '\n', end - p);
+        if (!eol) {
+            eol = end;
+        }
+
+        const char *s = skipSpaces(p, eol);
+        if ((s < eol) && (*s >= '0') && (*s <= '9')) {
+            break;
+        }
+
+        QByteArray line = QByteArray(s, eol - s).trimmed();
+        if (line.startsWith("date ")) {
+            QString date = QString::fromLatin1(line.mid(5));
+            for (unsigned i=0; i<sizeof(date_formats)/sizeof(date_formats[0]); i++) {
+                QDateTime dt = locale_c.toDateTime(date, date_formats[i]);
+                if (dt.isValid()) {
+                    _ascStartTime_ns = dt.toMSecsSinceEpoch() * timestamp_nsecs_per_msec;
+                    break;
+                }
+            }
+        } else if (line.startsWith("base ")) {
+            _ascHexIds = !line.contains(" dec");
+            _ascRelativeTimestamps = line.contains("relative");
+        }
+
+        p = eol + 1;
+    }
+}
+
+void TraceImporter::parseSlice(TraceImporter::slice_t &slice) const
+{
+    slice.messages.clear();
+    slice.interfaces.clear();
+    slice.messages.reserve((slice.end - slice.begin) / 40);
+
+    const char *p = slice.begin;
+    while (p < slice.end) {
+        const char *eol = (const char *)memchr(p, '\n', slice.end - p);
+        if (!eol) {
+            eol = slice.end;
+        }
+
+        CanMessage msg;
+        bool ok = (_format == format_candump) ? parseCanDumpLine(p, eol, slice, msg) : parseAscLine(p, eol, msg);
+        if (ok) {
+            slice.messages.append(msg);
+        }
+
+        p = eol + 1;
+    }
+}
+
+// (1436509053.249713) can0 12345678#DEADBEEF
+// (1436509053.249713) can0 123##1DEADBEEF          CAN FD, flags nibble
+// (1436509053.249713) can0 123#R                   RTR, optional DLC
+bool TraceImporter::parseCanDumpLine(const char *p, const char *end, TraceImporter::slice_t &slice, CanMessage &msg) const
+{
+    p = skipSpaces(p, end);
+    if ((p >= end) || (*p++ != '(')) {
+        return false;
+    }
+
+    CanTimestamp t_ns;
+    p = parseTimestamp(p, end, &t_ns);
+    if (!p || (p >= end) || (*p++ != ')')) {
+        return false;
+    }
+
+    p = skipSpaces(p, end);
+    const char *name = p;
+    while ((p < end) && !isSpace(*p)) {
+        p++;
+    }
+    int name_len = p - name;
+    if (name_len == 0) {
+        return false;
+    }
+
+    p = skipSpaces(p, end);
+    uint32_t id;
+    int digits;
+    p = parseHex(p, end, &id, &digits);
+    if ((digits == 0) || (p >= end) || (*p++ != '#')) {
+        return false;
+    }
+
+    uint32_t raw_id;
+    if (digits > 3) {
+        // 8 digits: extended id or error frame, same flag bits as SocketCAN
+        raw_id = (id & id_flag_error) ? (id & (id_mask_extended | id_flag_error)) : ((id & id_mask_extended) | id_flag_extended);
+    } else {
+        raw_id = id;
+    }
+
+    if ((p < end) && (*p == '#')) {
+        p++;
+        if ((p >= end) || (hexValue(*p) < 0)) {
+            return false;
+        }
+        msg.setFD(true);
+        msg.setBRS((hexValue(*p) & 0x01) != 0);
+        p = parseHexBytes(p+1, end, msg, max_payload_size, false);
+    } else if ((p < end) && (*p == 'R')) {
+        raw_id |= id_flag_rtr;
+        int dlc = ((p+1 < end) && (p[1] >= '0') && (p[1] <= '8')) ? p[1] - '0' : 0;
+        msg.setLength(dlc);
+    } else {
+        p = parseHexBytes(p, end, msg, 8, false);
+    }
+
+    msg.setRawId(raw_id);
+    msg.setTimestampNsecs(t_ns);
+
+    // interface ids are slice local until finishSlice() maps the names
+    QByteArray intf = QByteArray::fromRawData(name, name_len);
+    int intf_idx = slice.interfaces.indexOf(intf);
+    if (intf_idx < 0) {
+        intf_idx = slice.interfaces.size();
+        slice.interfaces.append(QByteArray(name, name_len));
+    }
+    msg.setInterfaceId(intf_idx);
+
+    return true;
+}
+
+static inline bool isAscKeyword(const char *p, const char *end, const char *keyword, int len)
+{
+    return (end - p > len) && (memcmp(p, keyword, len) == 0) && isSpace(p[len]);
+}
+
+// "Rx" / "Tx", sets the direction of msg
+static inline const char *parseAscDirection(const char *p, const char *end, CanMessage &msg)
+{
+    if ((end - p < 2) || ((p[0] != 'R') && (p[0] != 'T')) || (p[1] != 'x')) {
+        return 0;
+    }
+    msg.setRX(p[0] == 'R');
+    while ((p < end) && !isSpace(*p)) {
+        p++;
+    }
+    return p;
+}
+
+//    0.010000 1  1a2x            Rx   d 8 01 02 03 04 05 06 07 08  Length = 0 BitCount = 0 ID = 418x
+//    0.020000 1  123             Tx   r 8
+//    0.030000 CANFD   1 Rx        1a2x                                   1 0 9 12 01 02 ...
+bool TraceImporter::parseAscLine(const char *p, const char *end, CanMessage &msg) const
+{
+    p = skipSpaces(p, end);
+    CanTimestamp t_ns;
+    p = parseTimestamp(p, end, &t_ns);
+    if (!p) {
+        return false;
+    }
+    msg.setTimestampNsecs(t_ns);
+
+    p = skipSpaces(p, end);
+    if (isAscKeyword(p, end, "CANFD", 5)) {
+        return parseAscFdLine(p+5, end, msg);
+    }
+
+    // channel; this also skips event lines like "Start of measurement", ...
+    uint32_t channel;
+    int digits;
+    p = parseDecimal(p, end, &channel, &digits);
+    if ((digits == 0) || (p >= end) || !isSpace(*p)) {
+        return false;
+    }
+
+    p = skipSpaces(p, end);
+    uint32_t id;
+    p = _ascHexIds ? parseHex(p, end, &id, &digits) : parseDecimal(p, end, &id, &digits);
+    if (digits == 0) {
+        return false;
+    }
+    uint32_t raw_id = id;
+    if ((p < end) && (*p == 'x')) {
+        raw_id = (id & id_mask_extended) | id_flag_extended;
+        p++;
+    }
+    if ((p >= end) || !isSpace(*p)) {
+        return false; // e.g. "ErrorFrame"
+    }
+
+    // direction
+    p = parseAscDirection(skipSpaces(p, end), end, msg);
+    if (!p) {
+        return false;
+    }
+
+    p = skipSpaces(p, end);
+    if ((p >= end) || ((*p != 'd') && (*p != 'r'))) {
+        return false;
+    }
+    bool rtr = (*p++ == 'r');
+
+    p = skipSpaces(p, end);
+    int dlc = (p < end) ? hexValue(*p) : -1;
+    if (rtr) {
+        raw_id |= id_flag_rtr;
+        msg.setLength((dlc >= 0) && (dlc <= 8) ? dlc : 0);
+    } else {
+        // a single hex DLC digit, DLCs above 8 still mean 8 bytes. Older
+        // cangaroo versions wrote CAN FD frames here with their decimal
+        // length ("d 64"), those are read back as FD frames.
+        uint32_t len;
+        const char *len_end = parseDecimal(p, end, &len, &digits);
+        if (digits == 2) {
+            if ((len > max_payload_size) || (TraceFile::dlcToLength(TraceFile::lengthToDlc(len)) != len)) {
+                return false;
+            }
+            msg.setFD(true);
+            p = len_end;
+        } else if (dlc >= 0) {
+            len = (dlc > 8) ? 8 : dlc;
+            p++;
+        } else {
+            return false;
+        }
+        if ((p < end) && !isSpace(*p) && (*p != '\r')) {
+            return false;
+        }
+        p = parseHexBytes(skipSpaces(p, end), end, msg, len, true);
+        if (msg.getLength() != len) {
+            return false;
+        }
+    }
+
+    msg.setRawId(raw_id);
+    msg.setInterfaceId(channel);
+    return true;
+}
+
+// CANFD <channel> <dir> <id> [<symbolic name>] <brs> <esi> <dlc> <data length> <data> ...
+// <duration> <bit count> <flags> <crc> <bit timing> ..., only the flags are used
+bool TraceImporter::parseAscFdLine(const char *p, const char *end, CanMessage &msg) const
+{
+    p = skipSpaces(p, end);
+    uint32_t channel;
+    int digits;
+    p = parseDecimal(p, end, &channel, &digits);
+    if ((digits == 0) || (p >= end) || !isSpace(*p)) {
+        return false;
+    }
+
+    p = parseAscDirection(skipSpaces(p, end), end, msg);
+    if (!p) {
+        return false;
+    }
+
+    p = skipSpaces(p, end);
+    uint32_t id;
+    p = _ascHexIds ? parseHex(p, end, &id, &digits) : parseDecimal(p, end, &id, &digits);
+    if (digits == 0) {
+        return false;
+    }
+    uint32_t raw_id = id;
+    if ((p < end) && (*p == 'x')) {
+        raw_id = (id & id_mask_extended) | id_flag_extended;
+        p++;
+    }
+    if ((p >= end) || !isSpace(*p)) {
+        return false; // e.g. "ErrorFrame"
+    }
+
+    // the symbolic name is optional, the BRS field is the first numeric one
+    p = skipSpaces(p, end);
+    if ((p < end) && ((*p < '0') || (*p > '9'))) {
+        while ((p < end) && !isSpace(*p)) {
+            p++;
+        }
+        p = skipSpaces(p, end);
+    }
+
+    uint32_t brs, esi, len;
+    p = parseDecimal(p, end, &brs, &digits);
+    if (digits != 1) {
+        return false;
+    }
+    p = parseDecimal(skipSpaces(p, end), end, &esi, &digits);
+    if (digits != 1) {
+        return false;
+    }
+    p = skipSpaces(p, end);
+    int dlc = (p < end) ? hexValue(*p) : -1;
+    if (dlc < 0) {
+        return false;
+    }
+    p = parseDecimal(skipSpaces(p+1, end), end, &len, &digits);
+    if ((digits == 0) || (len > max_payload_size)) {
+        return false;
+    }
+
+    p = parseHexBytes(skipSpaces(p, end), end, msg, len, true);
+    if (msg.getLength() != len) {
+        return false;
+    }
+
+    // <duration> <bit count> <flags>: classic frames are logged as CANFD
+    // lines as well, only the EDL flag tells them apart
+    uint32_t duration, bit_count, flags;
+    p = parseDecimal(p, end, &duration, &digits);
+    p = parseDecimal(skipSpaces(p, end), end, &bit_count, &digits);
+    p = parseHex(skipSpaces(p, end), end, &flags, &digits);
+    if (digits > 0) {
+        msg.setFD((flags & asc_flag_edl) != 0);
+    } else {
+        msg.setFD((len > 8) || (dlc > 8) || (brs != 0));
+    }
+    msg.setBRS(msg.isFD() && (brs != 0));
+
+    msg.setRawId(raw_id);
+    msg.setInterfaceId(channel);
+    return true;
+}
+
+void TraceImporter::finishSlice(TraceImporter::slice_t &slice, TraceFileInterfaceMap &interfaces, CanTimestamp *last_timestamp_ns)
+{
+    if (_format == format_candump) {
+        QVector<CanInterfaceId> ids;
+        foreach (const QByteArray &name, slice.interfaces) {
+            ids.append(interfaces.lookup(QString::fromUtf8(name)));
+        }
+        for (int i=0; i<slice.messages.size(); i++) {
+            CanMessage &msg = slice.messages[i];
+            msg.setInterfaceId(ids[msg.getInterfaceId()]);
+        }
+    } else {
+        // ASC timestamps are relative to the header date, or to the
+        // previous line; only known once the slices are put in order
+        for (int i=0; i<slice.messages.size(); i++) {
+            CanMessage &msg = slice.messages[i];
+            msg.setInterfaceId(interfaces.lookupChannel(msg.getInterfaceId()));
+
+            CanTimestamp t_ns = msg.getTimestampNsecs();
+            if (_ascRelativeTimestamps) {
+                t_ns += *last_timestamp_ns;
+                *last_timestamp_ns = t_ns;
+            } else {
+                t_ns += _ascStartTime_ns;
+            }
+            msg.setTimestampNsecs(t_ns);
+        }
+    }
+}
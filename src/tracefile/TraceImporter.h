@@ -0,0 +1,120 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <QObject>
+#include <QString>
+#include <QList>
+#include <QByteArray>
+#include <QAtomicInt>
+#include <core/CanMessage.h>
+
+class QThread;
+class Backend;
+class CanTrace;
+class TraceFileInterfaceMap;
+
+// Reads trace files into a CanTrace.
+//
+// Text formats (candump log, Vector ASC) are memory mapped and split into
+// slices on line boundaries. Slices are parsed in parallel and appended to
+// the trace in file order. Native trace files are read block by block,
+// BLF files container by container and pcap/pcapng files packet by packet.
+class TraceImporter : public QObject
+{
+    Q_OBJECT
+
+public:
+    typedef enum {
+        format_native,
+        format_candump,
+        format_vector_asc,
+        format_blf,
+        format_pcap
+    } format_t;
+
+    enum {
+        slice_bytes = 4*1024*1024,
+        batch_frames = 65536
+    };
+
+    explicit TraceImporter(Backend &backend, QObject *parent = 0);
+    virtual ~TraceImporter();
+
+    static format_t formatForFileName(const QString &filename);
+
+    bool start(const QString &filename, format_t format, CanTrace &trace);
+    bool importFile(const QString &filename, format_t format, CanTrace &trace);
+    bool isRunning() const;
+    QString fileName() const;
+    QString errorString() const;
+    uint64_t framesImported() const;
+
+public slots:
+    void cancel();
+
+signals:
+    void progress(int percent);
+    void finished(bool success);
+
+private slots:
+    void run();
+
+private:
+    typedef struct {
+        const char *begin;
+        const char *end;
+        QList<CanMessage> messages;
+        QList<QByteArray> interfaces;
+    } slice_t;
+
+    Backend &_backend;
+    QThread *_thread;
+    QAtomicInt _cancelRequested;
+    QString _error;
+
+    QString _fileName;
+    format_t _format;
+    CanTrace *_trace;
+    uint64_t _framesImported;
+
+    // Vector ASC header settings
+    bool _ascHexIds;
+    bool _ascRelativeTimestamps;
+    CanTimestamp _ascStartTime_ns;
+
+    void prepare(const QString &filename, format_t format, CanTrace &trace);
+    bool doImport();
+    bool importNative();
+    bool importBlf();
+    bool importPcap();
+    template <class T> bool importStream(T &reader);
+    bool importText();
+
+    void parseAscHeader(const char *begin, const char *end);
+    void parseSlice(slice_t &slice) const;
+    bool parseCanDumpLine(const char *p, const char *end, slice_t &slice, CanMessage &msg) const;
+    bool parseAscLine(const char *p, const char *end, CanMessage &msg) const;
+    bool parseAscFdLine(const char *p, const char *end, CanMessage &msg) const;
+    void finishSlice(slice_t &slice, TraceFileInterfaceMap &interfaces, CanTimestamp *last_timestamp_ns);
+};
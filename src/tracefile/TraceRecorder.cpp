@@ -0,0 +1,279 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "TraceRecorder.h"
+
+#include <QThread>
+#include <QFileInfo>
+#include <QDir>
+#include <QElapsedTimer>
+#include <core/Backend.h>
+#include <core/CanTrace.h>
+#include <core/CanTraceFrame.h>
+#include <core/CanMessage.h>
+#include "NativeTraceFile.h"
+#include "BlfTraceFile.h"
+
+TraceRecorder::TraceRecorder(Backend &backend, QObject *parent)
+  : QObject(parent),
+    _backend(backend),
+    _trace(0),
+    _thread(0),
+    _shouldBeRunning(false),
+    _enabled(false),
+    _rotationMode(rotate_none),
+    _rotationLimit(0)
+{
+    qRegisterMetaType<log_level_t>("log_level_t");
+}
+
+TraceRecorder::~TraceRecorder()
+{
+    stop();
+}
+
+bool TraceRecorder::isEnabled() const
+{
+    return _enabled;
+}
+
+void TraceRecorder::setEnabled(bool enabled)
+{
+    _enabled = enabled;
+}
+
+QString TraceRecorder::fileName() const
+{
+    return _fileName;
+}
+
+void TraceRecorder::setFileName(const QString &filename)
+{
+    _fileName = filename;
+}
+
+TraceRecorder::rotation_mode_t TraceRecorder::rotationMode() const
+{
+    return _rotationMode;
+}
+
+uint64_t TraceRecorder::rotationLimit() const
+{
+    return _rotationLimit;
+}
+
+void TraceRecorder::setRotation(rotation_mode_t mode, uint64_t limit)
+{
+    if (limit == 0) {
+        mode = rotate_none;
+    }
+    _rotationMode = mode;
+    _rotationLimit = (mode == rotate_none) ? 0 : limit;
+}
+
+bool TraceRecorder::start(CanTrace &trace)
+{
+    if (isRunning() || !_enabled) {
+        return false;
+    }
+    if (_fileName.isEmpty()) {
+        log_error(tr("Recording enabled, but no file name set"));
+        return false;
+    }
+
+    // the trace emits messagesEnqueued with its mutex held, so this queue
+    // only ever sees one producer at a time
+    _trace = &trace;
+    _queue.resetDroppedCount();
+    connect(_trace, SIGNAL(messagesEnqueued(int,int)), this, SLOT(onMessagesEnqueued(int,int)), Qt::DirectConnection);
+
+    _shouldBeRunning = true;
+    _thread = new QThread();
+    connect(_thread, SIGNAL(started()), this, SLOT(run()), Qt::DirectConnection);
+    _thread->start(QThread::LowPriority);
+    return true;
+}
+
+void TraceRecorder::stop()
+{
+    if (!isRunning()) {
+        return;
+    }
+
+    disconnect(_trace, SIGNAL(messagesEnqueued(int,int)), this, SLOT(onMessagesEnqueued(int,int)));
+    _trace = 0;
+
+    _shouldBeRunning = false;
+    _thread->wait();
+    delete _thread;
+    _thread = 0;
+
+    if (_queue.droppedCount()) {
+        log_warning(QString(tr("Recorder could not keep up, %1 frames are missing from the recording")).arg(_queue.droppedCount()));
+    }
+}
+
+bool TraceRecorder::isRunning() const
+{
+    return _thread != 0;
+}
+
+uint64_t TraceRecorder::droppedFrames() const
+{
+    return _queue.droppedCount();
+}
+
+bool TraceRecorder::saveXML(Backend &backend, QDomDocument &xml, QDomElement &root)
+{
+    (void) backend;
+    (void) xml;
+
+    root.setAttribute("enabled", _enabled ? 1 : 0);
+    root.setAttribute("filename", _fileName);
+    switch (_rotationMode) {
+        case rotate_size: root.setAttribute("rotate", "size"); break;
+        case rotate_time: root.setAttribute("rotate", "time"); break;
+        default: root.setAttribute("rotate", "none"); break;
+    }
+    root.setAttribute("rotate-limit", QString::number(_rotationLimit));
+    return true;
+}
+
+bool TraceRecorder::loadXML(Backend &backend, QDomElement &el)
+{
+    (void) backend;
+
+    _enabled = el.attribute("enabled", "0").toInt() != 0;
+    _fileName = el.attribute("filename");
+
+    QString mode = el.attribute("rotate", "none");
+    uint64_t limit = el.attribute("rotate-limit", "0").toULongLong();
+    if (mode == "size") {
+        setRotation(rotate_size, limit);
+    } else if (mode == "time") {
+        setRotation(rotate_time, limit);
+    } else {
+        setRotation(rotate_none, 0);
+    }
+    return true;
+}
+
+void TraceRecorder::onMessagesEnqueued(int first_idx, int num_messages)
+{
+    CanMessage msg;
+    for (int i=first_idx; i<first_idx+num_messages; i++) {
+        _trace->getMessage(i)->toMessage(msg);
+        _queue.push(msg); // never blocks, counts the frame as dropped when full
+    }
+}
+
+void TraceRecorder::run()
+{
+    TraceFileWriter *writer = createWriter();
+    QElapsedTimer syncTimer;
+    QElapsedTimer segmentTimer;
+    int segment = 0;
+
+    while (_shouldBeRunning || _queue.available()) {
+
+        if (!writer->isOpen()) {
+            QString filename = segmentFileName(++segment);
+            if (!writer->open(filename)) {
+                postLog(log_level_error, QString(tr("Cannot open recording file %1: %2")).arg(filename, writer->errorString()));
+                break;
+            }
+            postLog(log_level_info, QString(tr("Recording to %1")).arg(filename));
+            segmentTimer.start();
+            syncTimer.start();
+        }
+
+        int count = _queue.available();
+        if (count == 0) {
+            QThread::msleep(idle_sleep_ms);
+        }
+
+        for (int i=0; i<count; i++) {
+            writer->addMessage(_queue.at(i));
+        }
+        _queue.release(count);
+
+        if (syncTimer.elapsed() >= sync_interval_ms) {
+            if (!writer->sync()) {
+                postLog(log_level_error, QString(tr("Error writing recording: %1")).arg(writer->errorString()));
+                break;
+            }
+            syncTimer.restart();
+        }
+
+        bool rotate = false;
+        if (_rotationMode == rotate_size) {
+            rotate = writer->bytesWritten() >= _rotationLimit;
+        } else if (_rotationMode == rotate_time) {
+            rotate = (uint64_t)segmentTimer.elapsed() >= _rotationLimit;
+        }
+        if (rotate) {
+            writer->close();
+        }
+    }
+
+    writer->close();
+    delete writer;
+
+    // if writing failed, keep draining so the trace does not need to care
+    while (_shouldBeRunning) {
+        _queue.release(_queue.available());
+        QThread::msleep(idle_sleep_ms);
+    }
+
+    _thread->quit();
+}
+
+void TraceRecorder::postLog(log_level_t level, const QString &msg)
+{
+    // run() is executed by the writer thread, the log window must only be
+    // touched from the thread this object lives in
+    QMetaObject::invokeMethod(this, "onWriterLog", Qt::QueuedConnection, Q_ARG(log_level_t, level), Q_ARG(QString, msg));
+}
+
+void TraceRecorder::onWriterLog(log_level_t level, QString msg)
+{
+    log_msg(level, msg);
+}
+
+TraceFileWriter *TraceRecorder::createWriter() const
+{
+    if (_fileName.endsWith(".blf", Qt::CaseInsensitive)) {
+        return new BlfTraceWriter(_backend);
+    } else {
+        return new NativeTraceWriter(_backend);
+    }
+}
+
+QString TraceRecorder::segmentFileName(int segment) const
+{
+    if (_rotationMode == rotate_none) {
+        return _fileName;
+    }
+
+    QFileInfo fi(_fileName);
+    QString suffix = fi.suffix().isEmpty() ? QString("cgt") : fi.suffix();
+    return fi.dir().filePath(QString("%1_%2.%3").arg(fi.completeBaseName()).arg(segment, 4, 10, QChar('0')).arg(suffix));
+}
@@ -0,0 +1,100 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <QObject>
+#include <QString>
+#include <QDomDocument>
+#include <core/CanMessageQueue.h>
+#include <core/Log.h>
+
+class QThread;
+class Backend;
+class CanTrace;
+class TraceFileWriter;
+
+// Streams all frames of a running measurement to trace files, in the native
+// format or as Vector BLF when the file name ends in .blf.
+//
+// Frames are copied into a fixed size queue when the trace takes them in, a
+// dedicated thread compresses and writes them. If the disk cannot keep up,
+// frames are dropped from the recording rather than stalling capture.
+// Pending data is committed to disk every sync_interval_ms.
+class TraceRecorder : public QObject
+{
+    Q_OBJECT
+
+public:
+    typedef enum {
+        rotate_none,
+        rotate_size,
+        rotate_time
+    } rotation_mode_t;
+
+    enum {
+        sync_interval_ms = 200,
+        idle_sleep_ms = 20
+    };
+
+    explicit TraceRecorder(Backend &backend, QObject *parent = 0);
+    virtual ~TraceRecorder();
+
+    bool isEnabled() const;
+    void setEnabled(bool enabled);
+
+    QString fileName() const;
+    void setFileName(const QString &filename);
+
+    rotation_mode_t rotationMode() const;
+    uint64_t rotationLimit() const;
+    void setRotation(rotation_mode_t mode, uint64_t limit);
+
+    bool start(CanTrace &trace);
+    void stop();
+    bool isRunning() const;
+    uint64_t droppedFrames() const;
+
+    bool saveXML(Backend &backend, QDomDocument &xml, QDomElement &root);
+    bool loadXML(Backend &backend, QDomElement &el);
+
+private slots:
+    void onMessagesEnqueued(int first_idx, int num_messages);
+    void run();
+    void onWriterLog(log_level_t level, QString msg);
+
+private:
+    Backend &_backend;
+    CanTrace *_trace;
+    QThread *_thread;
+    CanMessageQueue _queue;
+    volatile bool _shouldBeRunning;
+
+    bool _enabled;
+    QString _fileName;
+    rotation_mode_t _rotationMode;
+    uint64_t _rotationLimit;
+
+    void postLog(log_level_t level, const QString &msg);
+    TraceFileWriter *createWriter() const;
+    QString segmentFileName(int segment) const;
+};
@@ -0,0 +1,537 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "TraceReplay.h"
+
+#include <string.h>
+#include <algorithm>
+#include <QThread>
+#include <QStringList>
+#include <QElapsedTimer>
+#include <core/Backend.h>
+#include <core/CanMessage.h>
+#include <core/CanTraceFrame.h>
+#include <driver/CanInterface.h>
+#include "TraceStreamReader.h"
+
+enum {
+    id_flag_extended = 0x80000000,
+    id_flag_rtr      = 0x40000000,
+    id_mask_standard = 0x000007FF,
+    id_mask_extended = 0x1FFFFFFF
+};
+
+// ids of the filter and mapping are raw ids, bit 31 marks extended ids.
+// Ids beyond the 11 bit range can only be extended, older workspaces
+// stored those without the flag.
+static uint32_t normalizedId(uint32_t raw_id)
+{
+    raw_id &= id_flag_extended | id_mask_extended;
+    if ((raw_id & id_mask_extended) > id_mask_standard) {
+        raw_id |= id_flag_extended;
+    }
+    return raw_id;
+}
+
+#if defined(Q_OS_LINUX)
+#include <errno.h>
+#include <time.h>
+
+static int64_t monotonicNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void sleepUntilNs(int64_t deadline_ns)
+{
+    struct timespec ts;
+    ts.tv_sec = deadline_ns / 1000000000;
+    ts.tv_nsec = deadline_ns % 1000000000;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, 0) == EINTR) {
+    }
+}
+#else
+static QElapsedTimer monotonicClock;
+
+static int64_t monotonicNs()
+{
+    if (!monotonicClock.isValid()) {
+        monotonicClock.start();
+    }
+    return monotonicClock.nsecsElapsed();
+}
+
+static void sleepUntilNs(int64_t deadline_ns)
+{
+    int64_t delta_ns = deadline_ns - monotonicNs();
+    if (delta_ns > 0) {
+        QThread::usleep(delta_ns / 1000);
+    }
+}
+#endif
+
+
+TraceReplay::TraceReplay(Backend &backend, QObject *parent)
+  : QObject(parent),
+    _backend(backend),
+    _thread(0),
+    _loaderThread(0),
+    _shouldBeRunning(false),
+    _sourceDone(0),
+    _target(0),
+    _speed(1.0),
+    _loop(false),
+    _rebase(true),
+    _hasLastTimestamp(false),
+    _shift_ns(0),
+    _last_ns(0)
+{
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+TraceReplay::~TraceReplay()
+{
+    stop();
+}
+
+void TraceReplay::setSnapshot(const CanTraceSnapshot &snapshot)
+{
+    _snapshot = snapshot;
+    _fileName.clear();
+}
+
+void TraceReplay::setFileName(const QString &filename)
+{
+    _fileName = filename;
+    _snapshot = CanTraceSnapshot();
+}
+
+QString TraceReplay::fileName() const
+{
+    return _fileName;
+}
+
+bool TraceReplay::canStream(const QString &filename)
+{
+    return TraceStreamReader::canStream(filename);
+}
+
+CanInterfaceId TraceReplay::targetInterface() const
+{
+    return _target;
+}
+
+void TraceReplay::setTargetInterface(CanInterfaceId id)
+{
+    _target = id;
+}
+
+double TraceReplay::speed() const
+{
+    return _speed;
+}
+
+void TraceReplay::setSpeed(double speed)
+{
+    _speed = (speed > 0) ? speed : 0;
+}
+
+bool TraceReplay::isLooping() const
+{
+    return _loop;
+}
+
+void TraceReplay::setLooping(bool loop)
+{
+    _loop = loop;
+}
+
+void TraceReplay::setIdFilter(const QSet<uint32_t> &ids)
+{
+    _idFilter.clear();
+    foreach (uint32_t id, ids) {
+        _idFilter.insert(normalizedId(id));
+    }
+}
+
+void TraceReplay::setIdMapping(const QHash<uint32_t, uint32_t> &mapping)
+{
+    _idMapping.clear();
+    for (QHash<uint32_t, uint32_t>::const_iterator it = mapping.constBegin(); it != mapping.constEnd(); ++it) {
+        _idMapping.insert(normalizedId(it.key()), normalizedId(it.value()));
+    }
+}
+
+QString TraceReplay::idFilterString() const
+{
+    QList<uint32_t> ids = _idFilter.values();
+    std::sort(ids.begin(), ids.end());
+
+    QStringList items;
+    foreach (uint32_t id, ids) {
+        items << QString("0x%1").arg(id, 0, 16);
+    }
+    return items.join(' ');
+}
+
+bool TraceReplay::setIdFilterString(const QString &spec, QString &error)
+{
+    QSet<uint32_t> ids;
+    foreach (QString item, spec.split(' ', Qt::SkipEmptyParts)) {
+        bool ok = false;
+        uint32_t id = item.toUInt(&ok, 0);
+        if (!ok) {
+            error = QString("not an id: %1").arg(item);
+            return false;
+        }
+        ids.insert(id);
+    }
+    setIdFilter(ids);
+    return true;
+}
+
+QString TraceReplay::idMappingString() const
+{
+    QList<uint32_t> from = _idMapping.keys();
+    std::sort(from.begin(), from.end());
+
+    QStringList items;
+    foreach (uint32_t id, from) {
+        items << QString("0x%1=0x%2").arg(id, 0, 16).arg(_idMapping.value(id), 0, 16);
+    }
+    return items.join(' ');
+}
+
+bool TraceReplay::setIdMappingString(const QString &spec, QString &error)
+{
+    QHash<uint32_t, uint32_t> mapping;
+    foreach (QString item, spec.split(' ', Qt::SkipEmptyParts)) {
+        int eq = item.indexOf('=');
+        bool ok_from = false;
+        bool ok_to = false;
+        uint32_t from = (eq > 0) ? item.left(eq).toUInt(&ok_from, 0) : 0;
+        uint32_t to = (eq > 0) ? item.mid(eq + 1).toUInt(&ok_to, 0) : 0;
+        if (!ok_from || !ok_to) {
+            error = QString("expected from=to: %1").arg(item);
+            return false;
+        }
+        mapping.insert(from, to);
+    }
+    setIdMapping(mapping);
+    return true;
+}
+
+bool TraceReplay::start()
+{
+    if (isRunning()) {
+        return false;
+    }
+    stop(); // clean up after a replay that ended by itself
+
+    _error.clear();
+    if (!_backend.isMeasurementRunning()) {
+        _error = tr("Measurement is not running");
+        return false;
+    }
+    if (!_fileName.isEmpty() && !canStream(_fileName)) {
+        _error = tr("Only cangaroo, BLF and pcap trace files can be replayed from disk, open the file first");
+        return false;
+    }
+    if (_fileName.isEmpty() && _snapshot.isEmpty()) {
+        _error = tr("Nothing to replay");
+        return false;
+    }
+
+    // resolve interfaces here, the scheduler thread must not call into the backend
+    _interfaces.clear();
+    foreach (CanInterfaceId id, _backend.getInterfaceList()) {
+        CanInterface *intf = _backend.getInterfaceById(id);
+        if (intf && intf->isOpen()) {
+            _interfaces.insert(id, intf);
+        }
+    }
+    if (_target && !_interfaces.contains(_target)) {
+        _error = tr("Target interface is not part of the measurement");
+        return false;
+    }
+
+    while (_queue.available()) {
+        _queue.release(_queue.available());
+    }
+    memset(&_stats, 0, sizeof(_stats));
+    _rebase = true;
+    _hasLastTimestamp = false;
+    _shift_ns = 0;
+    _last_ns = 0;
+    _sourceDone.storeRelease(0);
+    _shouldBeRunning = true;
+
+    _loaderThread = new QThread();
+    connect(_loaderThread, SIGNAL(started()), this, SLOT(load()), Qt::DirectConnection);
+    _loaderThread->start();
+
+    _thread = new QThread();
+    connect(_thread, SIGNAL(started()), this, SLOT(run()), Qt::DirectConnection);
+    _thread->start(QThread::TimeCriticalPriority);
+    return true;
+}
+
+void TraceReplay::stop()
+{
+    _shouldBeRunning = false;
+    if (_loaderThread) {
+        _loaderThread->wait();
+        delete _loaderThread;
+        _loaderThread = 0;
+    }
+    if (_thread) {
+        _thread->wait();
+        delete _thread;
+        _thread = 0;
+    }
+}
+
+bool TraceReplay::isRunning() const
+{
+    return _thread && _thread->isRunning();
+}
+
+QString TraceReplay::errorString() const
+{
+    return _error;
+}
+
+TraceReplay::statistics_t TraceReplay::statistics() const
+{
+    return _stats;
+}
+
+void TraceReplay::load()
+{
+    bool ok;
+    do {
+        _rebase = true;
+        ok = _fileName.isEmpty() ? loadSnapshot() : loadFile();
+    } while (ok && _loop && _shouldBeRunning && _hasLastTimestamp);
+
+    _sourceDone.storeRelease(1);
+    _loaderThread->quit();
+}
+
+bool TraceReplay::loadSnapshot()
+{
+    QList<CanMessage> msgs;
+    CanMessage msg;
+    for (int i=0; i<_snapshot.size(); i++) {
+        _snapshot.frame(i).toMessage(msg);
+        msgs.append(msg);
+        if (msgs.size() >= batch_frames) {
+            if (!enqueue(msgs)) {
+                return false;
+            }
+            msgs.clear();
+        }
+    }
+    return enqueue(msgs);
+}
+
+bool TraceReplay::loadFile()
+{
+    QList<CanMessage> msgs;
+    TraceStreamReader reader(_backend);
+    if (!reader.open(_fileName)) {
+        log_error(QString(tr("Cannot replay %1: %2")).arg(_fileName, reader.errorString()));
+        return false;
+    }
+    while (!reader.atEnd()) {
+        msgs.clear();
+        if ((reader.readMessages(msgs, batch_frames) < 0) || !enqueue(msgs)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool TraceReplay::enqueue(QList<CanMessage> &msgs)
+{
+    int count = 0;
+    for (int i=0; i<msgs.size(); i++) {
+        CanMessage &msg = msgs[i];
+        if (msg.isErrorFrame()) {
+            continue;
+        }
+
+        // standard 0x123 and extended 0x123 are different frames
+        uint32_t id = msg.getRawId() & (id_flag_extended | id_mask_extended);
+        if (!_idFilter.isEmpty() && !_idFilter.contains(id)) {
+            continue;
+        }
+
+        QHash<uint32_t, uint32_t>::const_iterator it = _idMapping.constFind(id);
+        if (it != _idMapping.constEnd()) {
+            msg.setRawId(it.value() | (msg.getRawId() & id_flag_rtr));
+        }
+
+        // the next loop iteration starts right where the previous one ended
+        CanTimestamp ts = msg.getTimestampNsecs();
+        if (_rebase) {
+            _shift_ns = _hasLastTimestamp ? (_last_ns - ts) : 0;
+            _rebase = false;
+        }
+        ts += _shift_ns;
+        msg.setTimestampNsecs(ts);
+        _last_ns = ts;
+        _hasLastTimestamp = true;
+
+        if (count != i) {
+            msgs[count] = msg;
+        }
+        count++;
+    }
+
+    // wait for room instead of dropping, the scheduler drains at replay speed
+    int done = 0;
+    while ((done < count) && _shouldBeRunning) {
+        int space = _queue.capacity() - _queue.available();
+        if (space == 0) {
+            QThread::msleep(1);
+            continue;
+        }
+        done += _queue.push(msgs.constData() + done, qMin(space, count - done));
+    }
+    return _shouldBeRunning;
+}
+
+void TraceReplay::run()
+{
+    int64_t start_ns = 0;
+    CanTimestamp first_ts = 0;
+    bool started = false;
+    int64_t jitter_sum_ns = 0;
+    uint64_t jitter_count = 0;
+
+    while (_shouldBeRunning) {
+        if (_queue.available() == 0) {
+            if (_sourceDone.loadAcquire() && (_queue.available() == 0)) {
+                break;
+            }
+            QThread::usleep(100);
+            continue;
+        }
+
+        const CanMessage &msg = _queue.at(0);
+        CanTimestamp ts = msg.getTimestampNsecs();
+        if (!started) {
+            start_ns = monotonicNs();
+            first_ts = ts;
+            started = true;
+        }
+
+        int64_t now_ns = monotonicNs();
+        if (_speed > 0) {
+            int64_t deadline_ns = start_ns + (int64_t)((double)(ts - first_ts) / _speed);
+            if (deadline_ns - now_ns > spin_ns) {
+                sleepUntilNs(deadline_ns - spin_ns);
+            }
+            while ((now_ns = monotonicNs()) < deadline_ns) {
+            }
+
+            int64_t jitter_ns = now_ns - deadline_ns;
+            jitter_sum_ns += jitter_ns;
+            jitter_count++;
+            if (jitter_ns > _stats.jitter_max_ns) {
+                _stats.jitter_max_ns = jitter_ns;
+            }
+            if (jitter_ns > late_threshold_ns) {
+                _stats.frames_late++;
+            }
+        }
+
+        CanInterface *intf = _interfaces.value(_target ? _target : msg.getInterfaceId(), 0);
+        if (intf) {
+            intf->sendMessage(msg);
+            _stats.frames_sent++;
+        } else {
+            _stats.frames_skipped++;
+        }
+        _queue.release(1);
+    }
+
+    _stats.jitter_avg_ns = jitter_count ? (jitter_sum_ns / (int64_t)jitter_count) : 0;
+    _shouldBeRunning = false;
+
+    _thread->quit();
+    emit finished();
+}
+
+bool TraceReplay::saveXML(Backend &backend, QDomDocument &xml, QDomElement &root)
+{
+    root.setAttribute("filename", _fileName);
+    root.setAttribute("target", _target ? backend.getInterfaceName(_target) : QString());
+    root.setAttribute("speed", QString::number(_speed));
+    root.setAttribute("loop", _loop ? 1 : 0);
+
+    foreach (uint32_t id, _idFilter) {
+        QDomElement el = xml.createElement("filter");
+        el.setAttribute("id", QString("0x%1").arg(id, 0, 16));
+        root.appendChild(el);
+    }
+    for (QHash<uint32_t, uint32_t>::const_iterator it = _idMapping.constBegin(); it != _idMapping.constEnd(); ++it) {
+        QDomElement el = xml.createElement("map");
+        el.setAttribute("from", QString("0x%1").arg(it.key(), 0, 16));
+        el.setAttribute("to", QString("0x%1").arg(it.value(), 0, 16));
+        root.appendChild(el);
+    }
+    return true;
+}
+
+bool TraceReplay::loadXML(Backend &backend, QDomElement &el)
+{
+    _fileName = el.attribute("filename");
+    _speed = el.attribute("speed", "1").toDouble();
+    _loop = el.attribute("loop", "0").toInt() != 0;
+
+    _target = 0;
+    QString target = el.attribute("target");
+    if (!target.isEmpty()) {
+        foreach (CanInterfaceId id, backend.getInterfaceList()) {
+            if (backend.getInterfaceName(id) == target) {
+                _target = id;
+            }
+        }
+    }
+
+    _idFilter.clear();
+    QDomNodeList filters = el.elementsByTagName("filter");
+    for (int i=0; i<filters.length(); i++) {
+        _idFilter.insert(normalizedId(filters.item(i).toElement().attribute("id").toUInt(0, 0)));
+    }
+
+    _idMapping.clear();
+    QDomNodeList maps = el.elementsByTagName("map");
+    for (int i=0; i<maps.length(); i++) {
+        QDomElement map = maps.item(i).toElement();
+        _idMapping.insert(normalizedId(map.attribute("from").toUInt(0, 0)), normalizedId(map.attribute("to").toUInt(0, 0)));
+    }
+    return true;
+}
@@ -0,0 +1,145 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <QObject>
+#include <QString>
+#include <QHash>
+#include <QSet>
+#include <QAtomicInt>
+#include <QDomDocument>
+#include <core/CanMessageQueue.h>
+#include <core/CanTraceSnapshot.h>
+#include <driver/CanDriver.h>
+
+class QThread;
+class Backend;
+class CanInterface;
+
+// Re-transmits a trace onto live interfaces with its original timing.
+//
+// The source is either a snapshot of a loaded trace or a trace file which
+// is streamed (native, BLF and pcap/pcapng). A loader thread reads ahead
+// into a queue, applying the id filter and mapping, so the scheduler thread
+// only waits for absolute deadlines and sends. Deadlines are slept for with
+// clock_nanosleep(), the last spin_ns are busy-waited for accuracy. When
+// sending falls behind, frames go out back to back until the schedule is met
+// again; the statistics show how late frames were sent.
+class TraceReplay : public QObject
+{
+    Q_OBJECT
+
+public:
+    typedef struct {
+        uint64_t frames_sent;
+        uint64_t frames_skipped; // no interface to send them on
+        uint64_t frames_late;    // sent more than late_threshold_ns after their deadline
+        int64_t jitter_avg_ns;
+        int64_t jitter_max_ns;
+    } statistics_t;
+
+    enum {
+        spin_ns = 20000,
+        late_threshold_ns = 1000000,
+        batch_frames = 4096
+    };
+
+    explicit TraceReplay(Backend &backend, QObject *parent = 0);
+    virtual ~TraceReplay();
+
+    void setSnapshot(const CanTraceSnapshot &snapshot);
+    void setFileName(const QString &filename);
+    QString fileName() const;
+    static bool canStream(const QString &filename);
+
+    // frames are sent on their original interface unless a target is set
+    CanInterfaceId targetInterface() const;
+    void setTargetInterface(CanInterfaceId id);
+
+    // 1.0 replays with the original timing, 0 as fast as possible
+    double speed() const;
+    void setSpeed(double speed);
+
+    bool isLooping() const;
+    void setLooping(bool loop);
+
+    // only ids in the filter are replayed, all if it is empty. Both take raw
+    // ids with bit 31 set for extended ids; the RTR flag is kept on mapping.
+    void setIdFilter(const QSet<uint32_t> &ids);
+    void setIdMapping(const QHash<uint32_t, uint32_t> &mapping);
+
+    // the same as text: the filter as space separated ids, the mapping as
+    // space separated from=to pairs, e.g. "0x100 0x80000123" and "0x100=0x200"
+    QString idFilterString() const;
+    bool setIdFilterString(const QString &spec, QString &error);
+    QString idMappingString() const;
+    bool setIdMappingString(const QString &spec, QString &error);
+
+    bool start();
+    void stop();
+    bool isRunning() const;
+    QString errorString() const;
+
+    // valid once finished() has been emitted
+    statistics_t statistics() const;
+
+    bool saveXML(Backend &backend, QDomDocument &xml, QDomElement &root);
+    bool loadXML(Backend &backend, QDomElement &el);
+
+signals:
+    void finished();
+
+private slots:
+    void load();
+    void run();
+
+private:
+    Backend &_backend;
+    QThread *_thread;
+    QThread *_loaderThread;
+    CanMessageQueue _queue;
+    volatile bool _shouldBeRunning;
+    QAtomicInt _sourceDone;
+    QString _error;
+
+    CanTraceSnapshot _snapshot;
+    QString _fileName;
+    CanInterfaceId _target;
+    double _speed;
+    bool _loop;
+    QSet<uint32_t> _idFilter;
+    QHash<uint32_t, uint32_t> _idMapping;
+
+    QHash<CanInterfaceId, CanInterface*> _interfaces;
+    statistics_t _stats;
+
+    // loader state, timestamps continue across loop iterations
+    bool _rebase;
+    bool _hasLastTimestamp;
+    CanTimestamp _shift_ns;
+    CanTimestamp _last_ns;
+
+    bool loadSnapshot();
+    bool loadFile();
+    bool enqueue(QList<CanMessage> &msgs);
+};
@@ -0,0 +1,157 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "TraceStreamReader.h"
+
+#include <core/CanMessage.h>
+#include "NativeTraceFile.h"
+#include "BlfTraceFile.h"
+#include "PcapTraceFile.h"
+#include "TraceImporter.h"
+
+TraceStreamReader::TraceStreamReader(Backend &backend)
+  : _backend(backend),
+    _native(0),
+    _blf(0),
+    _pcap(0),
+    _nextBlock(0)
+{
+}
+
+TraceStreamReader::~TraceStreamReader()
+{
+    close();
+}
+
+bool TraceStreamReader::canStream(const QString &filename)
+{
+    TraceImporter::format_t format = TraceImporter::formatForFileName(filename);
+    return (format == TraceImporter::format_native)
+        || (format == TraceImporter::format_blf)
+        || (format == TraceImporter::format_pcap);
+}
+
+bool TraceStreamReader::open(const QString &filename)
+{
+    close();
+    _error.clear();
+
+    bool ok = false;
+    switch (TraceImporter::formatForFileName(filename)) {
+        case TraceImporter::format_native:
+            _native = new NativeTraceReader(_backend);
+            ok = _native->open(filename);
+            if (!ok) { _error = _native->errorString(); }
+            break;
+        case TraceImporter::format_blf:
+            _blf = new BlfTraceReader(_backend);
+            ok = _blf->open(filename);
+            if (!ok) { _error = _blf->errorString(); }
+            break;
+        case TraceImporter::format_pcap:
+            _pcap = new PcapTraceReader(_backend);
+            ok = _pcap->open(filename);
+            if (!ok) { _error = _pcap->errorString(); }
+            break;
+        default:
+            _error = QString("Text trace formats cannot be streamed, import the file first");
+            break;
+    }
+
+    if (!ok) {
+        close();
+    }
+    return ok;
+}
+
+void TraceStreamReader::close()
+{
+    delete _native;
+    delete _blf;
+    delete _pcap;
+    _native = 0;
+    _blf = 0;
+    _pcap = 0;
+    _nextBlock = 0;
+}
+
+bool TraceStreamReader::isOpen() const
+{
+    return _native || _blf || _pcap;
+}
+
+int TraceStreamReader::readMessages(QList<CanMessage> &msgs, int max_count)
+{
+    if (_native) {
+        int count = 0;
+        while ((count < max_count) && (_nextBlock < _native->blockCount())) {
+            int before = msgs.size();
+            if (!_native->readBlock(_nextBlock++, msgs)) {
+                _error = _native->errorString();
+                return -1;
+            }
+            count += msgs.size() - before;
+        }
+        return count;
+    }
+
+    int count = -1;
+    if (_blf) {
+        count = _blf->readMessages(msgs, max_count);
+        if (count < 0) { _error = _blf->errorString(); }
+    } else if (_pcap) {
+        count = _pcap->readMessages(msgs, max_count);
+        if (count < 0) { _error = _pcap->errorString(); }
+    }
+    return count;
+}
+
+bool TraceStreamReader::atEnd() const
+{
+    if (_native) {
+        return _nextBlock >= _native->blockCount();
+    } else if (_blf) {
+        return _blf->atEnd();
+    } else if (_pcap) {
+        return _pcap->atEnd();
+    } else {
+        return true;
+    }
+}
+
+int TraceStreamReader::percentDone() const
+{
+    if (_native) {
+        return (_native->blockCount() > 0) ? (_nextBlock * 100 / _native->blockCount()) : 100;
+    } else if (_blf) {
+        return _blf->percentDone();
+    } else if (_pcap) {
+        return _pcap->percentDone();
+    } else {
+        return 100;
+    }
+}
+
+QString TraceStreamReader::errorString() const
+{
+    return _error;
+}
@@ -0,0 +1,64 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#pragma once
+
+#include <QString>
+#include <QList>
+
+class Backend;
+class CanMessage;
+class NativeTraceReader;
+class BlfTraceReader;
+class PcapTraceReader;
+
+// Reads the binary trace formats (native, BLF and pcap/pcapng) front to back
+// in batches without loading the whole file, for consumers that process
+// frames as they come: replay and the file-backed interface.
+class TraceStreamReader
+{
+public:
+    TraceStreamReader(Backend &backend);
+    ~TraceStreamReader();
+
+    static bool canStream(const QString &filename);
+
+    bool open(const QString &filename);
+    void close();
+    bool isOpen() const;
+
+    // appends up to about max_count frames, native files are read a whole
+    // block at a time. returns the number of frames read or -1 on error
+    int readMessages(QList<CanMessage> &msgs, int max_count);
+    bool atEnd() const;
+    int percentDone() const;
+
+    QString errorString() const;
+
+private:
+    Backend &_backend;
+    NativeTraceReader *_native;
+    BlfTraceReader *_blf;
+    PcapTraceReader *_pcap;
+    int _nextBlock;
+    QString _error;
+};
@@ -0,0 +1,23 @@
+HEADERS += \
+    $$PWD/TraceFile.h \
+    $$PWD/NativeTraceFile.h \
+    $$PWD/BlfTraceFile.h \
+    $$PWD/MdfTraceFile.h \
+    $$PWD/PcapTraceFile.h \
+    $$PWD/TraceRecorder.h \
+    $$PWD/TraceReplay.h \
+    $$PWD/TraceStreamReader.h \
+    $$PWD/TraceExporter.h \
+    $$PWD/TraceImporter.h
+
+SOURCES += \
+    $$PWD/TraceFile.cpp \
+    $$PWD/NativeTraceFile.cpp \
+    $$PWD/BlfTraceFile.cpp \
+    $$PWD/MdfTraceFile.cpp \
+    $$PWD/PcapTraceFile.cpp \
+    $$PWD/TraceRecorder.cpp \
+    $$PWD/TraceReplay.cpp \
+    $$PWD/TraceStreamReader.cpp \
+    $$PWD/TraceExporter.cpp \
+    $$PWD/TraceImporter.cpp
@@ -98,13 +98,14 @@ void AggregatedTraceViewModel::beforeAppend(int num_messages)
     CanTrace *trace = backend()->getTrace();
     int start_id = trace->size();
 
+    CanMessage msg;
     for (int i=start_id; i<start_id + num_messages; i++) {
-        const CanMessage *msg = trace->getMessage(i);
-        unique_key_t key = makeUniqueKey(*msg);
+        trace->getMessage(i)->toMessage(msg);
+        unique_key_t key = makeUniqueKey(msg);
         if (_map.contains(key) || _pendingMessageInserts.contains(key)) {
-            _pendingMessageUpdates.append(*msg);
+            _pendingMessageUpdates.append(msg);
         } else {
-            _pendingMessageInserts[key] = *msg;
+            _pendingMessageInserts[key] = msg;
         }
     }
 
@@ -129,13 +130,6 @@ AggregatedTraceViewModel::unique_key_t AggregatedTraceViewModel::makeUniqueKey(c
     return ((uint64_t)msg.getInterfaceId() << 32) | msg.getRawId();
 }
 
-double AggregatedTraceViewModel::getTimeDiff(const timeval t1, const timeval t2) const
-{
-    double diff = t2.tv_sec - t1.tv_sec;
-    diff += ((double)(t2.tv_usec - t1.tv_usec)) / 1000000;
-    return diff;
-}
-
 
 QModelIndex AggregatedTraceViewModel::index(int row, int column, const QModelIndex &parent) const
 {
@@ -204,14 +198,13 @@ QVariant AggregatedTraceViewModel::data_TextColorRole(const QModelIndex &index,
 
     if (item->parent() == _rootItem) { // CanMessage row
 
-        struct timeval now;
-        gettimeofday(&now, 0);
-
-        int color = getTimeDiff(item->_lastmsg.getTimestamp(), now)*100;
+        // fades from black to grey within two seconds of the last update
+        CanTimestamp age = currentTimestamp() - item->_lastmsg.getTimestampNsecs();
+        CanTimestamp color = age / (timestamp_nsecs_per_sec / 100);
         if (color>200) { color = 200; }
         if (color<0) { color = 0; }
 
-        return QVariant::fromValue(QColor(color, color, color));
+        return QVariant::fromValue(QColor((int)color, (int)color, (int)color));
     } else { // CanSignal Row
         return data_TextColorRole_Signal(index, role, item->parent()->_lastmsg);
     }
@@ -34,6 +34,7 @@
 BaseTraceViewModel::BaseTraceViewModel(Backend &backend)
 {
     _backend = &backend;
+    _timestampDecimals = 6;
 }
 
 int BaseTraceViewModel::columnCount(const QModelIndex &parent) const
@@ -146,27 +147,38 @@ void BaseTraceViewModel::setTimestampMode(timestamp_mode_t timestampMode)
     _timestampMode = timestampMode;
 }
 
+int BaseTraceViewModel::timestampDecimals() const
+{
+    return _timestampDecimals;
+}
+
+void BaseTraceViewModel::setTimestampDecimals(int decimals)
+{
+    _timestampDecimals = qBound(3, decimals, 9);
+}
+
 QVariant BaseTraceViewModel::formatTimestamp(timestamp_mode_t mode, const CanMessage &currentMsg, const CanMessage &lastMsg) const
 {
+    const int decimals = _timestampDecimals;
 
     if (mode==timestamp_mode_delta) {
 
-        double t_current = currentMsg.getFloatTimestamp();
-        double t_last = lastMsg.getFloatTimestamp();
+        CanTimestamp t_current = currentMsg.getTimestampNsecs();
+        CanTimestamp t_last = lastMsg.getTimestampNsecs();
         if (t_last==0) {
-            return QString().asprintf("%.04lf", 0.00);
+            return ::formatTimestamp(0, decimals);
         } else {
-            return QString().asprintf("%.04lf", t_current-t_last);
+            return ::formatTimestamp(t_current-t_last, decimals);
         }
 
     } else if (mode==timestamp_mode_absolute) {
 
-        return currentMsg.getDateTime().toString("hh:mm:ss.zzz");
+        return formatTimeOfDay(currentMsg.getTimestampNsecs(), decimals);
 
     } else if (mode==timestamp_mode_relative) {
 
-        double t_current = currentMsg.getFloatTimestamp();
-        return QString().asprintf("%.04lf", t_current - backend()->getTimestampAtMeasurementStart());
+        CanTimestamp t_current = currentMsg.getTimestampNsecs();
+        return ::formatTimestamp(t_current - backend()->getNsecsAtMeasurementStart(), decimals);
 
     }
 
@@ -61,6 +61,10 @@ public:
     timestamp_mode_t timestampMode() const;
     void setTimestampMode(timestamp_mode_t timestampMode);
 
+    // fractional digits of the timestamp column, 3 (ms) to 9 (ns)
+    int timestampDecimals() const;
+    void setTimestampDecimals(int decimals);
+
 protected:
     virtual QVariant data_DisplayRole(const QModelIndex &index, int role) const;
     virtual QVariant data_DisplayRole_Message(const QModelIndex &index, int role, const CanMessage &currentMsg, const CanMessage &lastMsg) const;
@@ -74,5 +78,6 @@ protected:
 private:
     Backend *_backend;
     timestamp_mode_t _timestampMode;
+    int _timestampDecimals;
 
 };
@@ -29,25 +29,26 @@ LinearTraceViewModel::LinearTraceViewModel(Backend &backend)
 {
     connect(backend.getTrace(), SIGNAL(beforeAppend(int)), this, SLOT(beforeAppend(int)));
     connect(backend.getTrace(), SIGNAL(afterAppend()), this, SLOT(afterAppend()));
+    connect(backend.getTrace(), SIGNAL(beforeRemove(int)), this, SLOT(beforeRemove(int)));
+    connect(backend.getTrace(), SIGNAL(afterRemove()), this, SLOT(afterRemove()));
     connect(backend.getTrace(), SIGNAL(beforeClear()), this, SLOT(beforeClear()));
     connect(backend.getTrace(), SIGNAL(afterClear()), this, SLOT(afterClear()));
 }
 
 QModelIndex LinearTraceViewModel::index(int row, int column, const QModelIndex &parent) const
 {
-    if (parent.isValid() && parent.internalId()) {
-        return createIndex(row, column, (unsigned int)(0x80000000 | parent.internalId()));
+    if (parent.isValid()) {
+        return createIndex(row, column, (quintptr)(0x80000000 | parent.internalId()));
     } else {
-        return createIndex(row, column, row+1);
+        return createIndex(row, column, frameId(row));
     }
 }
 
 QModelIndex LinearTraceViewModel::parent(const QModelIndex &child) const
 {
-    (void) child;
     quintptr id = child.internalId();
     if (id & 0x80000000) {
-        return createIndex(id & 0x7FFFFFFF, 0, (unsigned int)(id & 0x7FFFFFFF));
+        return createIndex(tracePosition(id), 0, (quintptr)(id & 0x7FFFFFFF));
     }
     return QModelIndex();
 }
@@ -59,9 +60,11 @@ int LinearTraceViewModel::rowCount(const QModelIndex &parent) const
         if (id & 0x80000000) { // node of a message
             return 0;
         } else { // a message
-            const CanMessage *msg = trace()->getMessage(id-1);
-            if (msg) {
-                CanDbMessage *dbmsg = backend()->findDbMessage(*msg);
+            const CanTraceFrame *frame = trace()->getMessage(tracePosition(id));
+            if (frame) {
+                CanMessage msg;
+                frame->toMessage(msg);
+                CanDbMessage *dbmsg = backend()->findDbMessage(msg);
                 return (dbmsg!=0) ? dbmsg->getSignals().length() : 0;
             } else {
                 return 0;
@@ -83,6 +86,18 @@ bool LinearTraceViewModel::hasChildren(const QModelIndex &parent) const
     return rowCount(parent)>0;
 }
 
+quintptr LinearTraceViewModel::frameId(int pos) const
+{
+    return (quintptr)((trace()->removedMessages() + pos + 1) & 0x7FFFFFFF);
+}
+
+int LinearTraceViewModel::tracePosition(quintptr id) const
+{
+    // ids of frames dropped by the retention policy wrap to positions
+    // beyond the end of the trace, getMessage() rejects those
+    return (int)(((id & 0x7FFFFFFF) - 1 - trace()->removedMessages()) & 0x7FFFFFFF);
+}
+
 void LinearTraceViewModel::beforeAppend(int num_messages)
 {
     beginInsertRows(QModelIndex(), trace()->size(), trace()->size()+num_messages-1);
@@ -93,6 +108,17 @@ void LinearTraceViewModel::afterAppend()
     endInsertRows();
 }
 
+void LinearTraceViewModel::beforeRemove(int num_messages)
+{
+    // the trace always drops its oldest messages
+    beginRemoveRows(QModelIndex(), 0, num_messages-1);
+}
+
+void LinearTraceViewModel::afterRemove()
+{
+    endRemoveRows();
+}
+
 void LinearTraceViewModel::beforeClear()
 {
     beginResetModel();
@@ -106,20 +132,22 @@ void LinearTraceViewModel::afterClear()
 QVariant LinearTraceViewModel::data_DisplayRole(const QModelIndex &index, int role) const
 {
     quintptr id = index.internalId();
-    int msg_id = (id & ~0x80000000)-1;
+    int msg_id = tracePosition(id);
+
+    const CanTraceFrame *frame = trace()->getMessage(msg_id);
+    if (!frame) { return QVariant(); }
 
-    const CanMessage *msg = trace()->getMessage(msg_id);
-    if (!msg) { return QVariant(); }
+    CanMessage msg;
+    frame->toMessage(msg);
 
     if (id & 0x80000000) {
-        return data_DisplayRole_Signal(index, role, *msg);
+        return data_DisplayRole_Signal(index, role, msg);
     } else if (id) {
+        CanMessage prev_msg;
         if (msg_id>=1) {
-            const CanMessage *prev_msg = trace()->getMessage(msg_id-1);
-            return data_DisplayRole_Message(index, role, *msg, *prev_msg);
-        } else {
-            return data_DisplayRole_Message(index, role, *msg, CanMessage());
+            trace()->getMessage(msg_id-1)->toMessage(prev_msg);
         }
+        return data_DisplayRole_Message(index, role, msg, prev_msg);
     }
 
     return QVariant();
@@ -132,10 +160,11 @@ QVariant LinearTraceViewModel::data_TextColorRole(const QModelIndex &index, int
     quintptr id = index.internalId();
 
     if (id & 0x80000000) { // CanSignal row
-        int msg_id = (id & ~0x80000000)-1;
-        const CanMessage *msg = trace()->getMessage(msg_id);
-        if (msg) {
-            return data_TextColorRole_Signal(index, role, *msg);
+        const CanTraceFrame *frame = trace()->getMessage(tracePosition(id));
+        if (frame) {
+            CanMessage msg;
+            frame->toMessage(msg);
+            return data_TextColorRole_Signal(index, role, msg);
         }
     }
 
@@ -44,10 +44,19 @@ public:
 private slots:
     void beforeAppend(int num_messages);
     void afterAppend();
+    void beforeRemove(int num_messages);
+    void afterRemove();
     void beforeClear();
     void afterClear();
 
 private:
+    // Items carry the frame's position counted from the start of the
+    // trace, including frames dropped by retention (+1, 31 bits). Qt keeps
+    // internalId() when it shifts persistent indexes after a removal, so
+    // this stays valid where a plain position would point at a later frame.
+    quintptr frameId(int pos) const;
+    int tracePosition(quintptr id) const;
+
     virtual QVariant data_DisplayRole(const QModelIndex &index, int role) const;
     virtual QVariant data_TextColorRole(const QModelIndex &index, int role) const;
 };
@@ -24,10 +24,15 @@
 
 #include <QDomDocument>
 #include <QSortFilterProxyModel>
+#include <QAction>
+#include <QToolTip>
+#include <QInputDialog>
+#include <math.h>
 #include "LinearTraceViewModel.h"
 #include "AggregatedTraceViewModel.h"
 #include "TraceFilterModel.h"
 #include <core/Backend.h>
+#include <core/CanTrace.h>
 
 
 TraceWindow::TraceWindow(QWidget *parent, Backend &backend) :
@@ -36,7 +41,8 @@ TraceWindow::TraceWindow(QWidget *parent, Backend &backend) :
     _backend(&backend),
     _mode(mode_linear),
     _doAutoScroll(false),
-    _timestampMode(timestamp_mode_absolute)
+    _timestampMode(timestamp_mode_absolute),
+    _timestampDecimals(6)
 {
     ui->setupUi(this);
 
@@ -82,6 +88,12 @@ TraceWindow::TraceWindow(QWidget *parent, Backend &backend) :
     ui->cbTimestampMode->addItem(tr("Delta"), 2);
     setTimestampMode(timestamp_mode_delta);
 
+    // nanoseconds only make sense for interfaces with hardware timestamps
+    ui->cbTimestampDecimals->addItem(tr("ms"), 3);
+    ui->cbTimestampDecimals->addItem(tr("us"), 6);
+    ui->cbTimestampDecimals->addItem(tr("ns"), 9);
+    ui->cbTimestampDecimals->setCurrentIndex(1);
+
     connect(_linearTraceViewModel, SIGNAL(rowsInserted(QModelIndex,int,int)), this, SLOT(rowsInserted(QModelIndex,int,int)));
 
     connect(ui->filterLineEdit, SIGNAL(textChanged(QString)), this, SLOT(on_cbFilterChanged()));
@@ -91,6 +103,27 @@ TraceWindow::TraceWindow(QWidget *parent, Backend &backend) :
     connect(ui->cbAggregated,SIGNAL(stateChanged(int)),this,SLOT(on_cbAggregated_stateChanged(int)));
     connect(ui->cbAutoScroll,SIGNAL(stateChanged(int)),this,SLOT(on_cbAutoScroll_stateChanged(int)));
 
+    // jump between frames of the same interface and id, linear view only
+    QAction *actionNext = new QAction(tr("Next frame with this ID"), this);
+    actionNext->setShortcut(QKeySequence(Qt::Key_F3));
+    actionNext->setShortcutContext(Qt::WidgetWithChildrenShortcut);
+    connect(actionNext, SIGNAL(triggered()), this, SLOT(gotoNextOccurrence()));
+    ui->tree->addAction(actionNext);
+
+    QAction *actionPrevious = new QAction(tr("Previous frame with this ID"), this);
+    actionPrevious->setShortcut(QKeySequence(Qt::SHIFT | Qt::Key_F3));
+    actionPrevious->setShortcutContext(Qt::WidgetWithChildrenShortcut);
+    connect(actionPrevious, SIGNAL(triggered()), this, SLOT(gotoPreviousOccurrence()));
+    ui->tree->addAction(actionPrevious);
+
+    QAction *actionGotoTime = new QAction(tr("Go to time..."), this);
+    actionGotoTime->setShortcut(QKeySequence(Qt::CTRL | Qt::Key_G));
+    actionGotoTime->setShortcutContext(Qt::WidgetWithChildrenShortcut);
+    connect(actionGotoTime, SIGNAL(triggered()), this, SLOT(gotoTime()));
+    ui->tree->addAction(actionGotoTime);
+
+    ui->tree->setContextMenuPolicy(Qt::ActionsContextMenu);
+
     ui->cbAggregated->setCheckState(Qt::Unchecked);
     ui->cbAutoScroll->setCheckState(Qt::Checked);
 }
@@ -170,6 +203,33 @@ void TraceWindow::setTimestampMode(int mode)
     }
 }
 
+void TraceWindow::setTimestampDecimals(int decimals)
+{
+    _aggregatedTraceViewModel->setTimestampDecimals(decimals);
+    _linearTraceViewModel->setTimestampDecimals(decimals);
+    decimals = _linearTraceViewModel->timestampDecimals();
+
+    if (decimals != _timestampDecimals)
+    {
+        _timestampDecimals = decimals;
+        for (int i=0; i<ui->cbTimestampDecimals->count(); i++)
+        {
+            if (ui->cbTimestampDecimals->itemData(i).toInt() == decimals)
+            {
+                ui->cbTimestampDecimals->setCurrentIndex(i);
+            }
+        }
+        // "hh:mm:ss." plus the fraction and some margin
+        int width = ui->tree->fontMetrics().horizontalAdvance(QString(11 + decimals, '0'));
+        if (ui->tree->columnWidth(BaseTraceViewModel::column_timestamp) < width)
+        {
+            ui->tree->setColumnWidth(BaseTraceViewModel::column_timestamp, width);
+        }
+        ui->tree->viewport()->update();
+        emit(settingsChanged(this));
+    }
+}
+
 bool TraceWindow::saveXML(Backend &backend, QDomDocument &xml, QDomElement &root)
 {
     if (!ConfigurableWidget::saveXML(backend, xml, root))
@@ -180,6 +240,7 @@ bool TraceWindow::saveXML(Backend &backend, QDomDocument &xml, QDomElement &root
     root.setAttribute("type", "TraceWindow");
     root.setAttribute("mode", (_mode==mode_linear) ? "linear" : "aggregated");
     root.setAttribute("TimestampMode", _timestampMode);
+    root.setAttribute("TimestampDecimals", _timestampDecimals);
 
     QDomElement elLinear = xml.createElement("LinearTraceView");
     elLinear.setAttribute("AutoScroll", (ui->cbAutoScroll->checkState() == Qt::Checked) ? 1 : 0);
@@ -201,6 +262,7 @@ bool TraceWindow::loadXML(Backend &backend, QDomElement &el)
 
     setMode((el.attribute("mode", "linear") == "linear") ? mode_linear : mode_aggregated);
     setTimestampMode(el.attribute("TimestampMode", "0").toInt());
+    setTimestampDecimals(el.attribute("TimestampDecimals", "6").toInt());
 
     QDomElement elLinear = el.firstChildElement("LinearTraceView");
     setAutoScroll(elLinear.attribute("AutoScroll", "0").toInt() != 0);
@@ -245,6 +307,11 @@ void TraceWindow::on_cbTimestampMode_currentIndexChanged(int index)
     setTimestampMode((timestamp_mode_t)ui->cbTimestampMode->itemData(index).toInt());
 }
 
+void TraceWindow::on_cbTimestampDecimals_currentIndexChanged(int index)
+{
+    setTimestampDecimals(ui->cbTimestampDecimals->itemData(index).toInt());
+}
+
 void TraceWindow::on_cbFilterChanged()
 {
     _aggFilteredModel->setFilterText(ui->filterLineEdit->text());
@@ -258,3 +325,100 @@ void TraceWindow::on_cbTraceClearpushButton()
     _backend->clearTrace();
     _backend->clearLog();
 }
+
+void TraceWindow::gotoNextOccurrence()
+{
+    gotoOccurrence(true);
+}
+
+void TraceWindow::gotoPreviousOccurrence()
+{
+    gotoOccurrence(false);
+}
+
+int TraceWindow::currentTraceRow()
+{
+    if (_mode != mode_linear) {
+        return -1;
+    }
+
+    QModelIndex idx = ui->tree->currentIndex();
+    if (!idx.isValid()) {
+        return -1;
+    }
+
+    // top level rows of the linear model are trace positions, signal rows
+    // belong to the message row above them
+    QModelIndex src = _linearProxyModel->mapToSource(_linFilteredModel->mapToSource(idx));
+    if (src.parent().isValid()) {
+        src = src.parent();
+    }
+    return src.row();
+}
+
+bool TraceWindow::selectTraceRow(int row)
+{
+    QModelIndex src = _linearTraceViewModel->index(row, 0, QModelIndex());
+    QModelIndex idx = _linFilteredModel->mapFromSource(_linearProxyModel->mapFromSource(src));
+    if (!idx.isValid()) {
+        return false; // hidden by the filter
+    }
+
+    setAutoScroll(false);
+    ui->tree->setCurrentIndex(idx);
+    ui->tree->scrollTo(idx, QAbstractItemView::PositionAtCenter);
+    return true;
+}
+
+void TraceWindow::gotoOccurrence(bool forward)
+{
+    int row = currentTraceRow();
+    if (row < 0) {
+        return;
+    }
+
+    CanTrace *trace = _backend->getTrace();
+    const CanTraceFrame *frame = trace->getMessage(row);
+    if (!frame) {
+        return;
+    }
+    CanInterfaceId intf = frame->getInterfaceId();
+    uint32_t raw_id = frame->getRawId();
+
+    do {
+        row = forward ? trace->findNextMessage(intf, raw_id, row+1) : trace->findPreviousMessage(intf, raw_id, row-1);
+    } while ((row >= 0) && !selectTraceRow(row));
+
+    if (row < 0) {
+        return;
+    }
+
+    int total = trace->countMessages(intf, raw_id, 0, (int)trace->size()-1);
+    int n = trace->countMessages(intf, raw_id, 0, row);
+    QRect rect = ui->tree->visualRect(ui->tree->currentIndex());
+    QToolTip::showText(ui->tree->viewport()->mapToGlobal(rect.bottomLeft()), tr("%1 of %2").arg(n).arg(total), ui->tree);
+}
+
+void TraceWindow::gotoTime()
+{
+    CanTrace *trace = _backend->getTrace();
+    const CanTraceFrame *first = trace->getMessage(0);
+    if (!first) {
+        return;
+    }
+    CanTimestamp t_first = first->getTimestampNsecs();
+
+    bool ok;
+    double secs = QInputDialog::getDouble(this, tr("Go to time"), tr("Seconds after the first frame in the trace:"), 0, 0, 1e9, 6, &ok);
+    if (!ok) {
+        return;
+    }
+
+    int row = trace->findMessageByTime(t_first + (CanTimestamp)llround(secs * timestamp_nsecs_per_sec));
+    if (row < 0) {
+        row = (int)trace->size() - 1;
+    }
+
+    setMode(mode_linear);
+    selectTraceRow(row);
+}
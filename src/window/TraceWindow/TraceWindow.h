@@ -52,6 +52,7 @@ public:
     void setMode(mode_t mode);
     void setAutoScroll(bool doAutoScroll);
     void setTimestampMode(int mode);
+    void setTimestampDecimals(int decimals);
 
     virtual bool saveXML(Backend &backend, QDomDocument &xml, QDomElement &root);
     virtual bool loadXML(Backend &backend, QDomElement &el);
@@ -64,16 +65,22 @@ private slots:
     void on_cbAutoScroll_stateChanged(int i);
 
     void on_cbTimestampMode_currentIndexChanged(int index);
+    void on_cbTimestampDecimals_currentIndexChanged(int index);
     void on_cbFilterChanged(void);
 
     void on_cbTraceClearpushButton(void);
 
+    void gotoNextOccurrence();
+    void gotoPreviousOccurrence();
+    void gotoTime();
+
 private:
     Ui::TraceWindow *ui;
     Backend *_backend;
     mode_t _mode;
     bool _doAutoScroll;
     timestamp_mode_t _timestampMode;
+    int _timestampDecimals;
 
     TraceFilterModel * _aggFilteredModel;
     TraceFilterModel * _linFilteredModel;
@@ -81,4 +88,8 @@ private:
     AggregatedTraceViewModel *_aggregatedTraceViewModel;
     QSortFilterProxyModel *_aggregatedProxyModel;
     QSortFilterProxyModel *_linearProxyModel;
+
+    int currentTraceRow();
+    bool selectTraceRow(int row);
+    void gotoOccurrence(bool forward);
 };
@@ -0,0 +1,178 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "BlfTraceFileTest.h"
+
+#include <QtTest>
+#include <QFile>
+#include <core/Backend.h>
+#include <tracefile/TraceFile.h>
+#include <tracefile/BlfTraceFile.h>
+
+void BlfTraceFileTest::initTestCase()
+{
+    QVERIFY(_dir.isValid());
+}
+
+CanMessage BlfTraceFileTest::makeMessage(uint32_t raw_id, int len, bool fd, bool brs, CanTimestamp t_ns)
+{
+    CanMessage msg;
+    msg.setRawId(raw_id);
+    msg.setFD(fd);
+    msg.setBRS(brs);
+    msg.setLength(len);
+    for (int i=0; i<len; i++) {
+        msg.setByte(i, 0xA0 + i);
+    }
+    msg.setTimestampNsecs(t_ns);
+    return msg;
+}
+
+bool BlfTraceFileTest::writeAndRead(const QList<CanMessage> &in, QList<CanMessage> &out)
+{
+    QString filename = _dir.filePath("roundtrip.blf");
+
+    BlfTraceWriter writer(Backend::instance());
+    if (!writer.open(filename)) {
+        return false;
+    }
+    foreach (const CanMessage &msg, in) {
+        if (!writer.addMessage(msg)) {
+            return false;
+        }
+    }
+    if (!writer.close()) {
+        return false;
+    }
+
+    BlfTraceReader reader(Backend::instance());
+    if (!reader.open(filename)) {
+        return false;
+    }
+    while (!reader.atEnd()) {
+        if (reader.readMessages(out, 1000) < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void BlfTraceFileTest::compare(const CanMessage &actual, const CanMessage &expected)
+{
+    QCOMPARE(actual.getRawId(), expected.getRawId());
+    QCOMPARE(actual.isFD(), expected.isFD());
+    QCOMPARE(actual.isBRS(), expected.isBRS());
+    QCOMPARE(actual.isRX(), expected.isRX());
+    QCOMPARE(actual.getLength(), expected.getLength());
+    for (int i=0; i<expected.getLength(); i++) {
+        QCOMPARE(actual.getByte(i), expected.getByte(i));
+    }
+    QCOMPARE(actual.getTimestampNsecs(), expected.getTimestampNsecs());
+}
+
+void BlfTraceFileTest::canMessage()
+{
+    const CanTimestamp t0 = 1600000000123LL * timestamp_nsecs_per_msec;
+
+    QList<CanMessage> in;
+    in.append(makeMessage(0x123, 8, false, false, t0));
+    in.append(makeMessage(0x80000000 | 0x1ABCDEF0, 3, false, false, t0 + 456789));
+    in.append(makeMessage(0x40000000 | 0x7FF, 2, false, false, t0 + 1000000000));
+    in[1].setRX(false);
+
+    QList<CanMessage> out;
+    QVERIFY(writeAndRead(in, out));
+    QCOMPARE(out.size(), in.size());
+    for (int i=0; i<in.size(); i++) {
+        compare(out[i], in[i]);
+    }
+}
+
+void BlfTraceFileTest::canFdMessage64()
+{
+    const CanTimestamp t0 = 1600000000123LL * timestamp_nsecs_per_msec;
+
+    QList<CanMessage> in;
+    in.append(makeMessage(0x100, 12, true, false, t0));
+    in.append(makeMessage(0x80000000 | 0x18FF0001, 64, true, true, t0 + 1));
+    in.append(makeMessage(0x101, 0, true, true, t0 + 2));
+    in.append(makeMessage(0x102, 8, false, false, t0 + 3));
+
+    QList<CanMessage> out;
+    QVERIFY(writeAndRead(in, out));
+    QCOMPARE(out.size(), in.size());
+    for (int i=0; i<in.size(); i++) {
+        compare(out[i], in[i]);
+    }
+}
+
+void BlfTraceFileTest::canFdMessage()
+{
+    // file header without start time, followed by one uncompressed
+    // CAN_FD_MESSAGE (type 100) object outside of a log container
+    QByteArray buf;
+    buf.append("LOGG", 4);
+    TraceFile::putU32(buf, 144);
+    buf.append(144 - buf.size(), (char)0);
+
+    const int payload_size = 84;
+    buf.append("LOBJ", 4);
+    TraceFile::putU16(buf, 32);             // header size
+    TraceFile::putU16(buf, 1);              // header version
+    TraceFile::putU32(buf, 32 + payload_size);
+    TraceFile::putU32(buf, 100);            // CAN_FD_MESSAGE
+    TraceFile::putU32(buf, 0x00000002);     // timestamps in ns
+    TraceFile::putU16(buf, 0);
+    TraceFile::putU16(buf, 0);
+    TraceFile::putU64(buf, 1234567);
+
+    TraceFile::putU16(buf, 1);              // channel
+    TraceFile::putU8(buf, 0x01);            // flags: tx
+    TraceFile::putU8(buf, 11);              // dlc
+    TraceFile::putU32(buf, 0x80000000 | 0x0CF00400);
+    TraceFile::putU32(buf, 0);              // frame length
+    TraceFile::putU8(buf, 0);               // arbitration bit count
+    TraceFile::putU8(buf, 0x03);            // EDL | BRS
+    TraceFile::putU8(buf, 20);              // valid data bytes
+    TraceFile::putU8(buf, 0);
+    TraceFile::putU32(buf, 0);
+    for (int i=0; i<64; i++) {
+        TraceFile::putU8(buf, (i < 20) ? (0xA0 + i) : 0);
+    }
+
+    QString filename = _dir.filePath("canfd_message.blf");
+    QFile file(filename);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    QCOMPARE(file.write(buf), (qint64)buf.size());
+    file.close();
+
+    BlfTraceReader reader(Backend::instance());
+    QVERIFY(reader.open(filename));
+    QList<CanMessage> out;
+    while (!reader.atEnd()) {
+        QVERIFY(reader.readMessages(out, 1000) >= 0);
+    }
+
+    CanMessage expected = makeMessage(0x80000000 | 0x0CF00400, 20, true, true, 1234567);
+    expected.setRX(false);
+    QCOMPARE(out.size(), 1);
+    compare(out[0], expected);
+}
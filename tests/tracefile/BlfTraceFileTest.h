@@ -0,0 +1,48 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+#include <QObject>
+#include <QTemporaryDir>
+#include <QList>
+#include <core/CanMessage.h>
+
+// Round trips through BlfTraceWriter / BlfTraceReader for the object types
+// the writer produces (CAN_MESSAGE, CAN_FD_MESSAGE_64), and a hand built
+// CAN_FD_MESSAGE object as written by older Vector tools.
+class BlfTraceFileTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void canMessage();
+    void canFdMessage64();
+    void canFdMessage();
+
+private:
+    QTemporaryDir _dir;
+
+    static CanMessage makeMessage(uint32_t raw_id, int len, bool fd, bool brs, CanTimestamp t_ns);
+    bool writeAndRead(const QList<CanMessage> &in, QList<CanMessage> &out);
+    void compare(const CanMessage &actual, const CanMessage &expected);
+};
@@ -0,0 +1,273 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "NativeTraceFileTest.h"
+
+#include <QtTest>
+#include <QFile>
+#include <core/Backend.h>
+#include <tracefile/TraceFile.h>
+#include <tracefile/NativeTraceFile.h>
+
+void NativeTraceFileTest::initTestCase()
+{
+    QVERIFY(_dir.isValid());
+}
+
+CanMessage NativeTraceFileTest::makeMessage(uint32_t raw_id, int len, bool fd, bool brs, CanTimestamp t_ns)
+{
+    CanMessage msg;
+    msg.setRawId(raw_id);
+    msg.setFD(fd);
+    msg.setBRS(brs);
+    msg.setLength(len);
+    for (int i=0; i<len; i++) {
+        msg.setByte(i, 0xA0 + i);
+    }
+    msg.setTimestampNsecs(t_ns);
+    return msg;
+}
+
+QList<CanMessage> NativeTraceFileTest::makeMessages(int count)
+{
+    const CanTimestamp t0 = 1600000000123LL * timestamp_nsecs_per_msec;
+
+    QList<CanMessage> msgs;
+    for (int i=0; i<count; i++) {
+        switch (i % 4) {
+            case 0:
+                msgs.append(makeMessage(0x100 + (i % 0x100), i % 9, false, false, t0 + i*1000));
+                break;
+            case 1:
+                msgs.append(makeMessage(0x80000000 | (0x18FF0000 + i), 8, false, false, t0 + i*1000));
+                msgs.last().setRX(false);
+                break;
+            case 2:
+                msgs.append(makeMessage(0x200, 64, true, true, t0 + i*1000));
+                break;
+            default:
+                msgs.append(makeMessage(0x40000000 | 0x7FF, 0, false, false, t0 + i*1000));
+                break;
+        }
+    }
+    return msgs;
+}
+
+bool NativeTraceFileTest::write(const QString &filename, const QList<CanMessage> &in)
+{
+    NativeTraceWriter writer(Backend::instance());
+    if (!writer.open(filename)) {
+        return false;
+    }
+    foreach (const CanMessage &msg, in) {
+        if (!writer.addMessage(msg)) {
+            return false;
+        }
+    }
+    return writer.close();
+}
+
+bool NativeTraceFileTest::readAll(const QString &filename, QList<CanMessage> &out, bool *indexed)
+{
+    NativeTraceReader reader(Backend::instance());
+    if (!reader.open(filename)) {
+        return false;
+    }
+    *indexed = reader.isIndexed();
+    for (int i=0; i<reader.blockCount(); i++) {
+        if (!reader.readBlock(i, out)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool NativeTraceFileTest::writeRaw(const QString &filename, const QByteArray &data)
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+    return file.write(data) == data.size();
+}
+
+QByteArray NativeTraceFileTest::buildFile(const QByteArray &payload, uint32_t num_frames)
+{
+    // file header and a single block, no index
+    QByteArray buf;
+    buf.append("CGTRACE1", 8);
+    TraceFile::putU32(buf, 1);
+    TraceFile::putU32(buf, 32);
+    TraceFile::putU64(buf, 0);
+    TraceFile::putU64(buf, 0);
+
+    QByteArray compressed = qCompress(payload);
+    NativeTraceBlockInfo info;
+    info.num_frames = num_frames;
+    info.compressed_size = compressed.size();
+    info.toHeader(buf);
+    buf.append(compressed);
+    return buf;
+}
+
+void NativeTraceFileTest::compare(const CanMessage &actual, const CanMessage &expected)
+{
+    QCOMPARE(actual.getRawId(), expected.getRawId());
+    QCOMPARE(actual.isFD(), expected.isFD());
+    QCOMPARE(actual.isBRS(), expected.isBRS());
+    QCOMPARE(actual.isRX(), expected.isRX());
+    QCOMPARE(actual.getLength(), expected.getLength());
+    for (int i=0; i<expected.getLength(); i++) {
+        QCOMPARE(actual.getByte(i), expected.getByte(i));
+    }
+    QCOMPARE(actual.getTimestampNsecs(), expected.getTimestampNsecs());
+}
+
+void NativeTraceFileTest::roundTrip()
+{
+    QString filename = _dir.filePath("roundtrip.cgt");
+    QList<CanMessage> in = makeMessages(NativeTraceWriter::frames_per_block + 100);
+    QVERIFY(write(filename, in));
+
+    NativeTraceReader reader(Backend::instance());
+    QVERIFY(reader.open(filename));
+    QVERIFY(reader.isIndexed());
+    QCOMPARE(reader.blockCount(), 2);
+    QCOMPARE(reader.frameCount(), (uint64_t)in.size());
+    QCOMPARE(reader.blockInfo(1).t_min_ns, in[NativeTraceWriter::frames_per_block].getTimestampNsecs());
+    QCOMPARE(reader.findBlockByTime(in.last().getTimestampNsecs()), 1);
+    QVERIFY(reader.blockInfo(0).mayContainId(0x80000000 | (0x18FF0000 + 1)));
+
+    QList<CanMessage> out;
+    for (int i=0; i<reader.blockCount(); i++) {
+        QVERIFY(reader.readBlock(i, out));
+    }
+    QCOMPARE(out.size(), in.size());
+    for (int i=0; i<in.size(); i++) {
+        compare(out[i], in[i]);
+    }
+}
+
+void NativeTraceFileTest::scanWithoutIndex()
+{
+    // a recording that was never closed ends after its last block
+    QString filename = _dir.filePath("noindex.cgt");
+    QList<CanMessage> in = makeMessages(NativeTraceWriter::frames_per_block + 100);
+    QVERIFY(write(filename, in));
+
+    QFile file(filename);
+    QVERIFY(file.open(QIODevice::ReadWrite));
+    file.seek(file.size() - 16);
+    QByteArray trailer = file.read(16);
+    QVERIFY(file.resize(TraceFile::getU64(trailer.constData())));
+    file.close();
+
+    QList<CanMessage> out;
+    bool indexed = true;
+    QVERIFY(readAll(filename, out, &indexed));
+    QVERIFY(!indexed);
+    QCOMPARE(out.size(), in.size());
+    for (int i=0; i<in.size(); i++) {
+        compare(out[i], in[i]);
+    }
+}
+
+void NativeTraceFileTest::incompleteLastBlock()
+{
+    // cut into the second block, only the first one is complete
+    QString filename = _dir.filePath("incomplete.cgt");
+    QList<CanMessage> in = makeMessages(NativeTraceWriter::frames_per_block + 100);
+    QVERIFY(write(filename, in));
+
+    NativeTraceBlockInfo second;
+    {
+        NativeTraceReader reader(Backend::instance());
+        QVERIFY(reader.open(filename));
+        QCOMPARE(reader.blockCount(), 2);
+        second = reader.blockInfo(1);
+    }
+
+    QFile file(filename);
+    QVERIFY(file.open(QIODevice::ReadWrite));
+    QVERIFY(file.resize(second.offset + NativeTraceBlockInfo::header_size + second.compressed_size / 2));
+    file.close();
+
+    QList<CanMessage> out;
+    bool indexed = true;
+    QVERIFY(readAll(filename, out, &indexed));
+    QVERIFY(!indexed);
+    QCOMPARE(out.size(), (int)NativeTraceWriter::frames_per_block);
+}
+
+void NativeTraceFileTest::frameCountTooLarge()
+{
+    // one interface, one frame, but a header claiming far more frames
+    QByteArray payload;
+    TraceFile::putU16(payload, 1);
+    TraceFile::putU16(payload, 0);
+    TraceFile::putU16(payload, 4);
+    payload.append("can0", 4);
+    TraceFile::putU64(payload, 1000);
+    TraceFile::putU32(payload, 0x123);
+    TraceFile::putU16(payload, 0);
+    TraceFile::putU8(payload, 0x04);
+    TraceFile::putU8(payload, 1);
+    TraceFile::putU8(payload, 0x55);
+
+    QString filename = _dir.filePath("framecount.cgt");
+    QVERIFY(writeRaw(filename, buildFile(payload, 1)));
+
+    NativeTraceReader reader(Backend::instance());
+    QVERIFY(reader.open(filename));
+    QList<CanMessage> out;
+    QVERIFY(reader.readBlock(0, out));
+    QCOMPARE(out.size(), 1);
+    QCOMPARE(out[0].getRawId(), (uint32_t)0x123);
+
+    QVERIFY(writeRaw(filename, buildFile(payload, 0xFFFFFFFF)));
+    QVERIFY(reader.open(filename));
+    out.clear();
+    QVERIFY(!reader.readBlock(0, out));
+    QVERIFY(reader.errorString().startsWith("corrupt block"));
+    QVERIFY(out.isEmpty());
+
+    QVERIFY(writeRaw(filename, buildFile(payload, 2)));
+    QVERIFY(reader.open(filename));
+    QVERIFY(!reader.readBlock(0, out));
+}
+
+void NativeTraceFileTest::interfaceNameTooLong()
+{
+    QByteArray payload;
+    TraceFile::putU16(payload, 1);
+    TraceFile::putU16(payload, 0);
+    TraceFile::putU16(payload, 100);
+    payload.append("can0", 4);
+
+    QString filename = _dir.filePath("interfacename.cgt");
+    QVERIFY(writeRaw(filename, buildFile(payload, 0)));
+
+    NativeTraceReader reader(Backend::instance());
+    QVERIFY(reader.open(filename));
+    QList<CanMessage> out;
+    QVERIFY(!reader.readBlock(0, out));
+    QVERIFY(reader.errorString().startsWith("corrupt block"));
+}
@@ -0,0 +1,55 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#pragma once
+
+#include <QObject>
+#include <QTemporaryDir>
+#include <QByteArray>
+#include <QList>
+#include <core/CanMessage.h>
+
+// NativeTraceWriter / NativeTraceReader: round trip over several blocks,
+// reading a file without index footer, and the checks against corrupt
+// block headers and payloads.
+class NativeTraceFileTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void roundTrip();
+    void scanWithoutIndex();
+    void incompleteLastBlock();
+    void frameCountTooLarge();
+    void interfaceNameTooLong();
+
+private:
+    QTemporaryDir _dir;
+
+    static CanMessage makeMessage(uint32_t raw_id, int len, bool fd, bool brs, CanTimestamp t_ns);
+    static QList<CanMessage> makeMessages(int count);
+    bool write(const QString &filename, const QList<CanMessage> &in);
+    bool readAll(const QString &filename, QList<CanMessage> &out, bool *indexed);
+    bool writeRaw(const QString &filename, const QByteArray &data);
+    QByteArray buildFile(const QByteArray &payload, uint32_t num_frames);
+    void compare(const CanMessage &actual, const CanMessage &expected);
+};
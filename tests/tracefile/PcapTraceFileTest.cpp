@@ -0,0 +1,253 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "PcapTraceFileTest.h"
+
+#include <QtTest>
+#include <QFile>
+#include <QStringList>
+#include <core/Backend.h>
+#include <tracefile/TraceFile.h>
+#include <tracefile/PcapTraceFile.h>
+
+enum {
+    block_section_header = 0x0A0D0D0A,
+    block_interface_description = 0x00000001,
+    block_enhanced_packet = 0x00000006,
+    opt_if_name = 2,
+    linktype_can_socketcan = 227
+};
+
+void PcapTraceFileTest::initTestCase()
+{
+    QVERIFY(_dir.isValid());
+}
+
+CanMessage PcapTraceFileTest::makeMessage(uint32_t raw_id, int len, bool fd, bool brs, CanTimestamp t_ns)
+{
+    CanMessage msg;
+    msg.setRawId(raw_id);
+    msg.setFD(fd);
+    msg.setBRS(brs);
+    msg.setLength(len);
+    for (int i=0; i<len; i++) {
+        msg.setByte(i, 0xA0 + i);
+    }
+    msg.setTimestampNsecs(t_ns);
+    return msg;
+}
+
+bool PcapTraceFileTest::write(const QString &filename, const QList<CanMessage> &in)
+{
+    PcapngTraceWriter writer;
+    writer.setInterfaceName(1, "can0");
+    writer.setInterfaceName(2, "vcan1");
+    if (!writer.open(filename)) {
+        return false;
+    }
+    foreach (const CanMessage &msg, in) {
+        if (!writer.addMessage(msg)) {
+            return false;
+        }
+    }
+    return writer.close();
+}
+
+bool PcapTraceFileTest::readAll(const QString &filename, QList<CanMessage> &out)
+{
+    PcapTraceReader reader(Backend::instance());
+    if (!reader.open(filename)) {
+        return false;
+    }
+    while (!reader.atEnd()) {
+        if (reader.readMessages(out, 1000) < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+QByteArray PcapTraceFileTest::readFile(const QString &filename)
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+    return file.readAll();
+}
+
+void PcapTraceFileTest::compare(const CanMessage &actual, const CanMessage &expected)
+{
+    // pcap has no direction, and interfaces are mapped to this session's
+    QCOMPARE(actual.getRawId(), expected.getRawId());
+    QCOMPARE(actual.isFD(), expected.isFD());
+    QCOMPARE(actual.isBRS(), expected.isBRS());
+    QCOMPARE(actual.getLength(), expected.getLength());
+    for (int i=0; i<expected.getLength(); i++) {
+        QCOMPARE(actual.getByte(i), expected.getByte(i));
+    }
+    QCOMPARE(actual.getTimestampNsecs(), expected.getTimestampNsecs());
+}
+
+void PcapTraceFileTest::interfaceBlocks()
+{
+    const CanTimestamp t0 = 1600000000123LL * timestamp_nsecs_per_msec;
+
+    QList<CanMessage> in;
+    in.append(makeMessage(0x100, 8, false, false, t0));
+    in.append(makeMessage(0x101, 3, false, false, t0 + 1));
+    in.append(makeMessage(0x102, 12, true, false, t0 + 2));
+    in[0].setInterfaceId(1);
+    in[1].setInterfaceId(2);
+    in[2].setInterfaceId(1);
+
+    QString filename = _dir.filePath("interfaces.pcapng");
+    QVERIFY(write(filename, in));
+    QByteArray buf = readFile(filename);
+
+    QStringList names;
+    QList<uint32_t> packet_interfaces;
+    const char *p = buf.constData();
+    const char *end = p + buf.size();
+    QCOMPARE(TraceFile::getU32(p), (uint32_t)block_section_header);
+    while (p < end) {
+        QVERIFY(end - p >= 12);
+        uint32_t type = TraceFile::getU32(p);
+        uint32_t len = TraceFile::getU32(p + 4);
+        QVERIFY(len >= 12);
+        QCOMPARE(len % 4, (uint32_t)0);
+        QVERIFY(len <= (uint32_t)(end - p));
+        QCOMPARE(TraceFile::getU32(p + len - 4), len);
+
+        if (type == block_interface_description) {
+            QCOMPARE(TraceFile::getU16(p + 8), (uint16_t)linktype_can_socketcan);
+            QCOMPARE(TraceFile::getU16(p + 16), (uint16_t)opt_if_name);
+            names << QString::fromUtf8(p + 20, TraceFile::getU16(p + 18));
+        } else if (type == block_enhanced_packet) {
+            packet_interfaces << TraceFile::getU32(p + 8);
+        }
+        p += len;
+    }
+
+    QCOMPARE(names, QStringList() << "can0" << "vcan1");
+    QCOMPARE(packet_interfaces, QList<uint32_t>() << 0 << 1 << 0);
+}
+
+void PcapTraceFileTest::roundTrip()
+{
+    const CanTimestamp t0 = 1600000000123LL * timestamp_nsecs_per_msec;
+
+    QList<CanMessage> in;
+    in.append(makeMessage(0x123, 8, false, false, t0));
+    in.append(makeMessage(0x80000000 | 0x1ABCDEF0, 3, false, false, t0 + 456789));
+    in.append(makeMessage(0x100, 12, true, false, t0 + 1000000000));
+    in.append(makeMessage(0x80000000 | 0x18FF0001, 64, true, true, t0 + 1000000001));
+    in.append(makeMessage(0x101, 0, true, true, t0 + 1000000002));
+    in[1].setInterfaceId(2);
+
+    QString filename = _dir.filePath("roundtrip.pcapng");
+    QVERIFY(write(filename, in));
+
+    QList<CanMessage> out;
+    QVERIFY(readAll(filename, out));
+    QCOMPARE(out.size(), in.size());
+    for (int i=0; i<in.size(); i++) {
+        compare(out[i], in[i]);
+    }
+}
+
+void PcapTraceFileTest::negativeTimestamp()
+{
+    QList<CanMessage> in;
+    in.append(makeMessage(0x123, 2, false, false, -5000));
+    in.append(makeMessage(0x124, 2, false, false, 7000));
+
+    QString filename = _dir.filePath("negative.pcapng");
+    QVERIFY(write(filename, in));
+
+    QList<CanMessage> out;
+    QVERIFY(readAll(filename, out));
+    QCOMPARE(out.size(), 2);
+    QCOMPARE(out[0].getTimestampNsecs(), (CanTimestamp)0);
+    QCOMPARE(out[1].getTimestampNsecs(), (CanTimestamp)7000);
+}
+
+void PcapTraceFileTest::paddedPackets()
+{
+    // section header, interface without options (microseconds), then
+    // packets captured with only the used payload bytes, padded to 4
+    QByteArray buf;
+    TraceFile::putU32(buf, block_section_header);
+    TraceFile::putU32(buf, 28);
+    TraceFile::putU32(buf, 0x1A2B3C4D);
+    TraceFile::putU16(buf, 1);
+    TraceFile::putU16(buf, 0);
+    TraceFile::putU64(buf, (uint64_t)-1);
+    TraceFile::putU32(buf, 28);
+
+    TraceFile::putU32(buf, block_interface_description);
+    TraceFile::putU32(buf, 20);
+    TraceFile::putU16(buf, linktype_can_socketcan);
+    TraceFile::putU16(buf, 0);
+    TraceFile::putU32(buf, 72);
+    TraceFile::putU32(buf, 20);
+
+    const int lengths[] = { 3, 8, 1 };
+    for (int k=0; k<3; k++) {
+        int len = lengths[k];
+        int caplen = 8 + len;
+        int padded = (caplen + 3) & ~3;
+        uint32_t block_len = 32 + padded;
+
+        TraceFile::putU32(buf, block_enhanced_packet);
+        TraceFile::putU32(buf, block_len);
+        TraceFile::putU32(buf, 0);
+        TraceFile::putU32(buf, 0);
+        TraceFile::putU32(buf, 1000000 + k);   // microseconds
+        TraceFile::putU32(buf, caplen);
+        TraceFile::putU32(buf, caplen);
+        TraceFile::putU8(buf, 0);              // can_id, big endian
+        TraceFile::putU8(buf, 0);
+        TraceFile::putU8(buf, 0x01);
+        TraceFile::putU8(buf, 0x20 + k);
+        TraceFile::putU8(buf, len);
+        TraceFile::putU8(buf, 0);
+        TraceFile::putU16(buf, 0);
+        for (int i=0; i<len; i++) {
+            TraceFile::putU8(buf, 0xA0 + i);
+        }
+        buf.append(padded - caplen, (char)0);
+        TraceFile::putU32(buf, block_len);
+    }
+
+    QString filename = _dir.filePath("padded.pcapng");
+    QFile file(filename);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    QCOMPARE(file.write(buf), (qint64)buf.size());
+    file.close();
+
+    QList<CanMessage> out;
+    QVERIFY(readAll(filename, out));
+    QCOMPARE(out.size(), 3);
+    for (int k=0; k<3; k++) {
+        compare(out[k], makeMessage(0x120 + k, lengths[k], false, false, (1000000LL + k) * 1000));
+    }
+}
@@ -0,0 +1,44 @@
+/*
+
+  Copyright (c) 2016 Hubert Denkmair <hubert@denkmair.de>
+
+  This file is part of cangaroo.
+
+  cangaroo is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  cangaroo is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cangaroo.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <QtTest>
+#include "BlfTraceFileTest.h"
+#include "NativeTraceFileTest.h"
+#include "PcapTraceFileTest.h"
+
+// all trace file tests share one binary, each class runs as its own suite
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    int status = 0;
+
+    BlfTraceFileTest blf;
+    status |= QTest::qExec(&blf, argc, argv);
+
+    NativeTraceFileTest native;
+    status |= QTest::qExec(&native, argc, argv);
+
+    PcapTraceFileTest pcap;
+    status |= QTest::qExec(&pcap, argc, argv);
+
+    return status;
+}
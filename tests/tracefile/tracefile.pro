@@ -0,0 +1,41 @@
+lessThan(QT_MAJOR_VERSION, 6): error("requires Qt 6")
+
+QT += core gui
+QT += widgets
+QT += xml
+QT += charts
+QT += serialport
+QT += testlib
+
+TARGET = cangaroo-test-tracefile
+TEMPLATE = app
+CONFIG += console testcase warn_on c++20
+CONFIG -= app_bundle
+
+SRC = $$PWD/../../src
+INCLUDEPATH += $$SRC
+
+DESTDIR = ../../bin
+MOC_DIR = ../../build/test-tracefile/moc
+RCC_DIR = ../../build/test-tracefile/rcc
+UI_DIR = ../../build/test-tracefile/ui
+OBJECTS_DIR = ../../build/test-tracefile/o
+
+SOURCES += \
+    main.cpp \
+    BlfTraceFileTest.cpp \
+    NativeTraceFileTest.cpp \
+    PcapTraceFileTest.cpp
+
+HEADERS += \
+    BlfTraceFileTest.h \
+    NativeTraceFileTest.h \
+    PcapTraceFileTest.h
+
+# the readers and writers take the backend to map interfaces, which pulls
+# in the drivers and the setup dialog
+include($$SRC/core/core.pri)
+include($$SRC/driver/driver.pri)
+include($$SRC/parser/dbc/dbc.pri)
+include($$SRC/tracefile/tracefile.pri)
+include($$SRC/window/SetupDialog/SetupDialog.pri)